@@ -22,12 +22,26 @@
  *	
  */
 
-#ifndef __WPROGRAM_H__
+#if !defined(__WPROGRAM_H__) && !defined(SIGFOX_TRANSPORT_HEADER)
 #include "WaspClasses.h"
 #endif
 
 #include "LYNXBeeSigfox.h"
 
+#if defined(__AVR__)
+#include <avr/sleep.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+#endif
+
+//! block run with interrupts off, for data shared with interrupt routines 
+//! (host builds have none)
+#if defined(__AVR__)
+#define SIGFOX_ATOMIC	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+#else
+#define SIGFOX_ATOMIC
+#endif
+
 // MACROS
 #define NARGS_SEQ(_1,_2,_3,_4,_5,_6,_7,_8,_9,_10,_11,_12,N,...) N
 #define NARGS(...) NARGS_SEQ(__VA_ARGS__, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1)
@@ -35,6 +49,24 @@
 #define GEN_ATCOMMAND_READ(...) generator(2, NARGS(__VA_ARGS__) - 1, __VA_ARGS__)
 #define GEN_ATCOMMAND_DISPLAY(...) generator(3, NARGS(__VA_ARGS__) - 1, __VA_ARGS__)
 
+//! idleLeft() when idle detection does not apply
+#define IDLE_NEVER	0xFFFFFFFFUL
+
+//! '_fccState': not asked since ON, not an FCC module, FCC module
+#define FCC_UNKNOWN		0
+#define FCC_NONE		1
+#define FCC_MODULE		2
+
+//! '_fccCache' bits
+#define FCC_CACHE_BITMASK	0x01
+#define FCC_CACHE_OFFSET	0x02
+
+//! AT command headers
+static char AT_HEADER[] = "AT$";
+static char AT_HEADER_COLON[] = "AT:";
+
+static uint32_t uplinkEnergy(uint8_t power);
+
 
 // PRIVATE METHODS /////////////////////////////////////////////////////////////
 
@@ -69,7 +101,7 @@ void LYNXBeeSigfox::generator(uint8_t type, int n, const char *cmdCode, ...)
 					// add command code
 					strncat(_command, cmdCode, strlen(cmdCode) );
 
-					strncat(_command, "=",  1 );	
+					strcat(_command, "=");	
 					break;	
 
 			case SIGFOX_CMD_CONFIG:
@@ -111,7 +143,7 @@ void LYNXBeeSigfox::generator(uint8_t type, int n, const char *cmdCode, ...)
 							strncat(_command, cmdCode, strlen(cmdCode) );
 							
 							// Ask for command
-							strncat(_command, "?",  1 );
+							strcat(_command, "?");
 							
 							break;
 							
@@ -150,7 +182,7 @@ void LYNXBeeSigfox::generator(uint8_t type, int n, const char *cmdCode, ...)
 			// add ',' except for the first argument
 			if( i!=0 )
 			{			
-				strncat(_command, ",", 1 );
+				strcat(_command, ",");
 			}
 			
 			// calculate size after adding the new argument to check if
@@ -182,7 +214,7 @@ void LYNXBeeSigfox::generator(uint8_t type, int n, const char *cmdCode, ...)
 	}
     	
 	// add CR at the end of the command
-    strncat(_command, "\r", strlen("\r") );
+    strcat(_command, "\r");
     
     // show command
     #if DEBUG_SIGFOX > 1
@@ -200,13 +232,7 @@ void LYNXBeeSigfox::generator(uint8_t type, int n, const char *cmdCode, ...)
  */
 uint32_t LYNXBeeSigfox::parseHexValue()
 {
-	char * pch;	
-	pch = strtok((char*) _buffer,"\r\nOKERROR");
-	if (pch != NULL)
-	{
-		return strtoul(pch, NULL, 16);
-	}
-	return 0;
+	return strtoul(_response, NULL, 16);
 }
 
 
@@ -219,13 +245,7 @@ uint32_t LYNXBeeSigfox::parseHexValue()
  */
 uint8_t LYNXBeeSigfox::parseUint8Value()
 {
-	char * pch;	
-	pch = strtok((char*) _buffer,"\r\nOKERROR");
-	if (pch != NULL)
-	{
-		return strtoul(pch, NULL, 10);
-	}
-	return 0;
+	return strtoul(_response, NULL, 10);
 }
 
 
@@ -237,944 +257,4271 @@ uint8_t LYNXBeeSigfox::parseUint8Value()
  */
 uint32_t LYNXBeeSigfox::parseUint32Value()
 {
-	char * pch;	
-	pch = strtok((char*) _buffer,"\r\nOKERROR");
-	if (pch != NULL)
-	{
-		return strtoul(pch, NULL, 10);
-	}
-	return 0;
+	return strtoul(_response, NULL, 10);
 }
 
 
 
 
-// PUBLIC METHODS //////////////////////////////////////////////////////////////
+/*!
+ * @brief	This function clears the receive ring buffer and pending events
+ * @return	void
+ */
+void LYNXBeeSigfox::resetRX()
+{
+	// drop what is left in the ring
+	_rxTail = _rxHead;
+	_rxOverflow = 0;
+	_rxEvents = 0;
+	_lineLength = 0;
+	_lineMatch = -1;
+	_matcher.reset();
+#if SIGFOX_FEATURE_DOWNLINK
+	_downlinkLength = 0;
+#endif
+	memset(_response, 0x00, sizeof(_response));
+}
+
+
 
 
 /*!
- * @brief	This function powers on the module
- * @param 	uint8_t	socket: socket to be used: SOCKET0 or SOCKET1
- * @return	
- * 	@arg	'SIGFOX_ANSWER_OK' if OK
- * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
- * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
+ * @brief	This function stores a received byte in the ring buffer. 
+ * 			serviceRX() is its only caller.
+ * @param	uint8_t data: received byte
+ * @return	void
  */
-uint8_t LYNXBeeSigfox::ON(uint8_t socket)
+void LYNXBeeSigfox::rxByte(uint8_t data)
 {
-	_baudrate = SIGFOX_RATE;
-	_uart = socket;
-
-	// select multiplexer
-    if (_uart == SOCKET0) 	Utils.setMuxSocket0();
-    if (_uart == SOCKET1) 	Utils.setMuxSocket1();
+	uint8_t next = (_rxHead + 1) & (SIGFOX_RX_RING_SIZE - 1);
 	
-	// Open UART
-	beginUART();
+	if (next == _rxTail)
+	{
+		// ring full: drop the byte
+		_rxOverflow = 1;
+		return (void)0;
+	}
 	
-    // power on the socket
-    PWR.powerSocket(_uart, HIGH);
+	_rxRing[_rxHead] = data;
+	_rxHead = next;
+}
 
-	delay(5000);
-	
-	// Check communication
-	uint8_t answer = check();
+
+
+
+/*!
+ * @brief	This function puts the MCU in idle sleep mode until the next 
+ * 			interrupt. UART and timer 0 keep running in idle mode, so a 
+ * 			received byte or the next millis() tick wakes the MCU up. Host 
+ * 			builds block on the serial port instead of spinning.
+ * @return	void
+ */
+void LYNXBeeSigfox::idle()
+{
+#if defined(__AVR__)
+	set_sleep_mode(SLEEP_MODE_IDLE);
 	
-	return answer;	
+	// do not sleep if data arrived meanwhile. Interrupts are enabled by the
+	// instruction just before sleeping so no wake-up can be missed
+	cli();
+	if ((serialAvailable(_uart) == 0) && (_rxTail == _rxHead))
+	{
+		sleep_enable();
+		sei();
+		sleep_cpu();
+		sleep_disable();
+	}
+	sei();
+#elif defined(SIGFOX_TRANSPORT_HEADER)
+	// host transports block until data arrives or the next tick
+	serialWait(_uart, 1);
+#endif
 }
 
 
 
+
 /*!
- * @brief	This function powers down the module
- * @param 	uint8_t	socket: socket to be used: SOCKET0 or SOCKET1
- * @return	
- * 	@arg	'SIGFOX_ANSWER_OK' if OK
- * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
- * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
+ * @brief	This function waits for a point in time, sleeping meanwhile if 
+ * 			enabled with setSleepWhileWaiting()
+ * @param	unsigned long time: millis() value to wait for
+ * @return	void
  */
-uint8_t LYNXBeeSigfox::OFF(uint8_t socket)
+void LYNXBeeSigfox::waitUntil(unsigned long time)
 {
-	// close uart
-	closeUART();	
-	
-	// unselect multiplexer 
-    if (_uart == SOCKET0)	Utils.setMuxUSB();
-    if (_uart == SOCKET1)	Utils.muxOFF1();
-		
-    // switch module OFF
-	PWR.powerSocket(_uart, LOW);
-	
-	return SIGFOX_ANSWER_OK;	
+	while ((long)(millis() - time) < 0)
+	{
+		if (_sleepWhileWaiting)
+		{
+			idle();
+		}
+	}
 }
 
 
 
+
 /*!
- * @brief	Checks if LYNXBeeSigfox module is ready
- * @return	
- * 	@arg	'SIGFOX_ANSWER_OK' if OK
- * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
- * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
- * 
- */ 
-uint8_t LYNXBeeSigfox::check()
-{	
-	uint8_t status;	
-	
-	// send command
-	status = sendCommand("AT\r", AT_OK, AT_ERROR, 5000 );
+ * @brief	This function classifies a completed line and raises its event.
+ * 			Command echoes and empty lines are discarded.
+ * @return	void
+ */
+void LYNXBeeSigfox::processLine()
+{
+	if (_lineLength == 0)
+	{
+		return (void)0;
+	}
 	
-	if( status == 1 )
+	// the line was classified by the matcher while it was received
+	if ((_lineMatch == SIGFOX_PATTERN_OK) && (_lineLength == 2))
 	{
-		// ok -> get module region
-//		getRegion();
-		return SIGFOX_ANSWER_OK;
+		_rxEvents |= SIGFOX_EVENT_OK;
 	}
-	else if(status == 2)
+	else if (_lineMatch == SIGFOX_PATTERN_ERROR)
 	{
-		// error
-		return SIGFOX_ANSWER_ERROR;
+		_rxEvents |= SIGFOX_EVENT_ERROR;
 	}
-	else 
+	else if (_lineMatch == SIGFOX_PATTERN_DOWNLINK)
 	{
-		// timeout
-		return SIGFOX_NO_ANSWER;
+#if SIGFOX_FEATURE_DOWNLINK
+		uint8_t nibble;
+		uint8_t count = 0;
+		
+		// "RX=xx xx .." -> keep payload so late downlinks are not lost
+		memset(_downlink, 0x00, sizeof(_downlink));
+		_downlinkLength = 0;
+		
+		for (uint8_t i = 3; (i < _lineLength) && (_downlinkLength < SIGFOX_DOWNLINK_SIZE); i++)
+		{
+			char c = _line[i];
+			
+			if ((c >= '0') && (c <= '9'))		nibble = c - '0';
+			else if ((c >= 'A') && (c <= 'F'))	nibble = c - 'A' + 10;
+			else if ((c >= 'a') && (c <= 'f'))	nibble = c - 'a' + 10;
+			else continue;
+			
+			_downlink[_downlinkLength] = (_downlink[_downlinkLength] << 4) | nibble;
+			if (++count == 2)
+			{
+				count = 0;
+				_downlinkLength++;
+			}
+		}
+#endif
+		_rxEvents |= SIGFOX_EVENT_DOWNLINK;
+	}
+	else if (_lineMatch >= SIGFOX_PATTERN_USER)
+	{
+		// unsolicited message
+		memcpy(_response, _line, _lineLength + 1);
+		_unsolicited = _lineMatch;
+		_unsolicitedOffset = _lineOffset;
+		_rxEvents |= SIGFOX_EVENT_UNSOLICITED;
+	}
+	else if (_lineMatch != SIGFOX_PATTERN_ECHO)
+	{
+		// data line: keep it for the parsing functions
+		memcpy(_response, _line, _lineLength + 1);
+		_rxEvents |= SIGFOX_EVENT_LINE;
+		_rxAnswered = true;
 	}
 }
 
+
+
+
 /*!
- * @brief	Sets Public Key for testing with SNEK USB emulator
- * @return
- * 	@arg	'SIGFOX_ANSWER_OK' if OK
- * 	@arg	'SIGFOX_ANSWER_ERROR' if error
- * 	@arg	'SIGFOX_NO_ANSWER' if no answer
- *
+ * @brief	This function completes the line being received
+ * @return	void
  */
-uint8_t LYNXBeeSigfox::setPublicKey()
+void LYNXBeeSigfox::endLine()
 {
-	uint8_t status;
+	_line[_lineLength] = '\0';
+	processLine();
+	_lineLength = 0;
+	_lineMatch = -1;
+	_matcher.reset();
+}
 
-	// send command
-	status = sendCommand("ATS410=1\r", AT_OK, AT_ERROR, 5000 );
 
-	if( status == 1 )
-	{
-		return SIGFOX_ANSWER_OK;
-	}
-	else if(status == 2)
-	{
-		// error
-		return SIGFOX_ANSWER_ERROR;
-	}
-	else
+
+
+/*!
+ * @brief	This function returns the idle gap in ms: the time taken by 
+ * 			'_idleChars' characters (10 bits each) at the UART baudrate, 
+ * 			plus one millis() tick
+ * @return	gap (in ms)
+ */
+uint32_t LYNXBeeSigfox::idleGap()
+{
+	return ((uint32_t)_idleChars * 10000UL) / _baudrate + 1;
+}
+
+
+
+
+/*!
+ * @brief	This function tells when the module has stopped talking: a 
+ * 			partial line or a data line was received for the current 
+ * 			operation and the line has been silent for the idle gap. It does
+ * 			not apply to the boot time and to the downlink wait, when the 
+ * 			module is silent on purpose.
+ * @return	time left before the line is idle (in ms), '0' if idle now or
+ * 			IDLE_NEVER if it does not apply
+ */
+uint32_t LYNXBeeSigfox::idleLeft()
+{
+	unsigned long elapsed;
+	uint32_t gap;
+	
+	if ((_idleChars == 0) || 
+		(_atOp == SIGFOX_OP_NONE) || 
+		(_atOp == SIGFOX_OP_BOOT) ||
+		((_atOp == SIGFOX_OP_SEND_ACK) && (_atStep == 1)) ||
+		(!_rxAnswered && (_lineLength == 0)))
 	{
-		// timeout
-		return SIGFOX_NO_ANSWER;
+		return IDLE_NEVER;
 	}
+	
+	gap = idleGap();
+	elapsed = millis() - _rxLast;
+	
+	return (elapsed >= gap) ? 0 : (gap - elapsed);
 }
 
 
 
 
-
 /*!
- * @brief	This function is used to read the module's id
- * @return	
- * 	@arg	'SIGFOX_ANSWER_OK' if OK
- * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
- * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
+ * @brief	This function writes an AT command to the module. Completed 
+ * 			unsolicited lines are collected first and a pending downlink event
+ * 			is kept, other events are cleared.
+ * @param	const char* cmd: command to be written (including "\r")
+ * @return	void
  */
-uint8_t LYNXBeeSigfox::getID()
+void LYNXBeeSigfox::writeAT(const char* cmd)
 {
-	uint8_t answer;
+	serviceRX();
 	
-	// 1. send command
-	answer =
-("AT$I=10\r", "\r\n", AT_ERROR, 1000);
+	_rxEvents &= SIGFOX_EVENT_DOWNLINK;
+	_rxAnswered = false;
+	memset(_response, 0x00, sizeof(_response));
 	
-	// check possible error answers
-	if(answer == 2)
-	{
-		// error
-		return SIGFOX_ANSWER_ERROR;
-	}
-	else if (answer == 0)
+	printString(cmd, _uart);
+}
+
+
+
+
+/*!
+ * @brief	This function writes an AT command and starts an operation
+ * @param	const char* cmd: command to be written
+ * @param	uint8_t op: operation (see OperationTypes)
+ * @param	uint32_t timeout: time to wait for the first step (in ms)
+ * @return	
+ * 	@arg	'SIGFOX_ANSWER_PENDING' if started
+ * 	@arg	'SIGFOX_ANSWER_RECOVERING' if the module is being recovered
+ */
+uint8_t LYNXBeeSigfox::beginAT(const char* cmd, uint8_t op, uint32_t timeout)
+{
+	if (!healthReady())
 	{
-		// timeout
-		return SIGFOX_NO_ANSWER;
+		return SIGFOX_ANSWER_RECOVERING;
 	}
 	
-	// 2. wait for end of line
-	answer = waitFor("\r\n",1000);
+	writeAT(cmd);
 	
-	// check possible error answers
-	if(answer == 2)
-	{
-		// error
-		return SIGFOX_ANSWER_ERROR;
-	}
-	else if (answer == 0)
-	{
-		// timeout
-		return SIGFOX_NO_ANSWER;
-	}
+	_atOp = op;
+	_atStep = 0;
+	_atStart = millis();
+	_atTimeout = timeout;
+	_opBegin = _atStart;
 	
-	// 3. get value from received data
-	_id = parseHexValue();	
+	return SIGFOX_ANSWER_PENDING;
+}
+
+
+
+
+/*!
+ * @brief	This function moves the operation to its next step
+ * @param	uint32_t timeout: time to wait for the step (in ms)
+ * @return	'SIGFOX_ANSWER_PENDING'
+ */
+uint8_t LYNXBeeSigfox::nextAT(uint32_t timeout)
+{
+	_atStep++;
+	_atStart = millis();
+	_atTimeout = timeout;
 	
-	return SIGFOX_ANSWER_OK;	
+	return SIGFOX_ANSWER_PENDING;
 }
 
 
-uint8_t LYNXBeeSigfox::getPAC()
+
+
+/*!
+ * @brief	This function ends the operation
+ * @param	uint8_t answer: result of the operation
+ * @return	answer
+ */
+uint8_t LYNXBeeSigfox::endAT(uint8_t answer)
 {
-	uint8_t answer;
+	bool uplinked;
+	bool noDownlink;
+	uint8_t health = answer;
 	
-	// 1. send command
-	answer =
-("AT$I=11\r", "\r\n", AT_ERROR, 1000);
+#if SIGFOX_FEATURE_DOWNLINK
+	// account for the downlink receive window
+	if ((_atOp == SIGFOX_OP_SEND_ACK) && (_atStep == 1))
+	{
+		_downlinkStats.rxTime += millis() - _atStart;
+		_opStats.energy += (millis() - _atStart) * SIGFOX_RX_CURRENT / 1000 * SIGFOX_SUPPLY_VOLTAGE / 1000;
+		
+		if (_downlinkLength > 0)
+		{
+			_downlinkStats.received++;
+			_dlPending = false;
+			
+			// remote configuration: keep it for applyRemote()
+			if (_rcEnabled && ((_downlink[0] >> 4) == SIGFOX_REMOTE_TAG))
+			{
+				memcpy(_rcFrame, _downlink, _downlinkLength);
+				_rcLength = _downlinkLength;
+				_rcPending = true;
+			}
+		}
+		
+		if (answer != SIGFOX_ANSWER_CANCELLED)
+		{
+			powerFeedback(_downlinkLength > 0);
+		}
+		_urgentCancel = (answer == SIGFOX_ANSWER_CANCELLED);
+	}
+#endif
 	
-	// check possible error answers
-	if(answer == 2)
+	// operation statistics
+	if (_atOp == SIGFOX_OP_BOOT)
 	{
-		// error
-		return SIGFOX_ANSWER_ERROR;
+		_opStats.bootTime = millis() - _opBegin;
 	}
-	else if (answer == 0)
+	else if ((_atOp != SIGFOX_OP_RECOVER) && !_opUplink)
 	{
-		// timeout
-		return SIGFOX_NO_ANSWER;
+		_opStats.commands++;
+		_opStats.busyTime += millis() - _opBegin;
 	}
 	
-	// 2. wait for end of line
-	answer = waitFor("\r\n",1000);
+	// the receive window closed without a downlink: the module answered 
+	// the uplink, so it is neither a timeout nor a health failure
+	noDownlink = (_atOp == SIGFOX_OP_SEND_ACK) && (_atStep == 1) && (answer == SIGFOX_NO_ANSWER);
+	if (noDownlink)
+	{
+		health = SIGFOX_ANSWER_OK;
+	}
 	
-	// check possible error answers
-	if(answer == 2)
+	if ((answer == SIGFOX_NO_ANSWER) && !noDownlink)	_opStats.timeouts++;
+	else if (answer == SIGFOX_ANSWER_ERROR)				_opStats.errors++;
+	
+	uplinked = _opUplink && ((answer == SIGFOX_ANSWER_OK) || ((_atOp == SIGFOX_OP_SEND_ACK) && (_atStep == 1)));
+	if (uplinked)
 	{
-		// error
-		return SIGFOX_ANSWER_ERROR;
+		_opStats.uplinks++;
+		_opStats.energy += uplinkEnergy(_power) / 1000;
 	}
-	else if (answer == 0)
+	
+#if SIGFOX_FEATURE_FCC
+	// each uplink takes a micro channel
+	if (_opUplink && (_fccState == FCC_MODULE) && (_freeChannels > 0))
 	{
-		// timeout
-		return SIGFOX_NO_ANSWER;
+		_freeChannels--;
+		_channelFree = (_freeChannels > 0);
 	}
+#endif
+	_opUplink = false;
 	
-	// 3. get value from received data
-	_pac = parseHexValue();	
+#if SIGFOX_FEATURE_DOWNLINK
+	// remote configuration acknowledged
+	if (_rcAckInFlight)
+	{
+		_rcAckInFlight = false;
+		if (uplinked)
+		{
+			_rcAck = 0;
+		}
+	}
+#endif
 	
-	return SIGFOX_ANSWER_OK;	
+	if (_urgentInFlight)
+	{
+		_urgentInFlight = false;
+		
+		if (answer == SIGFOX_ANSWER_OK)
+		{
+			_urgentStats.sent++;
+			_urgentStats.lastLatency = millis() - _urgentStart;
+			_urgentStats.totalLatency += _urgentStats.lastLatency;
+			if (_urgentStats.lastLatency > _urgentStats.maxLatency)
+			{
+				_urgentStats.maxLatency = _urgentStats.lastLatency;
+			}
+		}
+		else if (!_urgentPending)
+		{
+			// keep it for the next try, unless a newer one replaced it
+			if (_urgentTries < SIGFOX_URGENT_TRIES)
+			{
+				_urgentPending = true;
+			}
+			else
+			{
+				_urgentStats.dropped++;
+			}
+		}
+	}
+	
+	_atOp = SIGFOX_OP_NONE;
+	
+	checkHealth(health);
+	
+	return answer;
 }
 
 
+
+
 /*!
- * @brief	This function is used to configure the Sigfox RF power level in dBm
- * @param	uint8_t power: power level to be set in dBm
+ * @brief	This function runs the operation until it ends
  * @return	
  * 	@arg	'SIGFOX_ANSWER_OK' if OK
  * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
  * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
+ * 	@arg	'SIGFOX_ANSWER_RECOVERING' if the operation was not started
+ * 	@arg	'SIGFOX_ANSWER_CANCELLED' if the downlink wait was given up, the
+ * 			urgent frame has been sent (see '_urgentStats')
  */
-uint8_t LYNXBeeSigfox::setPower(uint8_t power)
+uint8_t LYNXBeeSigfox::waitAT()
 {
 	uint8_t answer;
 	
-	snprintf(_command, sizeof(_command), "ATS302=%u\r", power);
-	
-	// 1. send command
-	answer = sendCommand(_command, AT_OK, AT_ERROR, 1000);	
+	// the command was refused: do not wait for the recovery
+	if (_health >= SIGFOX_HEALTH_RESYNC)
+	{
+		return SIGFOX_ANSWER_RECOVERING;
+	}
 	
-	// check possible error answers
-	if(answer == 2)
+	while ((answer = pollAT()) == SIGFOX_ANSWER_PENDING)
 	{
-		// error
-		return SIGFOX_ANSWER_ERROR;
+		if (_sleepWhileWaiting)
+		{
+			idle();
+		}
 	}
-	else if (answer == 0)
+	
+	// downlink wait given up: the urgent frame goes now
+	if (answer == SIGFOX_ANSWER_CANCELLED)
 	{
-		// timeout
-		return SIGFOX_NO_ANSWER;
+		sendUrgent();
 	}
 	
-	// 2. save config
-	answer = saveSettings();
-
-	return answer;	
+	return answer;
 }
 
 
 
+
 /*!
- * @brief	This function is used to read the configuration of the module's RF 
+ * @brief	This function sends an AT command and waits for its terminator
+ * @param	const char* cmd: command to be sent
+ * @param	uint32_t timeout: time to wait for "OK" or "ERROR" (in ms)
+ * @return	
+ * 	@arg	'SIGFOX_ANSWER_OK' if OK
+ * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
+ * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
+ */
+uint8_t LYNXBeeSigfox::sendAT(const char* cmd, uint32_t timeout)
+{
+	if (beginAT(cmd, SIGFOX_OP_COMMAND, timeout) != SIGFOX_ANSWER_PENDING)
+	{
+		return SIGFOX_ANSWER_RECOVERING;
+	}
+	
+	return waitAT();
+}
+
+
+
+
+/*!
+ * @brief	This function sends a query AT command and waits for the data line
+ * 			which is then available in '_response'
+ * @param	const char* cmd: command to be sent
+ * @param	uint32_t timeout: time to wait for the data line (in ms)
+ * @return	
+ * 	@arg	'SIGFOX_ANSWER_OK' if OK
+ * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
+ * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
+ */
+uint8_t LYNXBeeSigfox::queryAT(const char* cmd, uint32_t timeout)
+{
+	if (beginAT(cmd, SIGFOX_OP_QUERY, timeout) != SIGFOX_ANSWER_PENDING)
+	{
+		return SIGFOX_ANSWER_RECOVERING;
+	}
+	
+	return waitAT();
+}
+
+
+
+
+/*!
+ * @brief	This function reads a filter field from a frame
+ * @param	uint8_t* data: frame
+ * @param	uint8_t index: field index
+ * @return	field value, sign extended to 32 bits for signed fields
+ */
+uint32_t LYNXBeeSigfox::readField(uint8_t* data, uint8_t index)
+{
+	SigfoxFilterField* field = &_filterFields[index];
+	uint32_t value = 0;
+	
+	for (uint8_t i = 0; i < field->size; i++)
+	{
+		value = (value << 8) | data[field->offset + i];
+	}
+	
+	// sign extend
+	if (field->isSigned && (field->size < 4) && (value & (1UL << (8*field->size - 1))))
+	{
+		value |= 0xFFFFFFFFUL << (8*field->size);
+	}
+	
+	return value;
+}
+
+
+
+
+/*!
+ * @brief	This function decides if a frame has to be suppressed because all 
+ * 			its fields are within their deadband of the last transmitted frame
+ * 			and the heartbeat is not due. Frames are not suppressed while no
+ * 			field is configured.
+ * @param	uint8_t* data: frame
+ * @param	uint16_t length: frame length
+ * @return	'true' if the frame must not be transmitted
+ */
+bool LYNXBeeSigfox::filterFrame(uint8_t* data, uint16_t length)
+{
+	uint32_t change;
+	uint32_t value;
+	bool above;
+	bool configured = false;
+	
+	if (!_filterEnabled || !_filterPrimed)
+	{
+		return false;
+	}
+	
+	// heartbeat: force a frame after the maximum silence
+	if ((_filterHeartbeat != 0) && (_filterSilence >= _filterHeartbeat))
+	{
+		return false;
+	}
+	
+	for (uint8_t i = 0; i < SIGFOX_FILTER_FIELDS; i++)
+	{
+		SigfoxFilterField* field = &_filterFields[i];
+		
+		if (field->size == 0)
+		{
+			continue;
+		}
+		
+		// frame too short for this field
+		if (field->offset + field->size > length)
+		{
+			return false;
+		}
+		
+		value = readField(data, i);
+		configured = true;
+		
+		// compare with the signedness of the field: the difference of the
+		// larger and the smaller value fits in 32 bits either way
+		if (field->isSigned)
+		{
+			above = ((int32_t)value > (int32_t)field->last);
+		}
+		else
+		{
+			above = (value > field->last);
+		}
+		change = above ? (value - field->last) : (field->last - value);
+		
+		if (change > field->deadband)
+		{
+			return false;
+		}
+	}
+	
+	if (!configured)
+	{
+		return false;
+	}
+	
+	_filterSilence++;
+	_suppressed++;
+	return true;
+}
+
+
+
+
+/*!
+ * @brief	This function stores the fields of a transmitted frame
+ * @param	uint8_t* data: frame
+ * @param	uint16_t length: frame length
+ * @return	void
+ */
+void LYNXBeeSigfox::updateFilter(uint8_t* data, uint16_t length)
+{
+	if (!_filterEnabled)
+	{
+		return (void)0;
+	}
+	
+	for (uint8_t i = 0; i < SIGFOX_FILTER_FIELDS; i++)
+	{
+		SigfoxFilterField* field = &_filterFields[i];
+		
+		if ((field->size != 0) && (field->offset + field->size <= length))
+		{
+			field->last = readField(data, i);
+		}
+	}
+	
+	_filterPrimed = true;
+	_filterSilence = 0;
+}
+
+
+
+
+// PUBLIC METHODS //////////////////////////////////////////////////////////////
+
+
+/*!
+ * @brief	This function moves received bytes through the line assembler and
+ * 			raises the events of every completed line. It never blocks.
+ * @return	pending events (see EventTypes)
+ */
+uint8_t LYNXBeeSigfox::serviceRX()
+{
+	uint8_t data;
+	
+	// feed the ring from the UART buffer filled by the core's interrupt
+	while (serialAvailable(_uart) > 0)
+	{
+		rxByte(serialRead(_uart));
+	}
+	
+	if (_rxOverflow)
+	{
+		_rxOverflow = 0;
+		_rxEvents |= SIGFOX_EVENT_OVERFLOW;
+	}
+	
+	// assemble lines
+	if (_rxTail != _rxHead)
+	{
+		_rxLast = millis();
+	}
+	
+	while (_rxTail != _rxHead)
+	{
+		data = _rxRing[_rxTail];
+		_rxTail = (_rxTail + 1) & (SIGFOX_RX_RING_SIZE - 1);
+		
+		if (data == '\n')
+		{
+			endLine();
+		}
+		else if ((data != '\r') && (_lineLength < sizeof(_line) - 1))
+		{
+			_line[_lineLength++] = data;
+			
+			// keep the first pattern found: built-in ones only count at the
+			// start of the line, added ones anywhere
+			int8_t match = _matcher.feed(data);
+			if ((match >= 0) && (_lineMatch < 0))
+			{
+				uint8_t offset = _lineLength - _matcher.length(match);
+				
+				if ((match >= SIGFOX_PATTERN_USER) || (offset == 0))
+				{
+					_lineMatch = match;
+					_lineOffset = offset;
+				}
+			}
+		}
+	}
+	
+	// end a line left without terminator once the module is silent
+	if ((_lineLength > 0) && (_idleChars > 0) && ((millis() - _rxLast) >= idleGap()))
+	{
+		endLine();
+	}
+	
+	return _rxEvents;
+}
+
+
+
+
+/*!
+ * @brief	This function waits until any of the given events is raised. The
+ * 			matched events are cleared, the rest are kept pending.
+ * @param	uint8_t events: mask of events to wait for (see EventTypes)
+ * @param	uint32_t timeout: time to wait (in ms). '0' checks once
+ * @return	matched events or '0' if timeout
+ */
+uint8_t LYNXBeeSigfox::waitEvent(uint8_t events, uint32_t timeout)
+{
+	unsigned long previous = millis();
+	uint8_t matched;
+	
+	for (;;)
+	{
+		matched = serviceRX() & events;
+		if (matched)
+		{
+			_rxEvents &= ~matched;
+			return matched;
+		}
+		
+		if ((millis() - previous) >= timeout)
+		{
+			return 0;
+		}
+		
+		if (_sleepWhileWaiting)
+		{
+			idle();
+		}
+	}
+}
+
+
+
+
+/*!
+ * @brief	This function enables MCU sleep while waiting for the module, 
+ * 			i.e. during the transmission in send() and the downlink window in
+ * 			sendACK(). The MCU sleeps in idle mode and wakes up on every 
+ * 			received byte and timer tick, so the answers are the same as with
+ * 			sleep disabled.
+ * @param	bool enable: 'true' to sleep while waiting; 'false' to busy-wait
+ * @return	void
+ */
+void LYNXBeeSigfox::setSleepWhileWaiting(bool enable)
+{
+	_sleepWhileWaiting = enable;
+}
+
+
+
+
+/*!
+ * @brief	This function adds a pattern for unsolicited messages. Lines 
+ * 			containing it raise SIGFOX_EVENT_UNSOLICITED; the line is then in
+ * 			'_response', the pattern in '_unsolicited' and its position in 
+ * 			'_unsolicitedOffset'. All patterns are checked in a single pass 
+ * 			as bytes are received.
+ * @param	const char* pattern: text to look for
+ * @return	pattern index (from SIGFOX_PATTERN_USER), '-1' if there is no room
+ */
+int8_t LYNXBeeSigfox::addPattern(const char* pattern)
+{
+	return _matcher.add(pattern);
+}
+
+
+
+
+/*!
+ * @brief	This function sets the idle gap ending a response. Once the module
+ * 			has answered, a silence of that many character times (at the UART 
+ * 			baudrate) ends the response: a line without "\r\n" is taken as 
+ * 			complete, the optional "OK" after a query is not waited for and an 
+ * 			answer without "OK" or "ERROR" fails at once instead of timing out.
+ * 			Silences the module keeps on purpose (boot time, transmission, 
+ * 			downlink wait) are not affected.
+ * @param	uint8_t chars: gap in character times, '0' disables it (default)
+ * @return	void
+ */
+void LYNXBeeSigfox::setIdleGap(uint8_t chars)
+{
+	_idleChars = chars;
+}
+
+
+
+
+
+//  Non-blocking functions  ///////////////////////////////////////////////////
+
+
+
+/*!
+ * @brief	This function powers on the module without waiting for it. The 
+ * 			operation waits SIGFOX_BOOT_TIME and then checks communication 
+ * 			at '_bootRate', the rate saved by setBaudrate() (kept in the 
+ * 			EEPROM at SIGFOX_RATE_ADDRESS). If the module does not answer at
+ * 			that rate, it is checked again at SIGFOX_RATE, or at 
+ * 			SIGFOX_RATE_MAX if that was the boot rate, and the rate which 
+ * 			answered is stored as the new boot rate.
+ * @param 	uint8_t	socket: socket to be used: SOCKET0 or SOCKET1
+ * @return	'SIGFOX_ANSWER_PENDING'
+ */
+uint8_t LYNXBeeSigfox::beginON(uint8_t socket)
+{
+	_bootRate = readBootRate();
+	_baudrate = _bootRate;
+	_uart = socket;
+	
+	// the module boots with its saved settings
+	_powerKnown = false;
+	_configKnown = 0;
+	
+	// and is given a fresh start by the health monitor
+	_health = SIGFOX_HEALTH_OK;
+	_healthFails = 0;
+	
+#if SIGFOX_FEATURE_FCC
+	// and has to be asked for its micro channels again
+	if (_fccState == FCC_MODULE)
+	{
+		_fccState = FCC_UNKNOWN;
+	}
+#endif
+
+	// select multiplexer
+    if (_uart == SOCKET0) 	Utils.setMuxSocket0();
+    if (_uart == SOCKET1) 	Utils.setMuxSocket1();
+	
+	// Open UART
+	beginUART();
+	resetRX();
+	
+    // power on the socket
+    PWR.powerSocket(_uart, HIGH);
+	
+	// wait for the module to boot
+	_atOp = SIGFOX_OP_BOOT;
+	_atStep = 0;
+	_atStart = millis();
+	_atTimeout = SIGFOX_BOOT_TIME;
+	_opBegin = _atStart;
+	
+	return SIGFOX_ANSWER_PENDING;
+}
+
+
+
+
+/*!
+ * @brief	This function starts checking if the module is ready
+ * @return	'SIGFOX_ANSWER_PENDING'
+ */
+uint8_t LYNXBeeSigfox::beginCheck()
+{
+	return beginAT("AT\r", SIGFOX_OP_COMMAND, 5000);
+}
+
+
+
+
+/*!
+ * @brief	This function starts reading the module's id into '_id'
+ * @return	'SIGFOX_ANSWER_PENDING'
+ */
+uint8_t LYNXBeeSigfox::beginGetID()
+{
+	return beginAT("AT$I=10\r", SIGFOX_OP_GET_ID, 2000);
+}
+
+
+
+
+/*!
+ * @brief	This function builds the frame of an uplink: the payload is 
+ * 			truncated to 12 bytes, then a pending remote configuration 
+ * 			acknowledge, the telemetry and the sequence counter are appended
+ * 			and the frame is converted to hex digits
+ * @param 	uint8_t* data:	pointer to the payload
+ * @param 	uint16_t length: length of the payload
+ * @param 	char* ascii: buffer receiving the hex digits (25 bytes at least)
+ * @return	
+ * 	@arg	'SIGFOX_ANSWER_OK' if built
+ * 	@arg	'SIGFOX_ANSWER_ERROR' if the sequence counter does not fit
+ * 	@arg	'SIGFOX_ANSWER_RECOVERING' if the module is being recovered
+ */
+uint8_t LYNXBeeSigfox::buildFrame(uint8_t* data, uint16_t length, char* ascii)
+{
+	uint8_t frame[SIGFOX_MAX_PAYLOAD];
+	
+	// do not count a frame which is not sent
+	if (!healthReady())
+	{
+		return SIGFOX_ANSWER_RECOVERING;
+	}
+	
+	// truncate if greater than 12
+	if (length>12)
+	{
+		length = 12;
+	}
+	
+#if SIGFOX_FEATURE_DOWNLINK
+	if (_rcAck != 0)
+	{
+		length = addRemoteAck(data, length, frame);
+		data = frame;
+	}
+#endif
+	
+#if SIGFOX_FEATURE_TELEMETRY
+	if (_tlmPiggyback)
+	{
+		length = addTelemetry(data, length, frame);
+		data = frame;
+	}
+#endif
+	
+	if (_seqBits > 0)
+	{
+		length = addSequence(data, length, frame);
+		if (length == 0)
+		{
+			return SIGFOX_ANSWER_ERROR;
+		}
+		data = frame;
+	}
+	
+	// convert from binary to ASCII
+	Utils.hex2str(data, ascii, length);
+	
+	#if DEBUG_SIGFOX > 1
+		PRINT_SIGFOX(F("ascii_command: "));
+		USB.println( ascii );
+	#endif	
+	
+	return SIGFOX_ANSWER_OK;
+}
+
+
+
+
+/*!
+ * @brief	This function starts sending a SIGFOX packet
+ * @param 	char* data:	data to be sent as hex digits (up to 24)
+ * @return	
+ * 	@arg	'SIGFOX_ANSWER_PENDING' if started
+ * 	@arg	'SIGFOX_ANSWER_ERROR' if the packet is too large
+ * 	@arg	'SIGFOX_ANSWER_RECOVERING' if the module is being recovered
+ */
+uint8_t LYNXBeeSigfox::beginSend(char* data)
+{
+	if (strlen(data) > 24)
+	{
+		USB.println(F("ERROR: Sigfox packet too large"));
+		return SIGFOX_ANSWER_ERROR;
+	}
+	
+	// create "AT$SF=<data>" command
+	GEN_ATCOMMAND_SET("SF", data);	
+	
+	// wait for the end of the transmission
+	_opUplink = (beginAT(_command, SIGFOX_OP_COMMAND, 15000) == SIGFOX_ANSWER_PENDING);
+	
+	return _opUplink ? SIGFOX_ANSWER_PENDING : SIGFOX_ANSWER_RECOVERING;
+}
+
+
+
+
+/*!
+ * @brief	This function starts sending a SIGFOX packet. The send-on-change
+ * 			filter is not applied.
+ * @param 	uint8_t* data:	pointer to the data to be sent
+ * @param 	uint16_t length: length of the buffer to send (truncated to 12)
+ * @remarks	if the sequence counter is enabled, it is appended to the data, 
+ * 			after a pending remote configuration acknowledge
+ * @return	
+ * 	@arg	'SIGFOX_ANSWER_PENDING' if started
+ * 	@arg	'SIGFOX_ANSWER_ERROR' if error
+ * 	@arg	'SIGFOX_ANSWER_RECOVERING' if the module is being recovered
+ */
+uint8_t LYNXBeeSigfox::beginSend(uint8_t* data, uint16_t length)
+{
+	//define buffer
+	char ascii_command[30];
+	uint8_t answer;
+	
+	answer = buildFrame(data, length, ascii_command);
+	if (answer != SIGFOX_ANSWER_OK)
+	{
+		return answer;
+	}
+	
+	answer = beginSend(ascii_command);
+	
+#if SIGFOX_FEATURE_DOWNLINK
+	// not started: the acknowledge waits for the next frame
+	_rcAckInFlight = _rcAckInFlight && (answer == SIGFOX_ANSWER_PENDING);
+#endif
+	
+	return answer;
+}
+
+
+
+
+#if SIGFOX_FEATURE_DOWNLINK
+/*!
+ * @brief	This function starts sending a SIGFOX packet requesting a downlink
+ * @param 	char* data:	data to be sent as hex digits (up to 24)
+ * @remarks	if the downlink policy is enabled and no downlink is due, the 
+ * 			packet is sent as with beginSend() and '_downlinkLength' stays 0
+ * @return	
+ * 	@arg	'SIGFOX_ANSWER_PENDING' if started
+ * 	@arg	'SIGFOX_ANSWER_ERROR' if the packet is too large
+ * 	@arg	'SIGFOX_ANSWER_RECOVERING' if the module is being recovered
+ */
+uint8_t LYNXBeeSigfox::beginSendACK(char* data)
+{
+	if (strlen(data) > 24)
+	{
+		USB.println(F("ERROR: Sigfox packet too large"));
+		return SIGFOX_ANSWER_ERROR;
+	}
+	
+	// keep the downlink budget for a frame which is sent
+	if (!healthReady())
+	{
+		return SIGFOX_ANSWER_RECOVERING;
+	}
+	
+	// no downlink worth its receive window: send a plain uplink
+	if (!downlinkDue())
+	{
+		_downlinkStats.downgraded++;
+		_downlinkStats.rxSaved += (_downlinkStats.requested > 0) ? 
+			(_downlinkStats.rxTime / _downlinkStats.requested) : SIGFOX_DOWNLINK_TIMEOUT;
+		_downlinkLength = 0;
+		
+		return beginSend(data);
+	}
+	
+	_downlinkStats.requested++;
+	_dlUsed++;
+	_dlLast = millis();
+	
+	// SvdW - create "AT$SF=<data>,1" command
+	GEN_ATCOMMAND_SET("SF", data, "1");	
+	
+	// forget any previous downlink
+	waitEvent(SIGFOX_EVENT_DOWNLINK, 0);
+	_downlinkLength = 0;
+	
+	// wait for the end of the uplink, then for the downlink
+	_opUplink = (beginAT(_command, SIGFOX_OP_SEND_ACK, 10000) == SIGFOX_ANSWER_PENDING);
+	
+	return _opUplink ? SIGFOX_ANSWER_PENDING : SIGFOX_ANSWER_RECOVERING;
+}
+
+
+
+
+/*!
+ * @brief	This function starts sending a SIGFOX packet requesting a 
+ * 			downlink. The send-on-change filter is not applied.
+ * @param 	uint8_t* data:	pointer to the data to be sent
+ * @param 	uint16_t length: length of the buffer to send (truncated to 12)
+ * @remarks	if the sequence counter is enabled, it is appended to the data, 
+ * 			after a pending remote configuration acknowledge
+ * @return	
+ * 	@arg	'SIGFOX_ANSWER_PENDING' if started
+ * 	@arg	'SIGFOX_ANSWER_ERROR' if error
+ * 	@arg	'SIGFOX_ANSWER_RECOVERING' if the module is being recovered
+ */
+uint8_t LYNXBeeSigfox::beginSendACK(uint8_t* data, uint16_t length)
+{
+	//define buffer
+	char ascii_command[30];
+	uint8_t answer;
+	
+	answer = buildFrame(data, length, ascii_command);
+	if (answer != SIGFOX_ANSWER_OK)
+	{
+		return answer;
+	}
+	
+	answer = beginSendACK(ascii_command);
+	
+	// not started: the acknowledge waits for the next frame
+	_rcAckInFlight = _rcAckInFlight && (answer == SIGFOX_ANSWER_PENDING);
+	
+	return answer;
+}
+#endif
+
+
+
+
+/*!
+ * @brief	This function starts setting the Sigfox RF power level and saving
+ * 			it. '_power' is updated when it succeeds.
+ * @param	uint8_t power: power level to be set in dBm
+ * @return	'SIGFOX_ANSWER_PENDING'
+ */
+uint8_t LYNXBeeSigfox::beginSetPower(uint8_t power)
+{
+	snprintf(_command, sizeof(_command), "ATS302=%u\r", power);
+	_atValue = power;
+	
+	return beginAT(_command, SIGFOX_OP_SET_POWER, 1000);
+}
+
+
+
+
+/*!
+ * @brief	This function starts setting the frequency and saving it. 
+ * 			'_frequency' is updated when it succeeds.
+ * @param	uint32_t freq: new working frequency
+ * @return	'SIGFOX_ANSWER_PENDING'
+ */
+uint8_t LYNXBeeSigfox::beginSetFrequency(uint32_t freq)
+{
+	snprintf(_command, sizeof(_command), "AT$IF=%lu\r", (unsigned long)freq);
+	_atValue = freq;
+	_configKnown &= ~SIGFOX_CONFIG_FREQUENCY;
+	
+	return beginAT(_command, SIGFOX_OP_SET_FREQUENCY, 1000);
+}
+
+
+
+
+/*!
+ * @brief	This function starts setting the keep-alive period
+ * @param 	uint8_t period: hours between keep-alive messages. '0' disables them
+ * @return	'SIGFOX_ANSWER_PENDING'
+ */
+uint8_t LYNXBeeSigfox::beginSendKeepAlive(uint8_t period)
+{
+	// create "ATS300=<period>" command
+	snprintf(_command, sizeof(_command),"ATS300=%u\r", period);
+	_configKnown &= ~SIGFOX_CONFIG_KEEP_ALIVE;
+	
+	return beginAT(_command, SIGFOX_OP_COMMAND, 10000);
+}
+
+
+
+
+/*!
+ * @brief	This function runs the current operation without blocking. Call it
+ * 			when data is received or timeLeftAT() has elapsed.
+ * @return	
+ * 	@arg	'SIGFOX_ANSWER_PENDING' if the operation is running
+ * 	@arg	'SIGFOX_ANSWER_OK' if OK
+ * 	@arg	'SIGFOX_ANSWER_ERROR' if error or no operation
+ * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
+ */
+uint8_t LYNXBeeSigfox::pollAT()
+{
+	uint8_t mask;
+	uint8_t events;
+	bool query = (_atOp == SIGFOX_OP_QUERY) || (_atOp == SIGFOX_OP_GET_ID);
+	
+	if (_atOp == SIGFOX_OP_NONE)
+	{
+		return SIGFOX_ANSWER_ERROR;
+	}
+	
+	if (_atOp == SIGFOX_OP_RECOVER)
+	{
+		return pollRecover();
+	}
+	
+	// events ending the current step
+	if ((_atOp == SIGFOX_OP_BOOT) && (_atStep == 0))
+	{
+		mask = 0;
+	}
+	else if (query && (_atStep == 0))
+	{
+		mask = SIGFOX_EVENT_LINE | SIGFOX_EVENT_ERROR;
+	}
+	else if ((_atOp == SIGFOX_OP_SEND_ACK) && (_atStep == 1))
+	{
+		mask = SIGFOX_EVENT_DOWNLINK | SIGFOX_EVENT_ERROR;
+	}
+	else
+	{
+		mask = SIGFOX_EVENT_OK | SIGFOX_EVENT_ERROR;
+	}
+	
+	events = serviceRX() & mask;
+	_rxEvents &= ~events;
+	
+#if SIGFOX_FEATURE_DOWNLINK
+	// the uplink is done: an urgent frame does not wait for the downlink
+	if (_urgentPending && (_atOp == SIGFOX_OP_SEND_ACK) && (_atStep == 1) && (events == 0))
+	{
+		_urgentStats.cancelled++;
+		return endAT(SIGFOX_ANSWER_CANCELLED);
+	}
+#endif
+	
+	// no valid answer at the boot rate: retry at the default rate, or at
+	// the highest one if the default rate was tried
+	bool fallback = (_atOp == SIGFOX_OP_BOOT) && (_atStep == 1);
+	uint32_t fallbackRate = (_bootRate != SIGFOX_RATE) ? SIGFOX_RATE : SIGFOX_RATE_MAX;
+	
+	if (events & SIGFOX_EVENT_ERROR)
+	{
+		if (fallback)
+		{
+			_opStats.retries++;
+			switchRate(fallbackRate);
+			writeAT("AT\r");
+			return nextAT(5000);
+		}
+		return endAT(SIGFOX_ANSWER_ERROR);
+	}
+	
+	if (events == 0)
+	{
+		// the module answered and then stopped talking
+		bool idle = (idleLeft() == 0);
+		
+		if (!idle && ((millis() - _atStart) < _atTimeout))
+		{
+			return SIGFOX_ANSWER_PENDING;
+		}
+		
+		if ((_atOp == SIGFOX_OP_BOOT) && ((_atStep == 0) || fallback))
+		{
+			// boot time elapsed: check communication
+			if (_atStep > 0)
+			{
+				_opStats.retries++;
+				switchRate(fallbackRate);
+			}
+			writeAT("AT\r");
+			return nextAT(5000);
+		}
+		
+		// the "OK" after a query line is optional; other answers without 
+		// their terminator are unexpected
+		if (!query || (_atStep == 0))
+		{
+			_healthAnomaly = idle;
+			return endAT(idle ? SIGFOX_ANSWER_ERROR : SIGFOX_NO_ANSWER);
+		}
+	}
+	
+	// step done
+	switch (_atOp)
+	{
+		case SIGFOX_OP_BOOT:
+			if (_atStep == 2)
+			{
+				// module answered at the fallback rate only: start there 
+				// from now on
+				_bootRate = _baudrate;
+				writeBootRate(_bootRate);
+			}
+			break;
+			
+
+		case SIGFOX_OP_QUERY:
+		case SIGFOX_OP_GET_ID:
+			if (_atStep == 0)
+			{
+				// consume the trailing "OK" so it is not taken as the 
+				// answer to the next command
+				return nextAT(100);
+			}
+			if (_atOp == SIGFOX_OP_GET_ID)
+			{
+				_id = parseHexValue();
+			}
+			break;
+			
+		case SIGFOX_OP_SEND_ACK:
+			if (_atStep == 0)
+			{
+				// SvdW - wait for the complete "RX=<data>" line
+				return nextAT(SIGFOX_DOWNLINK_TIMEOUT);
+			}
+			break;
+			
+		case SIGFOX_OP_SET_POWER:
+		case SIGFOX_OP_SET_FREQUENCY:
+			if (_atStep == 0)
+			{
+				// save config
+				writeAT("AT$WR\r");
+				return nextAT(1000);
+			}
+			if (_atOp == SIGFOX_OP_SET_POWER)	{ _power = _atValue; _powerKnown = true; }
+			else								{ _frequency = _atValue; _configKnown |= SIGFOX_CONFIG_FREQUENCY; }
+			break;
+			
+		default:
+			break;
+	}
+	
+	return endAT(SIGFOX_ANSWER_OK);
+}
+
+
+
+
+/*!
+ * @brief	This function returns the time left before the current step of 
+ * 			the operation times out, so callers know when to call pollAT()
+ * @return	time left (in ms). '0' if expired or no operation
+ */
+uint32_t LYNXBeeSigfox::timeLeftAT()
+{
+	unsigned long elapsed = millis() - _atStart;
+	uint32_t idle = idleLeft();
+	
+	if ((_atOp == SIGFOX_OP_NONE) || (elapsed >= _atTimeout))
+	{
+		return 0;
+	}
+	
+	// idle detection may end the step earlier
+	return ((_atTimeout - elapsed) < idle) ? (_atTimeout - elapsed) : idle;
+}
+
+
+
+
+
+//  Blocking functions  ///////////////////////////////////////////////////////
+
+
+
+/*!
+ * @brief	This function powers on the module
+ * @param 	uint8_t	socket: socket to be used: SOCKET0 or SOCKET1
+ * @return	
+ * 	@arg	'SIGFOX_ANSWER_OK' if OK
+ * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
+ * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
+ */
+uint8_t LYNXBeeSigfox::ON(uint8_t socket)
+{
+	// power on, wait for boot and check communication
+	beginON(socket);
+	
+	return waitAT();	
+}
+
+
+
+/*!
+ * @brief	This function powers down the module
+ * @param 	uint8_t	socket: socket to be used: SOCKET0 or SOCKET1
+ * @return	
+ * 	@arg	'SIGFOX_ANSWER_OK' if OK
+ * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
+ * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
+ */
+uint8_t LYNXBeeSigfox::OFF(uint8_t socket)
+{
+	// close uart
+	closeUART();	
+	
+	// unselect multiplexer 
+    if (_uart == SOCKET0)	Utils.setMuxUSB();
+    if (_uart == SOCKET1)	Utils.muxOFF1();
+		
+    // switch module OFF
+	PWR.powerSocket(_uart, LOW);
+	
+	return SIGFOX_ANSWER_OK;	
+}
+
+
+
+/*!
+ * @brief	Checks if LYNXBeeSigfox module is ready
+ * @return	
+ * 	@arg	'SIGFOX_ANSWER_OK' if OK
+ * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
+ * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
+ * 
+ */ 
+uint8_t LYNXBeeSigfox::check()
+{	
+	// send command
+	beginCheck();
+	
+	return waitAT();
+}
+
+/*!
+ * @brief	This function moves the UART to a new baudrate. Bytes received 
+ * 			at the old rate are discarded.
+ * @param	uint32_t rate: baudrate
+ * @return	void
+ */
+void LYNXBeeSigfox::switchRate(uint32_t rate)
+{
+	_baudrate = rate;
+	beginUART();
+	resetRX();
+}
+
+
+
+
+/*!
+ * @brief	This function switches the module and the UART to a higher 
+ * 			baudrate (SIGFOX_RATE_COMMAND), so commands and responses take 
+ * 			less time on the line. The new rate is verified with "AT"; if 
+ * 			that fails the previous rate is restored and, as a last resort,
+ * 			the module is power cycled (unsaved settings are lost).
+ * @param	uint32_t rate: baudrate (i.e. 115200)
+ * @param	bool save: 'true' to save the rate in the module with "AT$WR" 
+ * 			so it is used from the next power on. The rate is also stored in
+ * 			the EEPROM at SIGFOX_RATE_ADDRESS, so ON() tries it first even 
+ * 			after a reset of the microcontroller
+ * @return	
+ * 	@arg	'SIGFOX_ANSWER_OK' if the link runs at the new rate
+ * 	@arg	'SIGFOX_ANSWER_ERROR' if the module refused it or the rate did 
+ * 			not work (the link runs at the previous rate)
+ * 	@arg	'SIGFOX_NO_ANSWER' if the module could not be recovered
+ */
+uint8_t LYNXBeeSigfox::setBaudrate(uint32_t rate, bool save)
+{
+	uint32_t previous = _baudrate;
+	uint8_t answer;
+	
+	if (rate == _baudrate)
+	{
+		return SIGFOX_ANSWER_OK;
+	}
+	
+	// firmwares without the command answer "ERROR"
+	snprintf(_command, sizeof(_command), "%s%lu\r", SIGFOX_RATE_COMMAND, (unsigned long)rate);
+	answer = sendAT(_command, 1000);
+	if (answer != SIGFOX_ANSWER_OK)
+	{
+		return answer;
+	}
+	
+	// the module switches after its "OK"
+	delay(10);
+	switchRate(rate);
+	
+	if (check() == SIGFOX_ANSWER_OK)
+	{
+		if (!save)
+		{
+			return SIGFOX_ANSWER_OK;
+		}
+		
+		answer = saveSettings();
+		if (answer == SIGFOX_ANSWER_OK)
+		{
+			_bootRate = rate;
+			writeBootRate(rate);
+		}
+		return answer;
+	}
+	
+	#if DEBUG_SIGFOX > 0
+		PRINT_SIGFOX(F("baudrate not verified, falling back\n"));
+	#endif
+	
+	// module still at the previous rate?
+	switchRate(previous);
+	if (check() == SIGFOX_ANSWER_OK)
+	{
+		return SIGFOX_ANSWER_ERROR;
+	}
+	
+	// power cycle: the module starts at its saved rate
+	OFF(_uart);
+	delay(100);
+	if (ON(_uart) == SIGFOX_ANSWER_OK)
+	{
+		return SIGFOX_ANSWER_ERROR;
+	}
+	
+	return SIGFOX_NO_ANSWER;
+}
+
+
+
+
+/*!
+ * @brief	This function reads the module boot rate stored by setBaudrate()
+ * @return	baudrate, SIGFOX_RATE if none is stored
+ */
+uint32_t LYNXBeeSigfox::readBootRate()
+{
+	uint32_t rate = 0;
+	
+	for (uint8_t i = 0; i < 4; i++)
+	{
+		rate = (rate << 8) | Utils.readEEPROM(SIGFOX_RATE_ADDRESS + i);
+	}
+	
+	// an erased EEPROM reads 0xFFFFFFFF
+	if ((rate == 0) || (rate == 0xFFFFFFFFUL))
+	{
+		return SIGFOX_RATE;
+	}
+	
+	return rate;
+}
+
+
+
+
+/*!
+ * @brief	This function stores the module boot rate. Only changed EEPROM
+ * 			bytes are written.
+ * @param	uint32_t rate: baudrate
+ * @return	void
+ */
+void LYNXBeeSigfox::writeBootRate(uint32_t rate)
+{
+	uint8_t value;
+	
+	for (uint8_t i = 0; i < 4; i++)
+	{
+		value = (rate >> (24 - 8 * i)) & 0xFF;
+		if (Utils.readEEPROM(SIGFOX_RATE_ADDRESS + i) != value)
+		{
+			Utils.writeEEPROM(SIGFOX_RATE_ADDRESS + i, value);
+		}
+	}
+}
+
+
+
+
+#if SIGFOX_FEATURE_DIAG
+/*!
+ * @brief	Sets Public Key for testing with SNEK USB emulator
+ * @return
+ * 	@arg	'SIGFOX_ANSWER_OK' if OK
+ * 	@arg	'SIGFOX_ANSWER_ERROR' if error
+ * 	@arg	'SIGFOX_NO_ANSWER' if no answer
+ *
+ */
+uint8_t LYNXBeeSigfox::setPublicKey()
+{
+	// send command
+	return sendAT("ATS410=1\r", 5000);
+}
+#endif
+
+
+
+
+
+/*!
+ * @brief	This function is used to read the module's id
+ * @return	
+ * 	@arg	'SIGFOX_ANSWER_OK' if OK
+ * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
+ * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
+ */
+uint8_t LYNXBeeSigfox::getID()
+{
+	// send command, wait for the data line and get '_id' from it
+	beginGetID();
+	
+	return waitAT();	
+}
+
+
+uint8_t LYNXBeeSigfox::getPAC()
+{
+	uint8_t answer;
+	
+	// 1. send command and wait for the data line
+	answer = queryAT("AT$I=11\r", 2000);
+	
+	if (answer != SIGFOX_ANSWER_OK)
+	{
+		return answer;
+	}
+	
+	// 2. get value from received data
+	_pac = parseHexValue();	
+	
+	return SIGFOX_ANSWER_OK;	
+}
+
+
+/*!
+ * @brief	This function is used to configure the Sigfox RF power level in dBm
+ * @param	uint8_t power: power level to be set in dBm
+ * @return	
+ * 	@arg	'SIGFOX_ANSWER_OK' if OK
+ * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
+ * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
+ */
+uint8_t LYNXBeeSigfox::setPower(uint8_t power)
+{
+	// send command and save config
+	beginSetPower(power);
+	
+	return waitAT();	
+}
+
+
+
+/*!
+ * @brief	This function is used to read the configuration of the module's RF 
  * 			power level in dBm
  * @return	
- * 	@arg	'SIGFOX_ANSWER_OK' if OK
- * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
- * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
+ * 	@arg	'SIGFOX_ANSWER_OK' if OK
+ * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
+ * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
+ */
+uint8_t LYNXBeeSigfox::getPower()
+{
+	uint8_t answer;
+	
+	snprintf(_command, sizeof(_command), "ATS302?\r");
+	
+	// send command and wait for the data line
+	answer = queryAT(_command, 2000);
+	
+	if (answer != SIGFOX_ANSWER_OK)
+	{
+		return answer;
+	}
+	
+	// get value from received data
+	_power = parseUint8Value();	
+	_powerKnown = true;
+	
+	
+	return SIGFOX_ANSWER_OK;	
+}
+
+
+/*!
+ * @brief	This function stores the current settings in module's memory
+ * @return	
+ * 	@arg	'SIGFOX_ANSWER_OK' if OK
+ * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
+ * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
+ */
+uint8_t LYNXBeeSigfox::saveSettings()
+{	
+	// send command
+	return sendAT("AT$WR\r", 1000);
+}
+
+
+
+/*!
+ * @brief	set factory configuration
+ * @return	
+ * 	@arg	'SIGFOX_ANSWER_OK' if OK
+ * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
+ * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
+ * 
+ */
+uint8_t LYNXBeeSigfox::factorySettings()
+{
+	uint8_t status;	
+	
+	_configKnown = 0;
+#if SIGFOX_FEATURE_FCC
+	_fccCache = 0;
+#endif
+	
+	// SvdW - Factory default does not exist for this module.... just write AT
+	status = sendAT("AT\r", 1000);
+	if( status == SIGFOX_ANSWER_OK )
+	{
+		//save config
+		status = saveSettings();
+	}
+	return status;
+}
+
+
+
+/*!
+ * @brief	set default configuration previously stored in module's memory
+ * @return	
+ * 	@arg	'SIGFOX_ANSWER_OK' if OK
+ * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
+ * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
+ * 
+ */
+uint8_t LYNXBeeSigfox::defaultConfiguration()
+{
+	uint8_t answer;	
+	
+	// SvdW - Factory default does not exist for this module.... just write AT
+	answer = sendAT("AT\r", 1000);
+	if( answer == SIGFOX_ANSWER_OK )
+	{
+		delay(2000);
+	
+		// Check communication
+		answer = check();
+	}
+	return answer;
+}
+
+
+
+
+/*!
+ * @brief	get keep-alive period from module
+ * @return	
+ * 	@arg	'SIGFOX_ANSWER_OK' if OK
+ * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
+ * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
+ */
+uint8_t LYNXBeeSigfox::getKeepAlive()
+{
+	uint8_t answer;
+	
+	// send command and wait for the data line
+	answer = queryAT("ATS300?\r", 2000);
+	
+	if (answer == SIGFOX_ANSWER_OK)
+	{
+		// get value from received data
+		_keepAlive = parseUint8Value();
+		_configKnown |= SIGFOX_CONFIG_KEEP_ALIVE;
+	}
+	return answer;
+}
+
+
+
+/*!
+ * @brief	This function applies a configuration in a single pass: each 
+ * 			setting is compared with the module's, which is queried once 
+ * 			since ON (values read or written since are not read again), 
+ * 			then only the ones that differ are sent, followed by a single 
+ * 			"AT$WR". When nothing differs nothing is written, so it can be 
+ * 			called on every boot without wearing the module's NVM.
+ * 			'_changed' tells which settings were sent (see ConfigTypes).
+ * @param	const SigfoxConfig& config: settings to apply
+ * @return	
+ * 	@arg	'SIGFOX_ANSWER_OK' if OK
+ * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
+ * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
+ */
+uint8_t LYNXBeeSigfox::applyConfig(const SigfoxConfig& config)
+{
+	uint8_t answer;
+	uint8_t differ = 0;
+	
+	_changed = 0;
+	
+	// 1. compare, querying only the settings not known since ON
+	if (config.mask & SIGFOX_CONFIG_POWER)
+	{
+		if (!_powerKnown)
+		{
+			answer = getPower();
+			if (answer != SIGFOX_ANSWER_OK)		return answer;
+		}
+		if (_power != config.power)				differ |= SIGFOX_CONFIG_POWER;
+	}
+	
+	if (config.mask & SIGFOX_CONFIG_KEEP_ALIVE)
+	{
+		if (!(_configKnown & SIGFOX_CONFIG_KEEP_ALIVE))
+		{
+			answer = getKeepAlive();
+			if (answer != SIGFOX_ANSWER_OK)		return answer;
+		}
+		if (_keepAlive != config.keepAlive)		differ |= SIGFOX_CONFIG_KEEP_ALIVE;
+	}
+	
+	if (config.mask & SIGFOX_CONFIG_FREQUENCY)
+	{
+		if (!(_configKnown & SIGFOX_CONFIG_FREQUENCY))
+		{
+			answer = getFrequency();
+			if (answer != SIGFOX_ANSWER_OK)		return answer;
+		}
+		if (_frequency != config.frequency)		differ |= SIGFOX_CONFIG_FREQUENCY;
+	}
+	
+	if (differ == 0)
+	{
+		return SIGFOX_ANSWER_OK;
+	}
+	
+	// 2. send the settings that differ
+	if (differ & SIGFOX_CONFIG_POWER)
+	{
+		snprintf(_command, sizeof(_command), "ATS302=%u\r", config.power);
+		answer = sendAT(_command, 1000);
+		if (answer != SIGFOX_ANSWER_OK)			return answer;
+		_power = config.power;
+		_powerKnown = true;
+		_changed |= SIGFOX_CONFIG_POWER;
+	}
+	
+	if (differ & SIGFOX_CONFIG_KEEP_ALIVE)
+	{
+		snprintf(_command, sizeof(_command), "ATS300=%u\r", config.keepAlive);
+		answer = sendAT(_command, 10000);
+		if (answer != SIGFOX_ANSWER_OK)			return answer;
+		_keepAlive = config.keepAlive;
+		_configKnown |= SIGFOX_CONFIG_KEEP_ALIVE;
+		_changed |= SIGFOX_CONFIG_KEEP_ALIVE;
+	}
+	
+	if (differ & SIGFOX_CONFIG_FREQUENCY)
+	{
+		snprintf(_command, sizeof(_command), "AT$IF=%lu\r", (unsigned long)config.frequency);
+		answer = sendAT(_command, 1000);
+		if (answer != SIGFOX_ANSWER_OK)			return answer;
+		_frequency = config.frequency;
+		_configKnown |= SIGFOX_CONFIG_FREQUENCY;
+		_changed |= SIGFOX_CONFIG_FREQUENCY;
+	}
+	
+	// 3. save them all at once
+	return saveSettings();
+}
+
+
+
+/*!
+ * 
+ * @brief	This function sends a SIGFOX packet
+ * 
+ * @param 	char* data:	data to be sent
+ * @remarks	data is a sequence of digit representing the value of byte stream
+ * 			expressed in hexadecimal value (i.e.: AT$SF=12A435,0 – the payload 
+ * 			is composed by the following byte stream: 0x12, 0xA4, 0x35 – 6 digit
+ * 			converted in 3 bytes). The maximum length of frame is 24 digit (12Bytes)
+ * 
+ * @return	
+ * 	@arg	'SIGFOX_ANSWER_OK' if OK
+ * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
+ * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
+ * 	@arg	'SIGFOX_ANSWER_RECOVERING' if the module is being recovered
+ */
+uint8_t LYNXBeeSigfox::send(char* data)
+{
+	uint8_t answer;
+	
+	prepareUplink();
+	
+	// send "AT$SF=<data>" and wait for the end of the transmission
+	answer = beginSend(data);
+	
+	if (answer != SIGFOX_ANSWER_PENDING)
+	{
+		return answer;
+	}
+	
+	return waitAT();
+}
+
+
+
+
+/*!
+ * 
+ * @brief	This function sends a SIGFOX packet
+ * 
+ * @param 	uint8_t* data:	pointer to the data to be sent
+ * @param 	uint16_t length: length of the buffer to send
+ * @remarks	if the send-on-change filter is enabled, frames whose fields are 
+ * 			all within their deadband are not transmitted
+ * 
+ * @return	
+ * 	@arg	'SIGFOX_ANSWER_OK' if OK
+ * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
+ * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
+ * 	@arg	'SIGFOX_ANSWER_RECOVERING' if the module is being recovered
+ * 	@arg	'SIGFOX_ANSWER_SUPPRESSED' if suppressed by the filter
+ */
+uint8_t LYNXBeeSigfox::send(uint8_t* data, uint16_t length)
+{
+	uint8_t answer;
+	
+	// skip frames without relevant changes
+	if (filterFrame(data, length))
+	{
+		return SIGFOX_ANSWER_SUPPRESSED;
+	}
+	
+	prepareUplink();
+	
+	answer = beginSend(data, length);
+	
+	if (answer == SIGFOX_ANSWER_PENDING)
+	{
+		answer = waitAT();
+	}
+	
+	if (answer == SIGFOX_ANSWER_OK)
+	{
+		updateFilter(data, length);
+	}
+	
+	return answer;
+}
+
+
+
+
+
+#if SIGFOX_FEATURE_DOWNLINK
+/*!
+ * @brief	This function sends a SIGFOX packet
+ * 
+ * @param 	char* data:	data to be sent
+ * @remarks	data is a sequence of digit representing the value of byte stream
+ * 			expressed in hexadecimal value (i.e.: AT$SF=12A435,0 – the payload 
+ * 			is composed by the following byte stream: 0x12, 0xA4, 0x35 – 6 digit
+ * 			converted in 3 bytes). The maximum length of frame is 24 digit (12Bytes)
+ * @return	
+ * 	@arg	'SIGFOX_ANSWER_OK' if OK
+ * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
+ * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
+ * 	@arg	'SIGFOX_ANSWER_RECOVERING' if the module is being recovered
+ */
+uint8_t LYNXBeeSigfox::sendACK(char* data)
+{
+	uint8_t answer;
+	
+	prepareUplink();
+	
+	// send "AT$SF=<data>,1", wait for the end of the uplink and the downlink
+	answer = beginSendACK(data);
+	
+	if (answer != SIGFOX_ANSWER_PENDING)
+	{
+		return answer;
+	}
+	
+	answer = waitAT();
+	
+	// a remote configuration may have come with the downlink
+	applyRemote();
+	
+	return answer;
+}
+
+
+
+
+/*!
+ * 
+ * @brief	This function sends a SIGFOX packet waiting for an ACK
+ * 
+ * @param 	uint8_t* data:	pointer to the data to be sent
+ * @param 	uint16_t length: length of the buffer to send
+ * @remarks	if the send-on-change filter is enabled, frames whose fields are 
+ * 			all within their deadband are not transmitted
+ * 
+ * @return	
+ * 	@arg	'SIGFOX_ANSWER_OK' if OK
+ * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
+ * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
+ * 	@arg	'SIGFOX_ANSWER_RECOVERING' if the module is being recovered
+ * 	@arg	'SIGFOX_ANSWER_SUPPRESSED' if suppressed by the filter
+ */
+uint8_t LYNXBeeSigfox::sendACK(uint8_t* data, uint16_t length)
+{
+	uint8_t answer;
+	
+	// skip frames without relevant changes
+	if (filterFrame(data, length))
+	{
+		return SIGFOX_ANSWER_SUPPRESSED;
+	}
+	
+	prepareUplink();
+	
+	answer = beginSendACK(data, length);
+	
+	if (answer == SIGFOX_ANSWER_PENDING)
+	{
+		answer = waitAT();
+		applyRemote();
+	}
+	
+	if ((answer == SIGFOX_ANSWER_OK) || (answer == SIGFOX_ANSWER_CANCELLED))
+	{
+		updateFilter(data, length);
+	}
+	
+	return answer;
+}
+#endif
+
+
+
+
+/*!
+ * 
+ * @brief	This function sends a buffer larger than one Sigfox frame as a 
+ * 			sequence of fragments. Each fragment starts with a 1-byte header
+ * 			(see SigfoxFrame.h) followed by up to SIGFOX_FRAG_PAYLOAD bytes, 
+ * 			so the host can reassemble the message despite lost or reordered
+ * 			frames. Fragments are not passed through the send-on-change filter.
+ * 
+ * @param 	uint8_t* data:	pointer to the data to be sent
+ * @param 	uint16_t length: length of the buffer (up to SIGFOX_FRAG_MAX_LENGTH)
+ * 
+ * @return	
+ * 	@arg	'SIGFOX_ANSWER_OK' if all fragments were sent
+ * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
+ * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
+ */
+uint8_t LYNXBeeSigfox::sendFragmented(uint8_t* data, uint16_t length)
+{
+	uint8_t fragment[SIGFOX_MAX_PAYLOAD];
+	char ascii_command[2*SIGFOX_MAX_PAYLOAD + 1];
+	uint8_t count;
+	uint8_t size;
+	uint8_t answer = SIGFOX_ANSWER_ERROR;
+	
+	if ((length == 0) || (length > SIGFOX_FRAG_MAX_LENGTH))
+	{
+		#if DEBUG_SIGFOX > 0
+			PRINT_SIGFOX(F("wrong fragmented length\n"));
+		#endif
+		return SIGFOX_ANSWER_ERROR;
+	}
+	
+	count = (length + SIGFOX_FRAG_PAYLOAD - 1) / SIGFOX_FRAG_PAYLOAD;
+	
+	for (uint8_t i = 0; i < count; i++)
+	{
+		size = (length > SIGFOX_FRAG_PAYLOAD) ? SIGFOX_FRAG_PAYLOAD : length;
+		
+		fragment[0] = sigfoxFragHeader(_fragId, i, (i == count - 1));
+		memcpy(&fragment[SIGFOX_FRAG_HEADER_SIZE], data, size);
+		
+		// convert from binary to ASCII
+		Utils.hex2str(fragment, ascii_command, size + SIGFOX_FRAG_HEADER_SIZE);
+		
+		answer = send(ascii_command);
+		if (answer != SIGFOX_ANSWER_OK)
+		{
+			break;
+		}
+		
+		data += size;
+		length -= size;
+	}
+	
+	// next message
+	_fragId = (_fragId + 1) & SIGFOX_FRAG_ID_MASK;
+	
+	return answer;
+}
+
+
+
+
+#if SIGFOX_FEATURE_RF_TEST
+/*!
+ * 
+ * @brief	This function runs a burst of test transmissions and stores the
+ * 			per-frame timing, failures and burst duration in '_burst'. Frames 
+ * 			are scheduled every 'period' seconds from the start of the burst.
+ * @param	uint16_t count = 0..65535: Count of SIGFOX™ test RF messages. Default: 10
+ * @param	uint16_t period = 1..65535 Period in seconds between Sigfox test RF messages. Default: 10
+ * @param	int channel = 0..180 or 220..400 or -1 Use automatic channel selection (default)
+ * 			With -1 each slot sends a regular uplink holding the frame index,
+ * 			without the work send() does before an uplink (urgent frame, 
+ * 			telemetry, TX power, channel reset), so the slots hold the test
+ * 			frames only.
+ * 			Otherwise each slot radiates a continuous wave for 
+ * 			SIGFOX_BURST_CW_TIME ms on the given channel, since the module has
+ * 			no test frame mode. Channels have a 
+ * 			fixed 100 Hz bandwidth, starting at 868.180 MHz for channel 0, 
+ * 			ending at 868.198 Mhz for channel 180, restarting at 868.202 MHz for 
+ * 			channel 220 and ending at 868.220 MHz for channel 400.
+ * 
+ * @return	
+ * 	@arg	'SIGFOX_ANSWER_OK' if all frames were sent
+ * 	@arg	'SIGFOX_ANSWER_ERROR' if any frame failed
+ * 	@arg	'SIGFOX_NO_ANSWER' if no frame was answered
+ */
+uint8_t LYNXBeeSigfox::testTransmit(uint16_t count, uint16_t period, int channel)
+{
+	char payload[5];
+	uint32_t freq = 0;
+	uint32_t periodTime = (uint32_t)period * 1000UL;
+	unsigned long burstStart;
+	unsigned long slot;
+	unsigned long frameStart;
+	uint32_t frameTime;
+	uint8_t answer;
+	
+	memset(&_burst, 0x00, sizeof(_burst));
+	_burst.minTime = 0xFFFFFFFF;
+	
+	// get channel frequency
+	if ((channel >= 0) && (channel <= 180))
+	{
+		freq = 868180000UL + 100UL*channel;
+	}
+	else if ((channel >= 220) && (channel <= 400))
+	{
+		freq = 868202000UL + 100UL*(channel - 220);
+	}
+	else if (channel != -1)
+	{
+		return SIGFOX_ANSWER_ERROR;
+	}
+	
+	burstStart = millis();
+	slot = burstStart;
+	
+	for (uint16_t i = 0; i < count; i++)
+	{
+		// wait for the frame slot
+		if (i > 0)
+		{
+			slot += periodTime;
+			if ((long)(millis() - slot) > 0)
+			{
+				_burst.late++;
+			}
+			waitUntil(slot);
+		}
+		
+		frameStart = millis();
+		
+		if (freq == 0)
+		{
+			// uplink holding the frame index
+			snprintf(payload, sizeof(payload), "%04X", i);
+			answer = beginSend(payload);
+			if (answer == SIGFOX_ANSWER_PENDING)
+			{
+				answer = waitAT();
+			}
+		}
+		else
+		{
+			answer = continuosWave(freq, true);
+			if (answer == SIGFOX_ANSWER_OK)
+			{
+				waitUntil(millis() + SIGFOX_BURST_CW_TIME);
+				answer = continuosWave(freq, false);
+			}
+		}
+		
+		frameTime = millis() - frameStart;
+		
+		if (answer == SIGFOX_ANSWER_OK)
+		{
+			_burst.sent++;
+			_burst.totalTime += frameTime;
+			if (frameTime < _burst.minTime) _burst.minTime = frameTime;
+			if (frameTime > _burst.maxTime) _burst.maxTime = frameTime;
+		}
+		else if (answer == SIGFOX_ANSWER_ERROR)
+		{
+			_burst.failed++;
+		}
+		else
+		{
+			_burst.noAnswer++;
+		}
+		
+		#if DEBUG_SIGFOX > 1
+			PRINT_SIGFOX(F("burst frame: "));
+			USB.print(i);
+			USB.print(F(" answer: "));
+			USB.print(answer);
+			USB.print(F(" time: "));
+			USB.println(frameTime);
+		#endif
+	}
+	
+	_burst.elapsed = millis() - burstStart;
+	
+	if (_burst.sent == 0)
+	{
+		_burst.minTime = 0;
+	}
+	
+	if ((count > 0) && (_burst.noAnswer == count))
+	{
+		return SIGFOX_NO_ANSWER;
+	}
+	else if ((_burst.failed > 0) || (_burst.noAnswer > 0))
+	{
+		return SIGFOX_ANSWER_ERROR;
+	}
+	return SIGFOX_ANSWER_OK;
+}
+#endif
+
+
+
+
+
+#if SIGFOX_FEATURE_DIAG
+/*!
+ * 
+ * @brief	This function displays the library version number as follows: 
+ * 			SOFTxxxx, where 'xxxx' is the version number
+ * @return	
+ * 	@arg	'SIGFOX_ANSWER_OK' if OK
+ * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
+ * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
+ */
+uint8_t LYNXBeeSigfox::showFirmware()
+{
+	uint8_t status;
+	char* pointer;
+	
+	// send command and wait for the data line
+	status = queryAT("AT$I=9\r", 1000);
+	
+	if( status != SIGFOX_ANSWER_OK)
+	{
+		return status;
+	}
+	
+	// version is reported as "UDLxxxxxxxx"
+	pointer = strstr(_response, "UDL");
+	if (pointer == NULL)
+	{
+		return SIGFOX_ANSWER_ERROR;
+	}
+	
+	// clear buffers
+	memset(_firmware, 0x00, sizeof(_firmware));
+	strncpy(_firmware, pointer, sizeof(_firmware) - 1);
+	
+	USB.print(F("Firmware Version:"));
+	USB.println(_firmware);
+	
+	return SIGFOX_ANSWER_OK;	
+}
+#endif
+
+
+
+	
+/*!
+ * 
+ * @brief	This function sends a Keep-Alive message
+ * 
+ * @return	
+ * 	@arg	'SIGFOX_ANSWER_OK' if OK
+ * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
+ * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
+ */
+uint8_t LYNXBeeSigfox::sendKeepAlive()
+{
+	// use the default settings
+	return sendKeepAlive(24);
+}
+
+	
+/*!
+ * 
+ * @brief	This function sends a Keep-Alive message
+ * 
+ * @param 	uint8_t period: Number of hours. 0 Disable SIGFOX keepalive RF messages.
+ * 			1..127 Period between 2 SIGFOX keepalive RF messages in hours 
+ * 			(default value is 24)
+ * @return	
+ * 	@arg	'SIGFOX_ANSWER_OK' if OK
+ * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
+ * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
+ */
+uint8_t LYNXBeeSigfox::sendKeepAlive(uint8_t period)
+{
+	// set keep-alive setting
+	beginSendKeepAlive(period);
+	
+	return waitAT();
+}
+
+
+
+	
+#if SIGFOX_FEATURE_RF_TEST
+/*!
+ * 
+ * @brief	This function is used to radiate continuous wave without any modulation 
+ * 
+ * @param 	uint32_t freq: center frequency for carrier
+ * @param 	bool enable: '1'=enable; '0'=disable
+ * @return	
+ * 	@arg	'SIGFOX_ANSWER_OK' if OK
+ * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
+ * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
+ */
+uint8_t LYNXBeeSigfox::continuosWave(uint32_t freq, bool enable)
+{
+	char param1[20];
+	char param2[20];		
+
+	// convert to string	
+	ltoa((uint32_t)freq, param1, 10);
+	utoa((uint16_t)enable, param2, 10);
+	
+	// create "AT$CW=freq,<enable>,24" command - defasulty 24dbm for RCZ4
+	GEN_ATCOMMAND_SET("CW", param1, param2, "24");
+		
+	// set CW mode: enabled or disabled
+	return sendAT(_command, 500);
+}
+#endif
+
+
+
+
+//  RF functions  //////////////////////////////////////////////////////////////
+
+
+
+
+/*!
+ * @brief	set frequency and save settings
+ * @param	uint32_t freq: new working frequency
+ * @return	
+ * 	@arg	'SIGFOX_ANSWER_OK' if OK
+ * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
+ * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
+ * 
+ */
+uint8_t LYNXBeeSigfox::setFrequency(uint32_t freq)
+{
+	// set frequency and save config
+	beginSetFrequency(freq);
+	
+	return waitAT();
+}
+
+
+
+
+
+/*!
+ * @brief	get frequency from module
+ * @return	
+ * 	@arg	'SIGFOX_ANSWER_OK' if OK
+ * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
+ * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
+ * 
+ */
+uint8_t LYNXBeeSigfox::getFrequency()
+{
+	uint8_t status;	
+	
+	// send command and wait for the data line
+	status = queryAT("AT$IF?\r", 2000);
+
+	if( status == SIGFOX_ANSWER_OK )
+	{
+		// get value from received data
+		_frequency = parseUint32Value();	
+		_configKnown |= SIGFOX_CONFIG_FREQUENCY;
+	}
+	return status;
+}
+
+
+
+#if SIGFOX_FEATURE_LAN
+/*!
+ * @brief	set powel level for RF transmissions
+ * @param	int power: power level to set
+ * @return	
+ * 	@arg	'SIGFOX_ANSWER_OK' if OK
+ * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
+ * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
+ * 
+ */
+uint8_t LYNXBeeSigfox::setPowerLAN(int power)
+{
+	uint8_t status;	
+	
+	if ((power < 0) || (power > 24)) return 1; // error
+				
+	snprintf(_command, sizeof(_command), "ATS302=%d\r", power);
+	
+	status = sendAT(_command, 1000);
+	if( status == SIGFOX_ANSWER_OK )
+	{
+		// ok
+		status = saveSettings();
+		if (status == SIGFOX_ANSWER_OK) _powerLAN = power;
+	}
+	return status;
+}
+
+
+
+
+
+/*!
+ * @brief	get Power level from module in decimal format
+ * @return	
+ * 	@arg	'SIGFOX_ANSWER_OK' if OK
+ * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
+ * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
+ * 
+ */
+uint8_t LYNXBeeSigfox::getPowerLAN()
+{
+	uint8_t status;	
+	
+	// send command and wait for the data line
+	status = queryAT("ATS302?\r", 2000);
+
+	if( status == SIGFOX_ANSWER_OK )
+	{
+		// get value from received data
+		_powerLAN = parseUint8Value();	
+	}
+	return status;
+}
+
+
+/*!
+ * @brief	Prints data received through USB
+ * @return	void
+ * 
+ */
+ void LYNXBeeSigfox::showPacket()
+{		
+	USB.println(_response);
+}
+#endif
+
+
+
+
+
+//  Send-on-change filter  ////////////////////////////////////////////////////
+
+
+
+/*!
+ * @brief	This function configures a field compared by the send-on-change 
+ * 			filter. Bytes not covered by any field are not compared.
+ * @param	uint8_t index: field index (0..SIGFOX_FILTER_FIELDS-1)
+ * @param	uint8_t offset: first byte of the field inside the frame
+ * @param	uint8_t size: field size in bytes, MSB first (1..4). '0' to 
+ * 			remove the field
+ * @param	uint16_t deadband: maximum change from the last transmitted value
+ * 			which does not trigger a transmission. '0' for any change
+ * @param	bool isSigned: 'true' if the field is a two's complement value
+ * @return	
+ * 	@arg	'SIGFOX_ANSWER_OK' if OK
+ * 	@arg	'SIGFOX_ANSWER_ERROR' if wrong parameters
+ */
+uint8_t LYNXBeeSigfox::setFilterField(	uint8_t index, 
+										uint8_t offset, 
+										uint8_t size, 
+										uint16_t deadband, 
+										bool isSigned)
+{
+	if ((index >= SIGFOX_FILTER_FIELDS) || (size > 4) || (offset + size > 12))
+	{
+		return SIGFOX_ANSWER_ERROR;
+	}
+	
+	_filterFields[index].offset = offset;
+	_filterFields[index].size = size;
+	_filterFields[index].isSigned = isSigned;
+	_filterFields[index].deadband = deadband;
+	_filterFields[index].last = 0;
+	
+	// next frame is always transmitted
+	_filterPrimed = false;
+	
+	return SIGFOX_ANSWER_OK;
+}
+
+
+
+
+/*!
+ * @brief	This function enables the send-on-change filter in front of the 
+ * 			binary send() and sendACK() functions. The first frame is always
+ * 			transmitted. Fields must be configured with setFilterField().
+ * @param	uint16_t heartbeat: maximum number of consecutive suppressed 
+ * 			frames before one is transmitted anyway. With a fixed sampling
+ * 			period this is the maximum silence interval, so the module 
+ * 			keep-alive can be disabled with sendKeepAlive(0). '0' never 
+ * 			forces a frame
+ * @return	void
+ */
+void LYNXBeeSigfox::enableFilter(uint16_t heartbeat)
+{
+	_filterEnabled = true;
+	_filterPrimed = false;
+	_filterHeartbeat = heartbeat;
+	_filterSilence = 0;
+	_suppressed = 0;
+}
+
+
+
+
+/*!
+ * @brief	This function disables the send-on-change filter and clears the 
+ * 			configured fields
+ * @return	void
+ */
+void LYNXBeeSigfox::disableFilter()
+{
+	_filterEnabled = false;
+	memset(_filterFields, 0x00, sizeof(_filterFields));
+}
+
+
+
+
+
+//  Transmit slot scheduler  /////////////////////////////////////////////////
+
+
+
+/*!
+ * @brief	This function mixes the bits of a value (MurmurHash3 finalizer),
+ * 			so close module ids give unrelated jitter sequences
+ * @param	uint32_t value: value
+ * @return	mixed value
+ */
+static uint32_t mixBits(uint32_t value)
+{
+	value ^= value >> 16;
+	value *= 0x85EBCA6BUL;
+	value ^= value >> 13;
+	value *= 0xC2B2AE35UL;
+	value ^= value >> 16;
+	
+	return value;
+}
+
+
+
+
+/*!
+ * @brief	This function sets up the transmit slot scheduler. Devices which
+ * 			wake up on the same schedule would otherwise transmit at the 
+ * 			same time and collide: the sampling period is split in slots, 
+ * 			each device takes the slot given by its module id and transmits
+ * 			at a random point inside it. Call getID() first.
+ * @param	uint32_t period: sampling period (in ms)
+ * @param	uint16_t slots: number of slots in the period. Slots shorter than
+ * 			SIGFOX_UPLINK_TIME leave no room for the jitter to separate 
+ * 			devices sharing a slot. '0' disables the scheduler
+ * @return	void
+ */
+void LYNXBeeSigfox::setSlots(uint32_t period, uint16_t slots)
+{
+	_slotPeriod = period;
+	_slotCount = slots;
+	
+	// jitter sequence of this device, never zero
+	_slotSeed = mixBits(_id ^ 0xA5A5A5A5UL) | 0x01;
+}
+
+
+
+
+/*!
+ * @brief	This function returns when to transmit in the current period
+ * @return	delay from the start of the period (in ms): start of the slot 
+ * 			of this device plus a new jitter on every call. '0' if the 
+ * 			scheduler is disabled
+ */
+uint32_t LYNXBeeSigfox::nextSlot()
+{
+	uint32_t width;
+	uint32_t span;
+	
+	if ((_slotCount == 0) || (_slotPeriod == 0))
+	{
+		return 0;
+	}
+	
+	width = _slotPeriod / _slotCount;
+	
+	// keep the whole transmission inside the slot when it fits
+	span = (width > SIGFOX_UPLINK_TIME) ? (width - SIGFOX_UPLINK_TIME) : width;
+	
+	// xorshift32
+	_slotSeed ^= _slotSeed << 13;
+	_slotSeed ^= _slotSeed >> 17;
+	_slotSeed ^= _slotSeed << 5;
+	
+	// modules of a batch have consecutive ids: they get consecutive slots
+	return (_id % _slotCount) * width + (span ? (_slotSeed % span) : 0);
+}
+
+
+
+
+
+//  Sequence counter  ////////////////////////////////////////////////////////
+
+
+
+/*!
+ * @brief	This function enables the sequence counter: every uplink started
+ * 			with send(uint8_t*, uint16_t) or sendACK(uint8_t*, uint16_t) 
+ * 			gets the counter appended (see SigfoxFrame.h), so the backend can
+ * 			count lost and repeated frames. The counter is kept in a ring of
+ * 			SIGFOX_SEQ_SLOTS EEPROM slots at SIGFOX_SEQ_ADDRESS and goes on 
+ * 			from its exact value after a power cycle.
+ * @param	uint8_t bits: counter width, 1 to 16 bits. It takes 
+ * 			sigfoxSeqSize(bits) bytes of the 12-byte frame.
+ * @return	void
+ */
+void LYNXBeeSigfox::enableSequence(uint8_t bits)
+{
+	uint16_t value;
+	uint16_t next;
+	
+	if (bits > SIGFOX_SEQ_MAX_BITS)
+	{
+		bits = SIGFOX_SEQ_MAX_BITS;
+	}
+	
+	_seqBits = bits;
+	
+	// slots are written in turn with consecutive values: the last one 
+	// written is the first not followed by its value plus one
+	_seqSlot = SIGFOX_SEQ_SLOTS - 1;
+	value = readSequence(0);
+	for (uint8_t i = 0; i < SIGFOX_SEQ_SLOTS - 1; i++)
+	{
+		next = readSequence(i + 1);
+		if (next != (uint16_t)(value + 1))
+		{
+			_seqSlot = i;
+			break;
+		}
+		value = next;
+	}
+	_sequence = value;
+	
+	// an erased EEPROM reads 0xFFFF in every slot
+	if ((value == 0xFFFF) && (_seqSlot == 0) && (readSequence(1) == 0xFFFF))
+	{
+		_sequence = 0;
+		_seqSlot = SIGFOX_SEQ_SLOTS - 1;
+	}
+}
+
+
+
+
+/*!
+ * @brief	This function disables the sequence counter. The stored value is 
+ * 			kept.
+ * @return	void
+ */
+void LYNXBeeSigfox::disableSequence()
+{
+	_seqBits = 0;
+}
+
+
+
+
+/*!
+ * @brief	This function appends the sequence counter to a frame, then 
+ * 			counts the uplink and stores the counter in the next slot of the
+ * 			ring, so each EEPROM cell is written once every SIGFOX_SEQ_SLOTS
+ * 			uplinks. Only changed EEPROM bytes are written.
+ * @param	uint8_t* data: payload
+ * @param	uint16_t length: payload length
+ * @param	uint8_t* frame: SIGFOX_MAX_PAYLOAD bytes receiving the frame
+ * @return	frame length, '0' if the counter does not fit
+ */
+uint16_t LYNXBeeSigfox::addSequence(uint8_t* data, uint16_t length, uint8_t* frame)
+{
+	uint8_t size = sigfoxSeqSize(_seqBits);
+	
+	if (length + size > SIGFOX_MAX_PAYLOAD)
+	{
+		#if DEBUG_SIGFOX > 0
+			PRINT_SIGFOX(F("no room for the sequence counter\n"));
+		#endif
+		return 0;
+	}
+	
+	if (frame != data)
+	{
+		memcpy(frame, data, length);
+	}
+	length += size;
+	sigfoxPutSeq(frame, length, _sequence & (uint16_t)((1UL << _seqBits) - 1), _seqBits);
+	
+	// a frame which may leave the module uses its number
+	_sequence++;
+	_seqSlot = (_seqSlot + 1) % SIGFOX_SEQ_SLOTS;
+	writeSequence(_seqSlot, _sequence);
+	
+	return length;
+}
+
+
+
+
+/*!
+ * @brief	This function reads a slot of the sequence counter ring
+ * @param	uint8_t slot: slot (0 to SIGFOX_SEQ_SLOTS - 1)
+ * @return	stored counter, 0xFFFF if erased
+ */
+uint16_t LYNXBeeSigfox::readSequence(uint8_t slot)
+{
+	int address = SIGFOX_SEQ_ADDRESS + 2 * slot;
+	
+	return ((uint16_t)Utils.readEEPROM(address) << 8) | Utils.readEEPROM(address + 1);
+}
+
+
+
+
+/*!
+ * @brief	This function writes a slot of the sequence counter ring. Only 
+ * 			changed bytes are written.
+ * @param	uint8_t slot: slot (0 to SIGFOX_SEQ_SLOTS - 1)
+ * @param	uint16_t value: counter
+ * @return	void
+ */
+void LYNXBeeSigfox::writeSequence(uint8_t slot, uint16_t value)
+{
+	int address = SIGFOX_SEQ_ADDRESS + 2 * slot;
+	
+	if (Utils.readEEPROM(address) != (value >> 8))
+	{
+		Utils.writeEEPROM(address, value >> 8);
+	}
+	if (Utils.readEEPROM(address + 1) != (value & 0xFF))
+	{
+		Utils.writeEEPROM(address + 1, value & 0xFF);
+	}
+}
+
+
+
+
+
+//  Adaptive TX power  ////////////////////////////////////////////////////////
+
+
+
+//! Module supply current while transmitting, every 2 dBm from 0 dBm (in mA)
+static const uint16_t txCurrent[] = { 11, 12, 13, 14, 16, 20, 26, 35, 50, 74, 111, 170, 264 };
+
+#define TX_CURRENT_LEVELS	(sizeof(txCurrent) / sizeof(txCurrent[0]))
+
+
+
+/*!
+ * @brief	This function estimates the energy of an uplink
+ * @param	uint8_t power: TX power (in dBm)
+ * @return	energy (in uJ)
+ */
+static uint32_t uplinkEnergy(uint8_t power)
+{
+	uint8_t index = power >> 1;
+	uint32_t current;
+	
+	if (index >= TX_CURRENT_LEVELS - 1)
+	{
+		current = txCurrent[TX_CURRENT_LEVELS - 1];
+	}
+	else
+	{
+		// odd levels halfway
+		current = (power & 0x01) ? (txCurrent[index] + txCurrent[index + 1]) / 2 : txCurrent[index];
+	}
+	
+	// uW * (ms / 100) / 10 = uJ, kept below 2^32
+	return current * SIGFOX_SUPPLY_VOLTAGE * (SIGFOX_UPLINK_TIME / 100) / 10;
+}
+
+
+
+
+/*!
+ * @brief	This function enables the adaptive TX power controller. Before
+ * 			each send() or sendACK() the power is moved towards the lowest 
+ * 			level that still reaches the network:
+ * 			- reportLink(): RSSI at the base station reported by the backend
+ * 			  (i.e. in a downlink). Below the target the power goes up at 
+ * 			  once; more than SIGFOX_POWER_HYSTERESIS dB above it, it goes 
+ * 			  down into that band.
+ * 			- sendACK(): a missing downlink raises the power by 2 steps, 
+ * 			  SIGFOX_POWER_GOOD downlinks in a row lower it by 1 step.
+ * 			Levels are written without "AT$WR", so they do not wear the NVM 
+ * 			and the module boots again with the power saved by setPower().
+ * @param	uint8_t minPower: lowest power (in dBm)
+ * @param	uint8_t maxPower: highest power (in dBm), also the starting level
+ * 			if the power of the module is unknown
+ * @param	int16_t targetRSSI: RSSI to keep at the base station (in dBm)
+ * @return	void
+ */
+void LYNXBeeSigfox::enablePowerControl(uint8_t minPower, uint8_t maxPower, int16_t targetRSSI)
+{
+	if (minPower > maxPower)
+	{
+		minPower = maxPower;
+	}
+	
+	_pcMin = minPower;
+	_pcMax = maxPower;
+	_pcTarget = targetRSSI;
+	_pcGood = 0;
+	
+	// start from the current level
+	_pcLevel = _powerKnown ? _power : _pcMax;
+	if (_pcLevel < _pcMin)	_pcLevel = _pcMin;
+	if (_pcLevel > _pcMax)	_pcLevel = _pcMax;
+	
+	_pcEnabled = true;
+}
+
+
+
+
+/*!
+ * @brief	This function disables the adaptive TX power controller. The
+ * 			module keeps the last level until it is powered off.
+ * @return	void
+ */
+void LYNXBeeSigfox::disablePowerControl()
+{
+	_pcEnabled = false;
+}
+
+
+
+
+/*!
+ * @brief	This function feeds the controller with the RSSI of the last 
+ * 			uplink at the base station
+ * @param	int16_t rssi: RSSI (in dBm)
+ * @return	void
+ */
+void LYNXBeeSigfox::reportLink(int16_t rssi)
+{
+	int16_t margin = rssi - _pcTarget;
+	
+	if (!_pcEnabled)
+	{
+		return (void)0;
+	}
+	
+	if (margin < 0)
+	{
+		// back above the target at once
+		stepPower(((-margin + SIGFOX_POWER_STEP - 1) / SIGFOX_POWER_STEP) * SIGFOX_POWER_STEP);
+	}
+	else if (margin > SIGFOX_POWER_HYSTERESIS)
+	{
+		// down into the hysteresis band
+		stepPower(-((margin - SIGFOX_POWER_HYSTERESIS) / SIGFOX_POWER_STEP + 1) * SIGFOX_POWER_STEP);
+	}
+}
+
+
+
+
+/*!
+ * @brief	This function writes the level chosen by the controller to the 
+ * 			module, if it differs from the level the module has. send() and
+ * 			sendACK() call it; call it before beginSend() or beginSendACK().
+ * @return	
+ * 	@arg	'SIGFOX_ANSWER_OK' if OK or nothing to write
+ * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
+ * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
+ */
+uint8_t LYNXBeeSigfox::adjustPower()
+{
+	if (!_pcEnabled)
+	{
+		return SIGFOX_ANSWER_OK;
+	}
+	
+	return writePower(_pcLevel);
+}
+
+
+
+
+/*!
+ * @brief	This function sets the RF power without saving it. The command is
+ * 			skipped when the module already has that power.
+ * @param	uint8_t power: power level in dBm
+ * @return	
+ * 	@arg	'SIGFOX_ANSWER_OK' if OK
+ * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
+ * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
+ */
+uint8_t LYNXBeeSigfox::writePower(uint8_t power)
+{
+	uint8_t answer;
+	
+	if (_powerKnown && (_power == power))
+	{
+		return SIGFOX_ANSWER_OK;
+	}
+	
+	snprintf(_command, sizeof(_command), "ATS302=%u\r", power);
+	answer = sendAT(_command, 1000);
+	
+	if (answer == SIGFOX_ANSWER_OK)
+	{
+		_power = power;
+		_powerKnown = true;
+		_powerStats.writes++;
+	}
+	
+	return answer;
+}
+
+
+
+
+/*!
+ * @brief	This function moves the controller level and reports the energy 
+ * 			saved per uplink in '_powerStats'
+ * @param	int8_t step: change (in dB), kept within the controller limits
+ * @return	void
+ */
+void LYNXBeeSigfox::stepPower(int8_t step)
+{
+	int16_t level = (int16_t)_pcLevel + step;
+	
+	if (level < _pcMin)		level = _pcMin;
+	if (level > _pcMax)		level = _pcMax;
+	
+	if (level == _pcLevel)
+	{
+		return (void)0;
+	}
+	
+	_powerStats.power = level;
+	_powerStats.step = level - _pcLevel;
+	_powerStats.saving = (int32_t)uplinkEnergy(_pcLevel) - (int32_t)uplinkEnergy(level);
+	_powerStats.steps++;
+	_pcLevel = level;
+	
+	#if DEBUG_SIGFOX > 0
+		PRINT_SIGFOX(F("power "));
+		USB.print(_powerStats.power, DEC);
+		USB.print(F(" dBm, saves "));
+		USB.print((long)_powerStats.saving, DEC);
+		USB.println(F(" uJ per uplink"));
+	#endif
+}
+
+
+
+
+/*!
+ * @brief	This function feeds the controller with the result of a downlink
+ * 			request
+ * @param	bool received: 'true' if the downlink was received
+ * @return	void
+ */
+void LYNXBeeSigfox::powerFeedback(bool received)
+{
+	if (!_pcEnabled)
+	{
+		return (void)0;
+	}
+	
+	if (!received)
+	{
+		_pcGood = 0;
+		stepPower(2 * SIGFOX_POWER_STEP);
+	}
+	else if (++_pcGood >= SIGFOX_POWER_GOOD)
+	{
+		_pcGood = 0;
+		stepPower(-SIGFOX_POWER_STEP);
+	}
+}
+
+
+
+
+
+/*!
+ * @brief	This function prepares the module before an uplink of send() or
+ * 			sendACK(): a received remote configuration is applied, a queued
+ * 			urgent frame goes first, then a telemetry frame when due, TX 
+ * 			power of the controller and micro channels (see prepareRadio()).
+ * @return	void
+ */
+void LYNXBeeSigfox::prepareUplink()
+{
+#if SIGFOX_FEATURE_DOWNLINK
+	applyRemote();
+#endif
+	
+	if (_urgentPending)
+	{
+		sendUrgent();
+	}
+	
+#if SIGFOX_FEATURE_TELEMETRY
+	if ((_tlmEvery > 0) && (++_tlmCount >= _tlmEvery))
+	{
+		_tlmCount = 0;
+		sendTelemetry();
+	}
+#endif
+	
+	prepareRadio();
+}
+
+
+
+
+/*!
+ * @brief	This function prepares the radio before an uplink: TX power of
+ * 			the controller and, on FCC modules, a micro channel reset when 
+ * 			needed. The micro channel taken by each uplink is counted by 
+ * 			endAT().
+ * @return	void
+ */
+void LYNXBeeSigfox::prepareRadio()
+{
+	adjustPower();
+	
+#if SIGFOX_FEATURE_FCC
+	serviceChannel();
+#endif
+}
+
+
+
+
+
+//  Health monitor  ///////////////////////////////////////////////////////////
+
+
+
+/*!
+ * @brief	This function starts recovering the module: the UART is flushed 
+ * 			and "AT" is sent up to SIGFOX_RESYNC_TRIES times, then the socket
+ * 			is power cycled and the module booted as with beginON(). The 
+ * 			health monitor starts it after SIGFOX_HEALTH_FAILURES failed or 
+ * 			garbled answers in a row; until it ends, commands are refused 
+ * 			with 'SIGFOX_ANSWER_RECOVERING' instead of waiting for their 
+ * 			timeout, and each refused command moves the recovery on.
+ * @return	'SIGFOX_ANSWER_PENDING'
+ */
+uint8_t LYNXBeeSigfox::beginRecover()
+{
+	_health = SIGFOX_HEALTH_RESYNC;
+	_healthStats.resyncs++;
+	
+	// drop whatever was half received
+	serialFlush(_uart);
+	resetRX();
+	
+	writeAT("AT\r");
+	
+	_atOp = SIGFOX_OP_RECOVER;
+	_atStep = 0;
+	_atStart = millis();
+	_atTimeout = SIGFOX_RESYNC_TIMEOUT;
+	_opBegin = _atStart;
+	
+	return SIGFOX_ANSWER_PENDING;
+}
+
+
+
+
+/*!
+ * @brief	This function recovers the module now, waiting for the resync 
+ * 			and, if needed, the power cycle
+ * @return	
+ * 	@arg	'SIGFOX_ANSWER_OK' if the module answers again
+ * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
+ * 	@arg	'SIGFOX_NO_ANSWER' if no answer after the power cycle
+ */
+uint8_t LYNXBeeSigfox::recover()
+{
+	uint8_t answer;
+	
+	beginRecover();
+	
+	while ((answer = pollAT()) == SIGFOX_ANSWER_PENDING)
+	{
+		if (_sleepWhileWaiting)
+		{
+			idle();
+		}
+	}
+	
+	return answer;
+}
+
+
+
+
+/*!
+ * @brief	This function tells if a command can be sent. A running recovery
+ * 			is moved on first, and one is started again once 
+ * 			SIGFOX_HEALTH_BACKOFF has elapsed after a failed power cycle.
+ * @return	'false' if the module is being recovered
+ */
+bool LYNXBeeSigfox::healthReady()
+{
+	if (_health < SIGFOX_HEALTH_RESYNC)
+	{
+		return true;
+	}
+	
+	if (_health != SIGFOX_HEALTH_DOWN)
+	{
+		pollAT();
+	}
+	else if ((millis() - _healthSince) >= SIGFOX_HEALTH_BACKOFF)
+	{
+		beginRecover();
+	}
+	
+	if (_health < SIGFOX_HEALTH_RESYNC)
+	{
+		return true;
+	}
+	
+	_healthStats.failFast++;
+	
+	return false;
+}
+
+
+
+
+/*!
+ * @brief	This function updates the health monitor when an operation ends
+ * @param	uint8_t answer: result of the operation
+ * @return	void
+ */
+void LYNXBeeSigfox::checkHealth(uint8_t answer)
+{
+	bool failed = (answer == SIGFOX_NO_ANSWER) || _healthAnomaly || 
+		(_rxEvents & SIGFOX_EVENT_OVERFLOW);
+	
+	_healthAnomaly = false;
+	_rxEvents &= ~SIGFOX_EVENT_OVERFLOW;
+	
+	// end of a recovery: resync or boot after the power cycle
+	if (_health >= SIGFOX_HEALTH_RESYNC)
+	{
+		if (answer == SIGFOX_ANSWER_OK)
+		{
+			_health = SIGFOX_HEALTH_OK;
+			_healthFails = 0;
+			_healthStats.recoveries++;
+		}
+		else
+		{
+			_health = SIGFOX_HEALTH_DOWN;
+			_healthSince = millis();
+		}
+		return;
+	}
+	
+	// "ERROR" is an answer: the module is listening
+	if (!failed)
+	{
+		_health = SIGFOX_HEALTH_OK;
+		_healthFails = 0;
+		return;
+	}
+	
+	_healthStats.failures++;
+	_healthFails++;
+	_health = SIGFOX_HEALTH_SUSPECT;
+	
+	if (_healthFails >= SIGFOX_HEALTH_FAILURES)
+	{
+		beginRecover();
+	}
+}
+
+
+
+
+/*!
+ * @brief	This function runs the recovery operation
+ * @return	
+ * 	@arg	'SIGFOX_ANSWER_PENDING' if the recovery is running
+ * 	@arg	'SIGFOX_ANSWER_OK' if the module answered the resync
+ */
+uint8_t LYNXBeeSigfox::pollRecover()
+{
+	uint8_t events = serviceRX() & (SIGFOX_EVENT_OK | SIGFOX_EVENT_ERROR);
+	
+	_rxEvents &= ~events;
+	
+	// power off time
+	if (_atStep >= SIGFOX_RESYNC_TRIES)
+	{
+		if ((millis() - _atStart) < _atTimeout)
+		{
+			return SIGFOX_ANSWER_PENDING;
+		}
+		
+		// boot and check communication, the boot ends the recovery
+		beginON(_uart);
+		_health = SIGFOX_HEALTH_RESET;
+		
+		return SIGFOX_ANSWER_PENDING;
+	}
+	
+	if (events & SIGFOX_EVENT_OK)
+	{
+		return endAT(SIGFOX_ANSWER_OK);
+	}
+	
+	if ((events == 0) && ((millis() - _atStart) < _atTimeout))
+	{
+		return SIGFOX_ANSWER_PENDING;
+	}
+	
+	// "ERROR" (i.e. after a partial command) or no answer: try again
+	if (_atStep + 1 < SIGFOX_RESYNC_TRIES)
+	{
+		_opStats.retries++;
+		resetRX();
+		writeAT("AT\r");
+		
+		return nextAT(SIGFOX_RESYNC_TIMEOUT);
+	}
+	
+	// still wedged: power cycle the socket
+	OFF(_uart);
+	_health = SIGFOX_HEALTH_RESET;
+	_healthStats.powerCycles++;
+	
+	return nextAT(SIGFOX_POWER_OFF_TIME);
+}
+
+
+
+
+
+//  Urgent frames  ////////////////////////////////////////////////////////////
+
+
+
+/*!
+ * @brief	This function queues an urgent frame (i.e. an alarm). It only 
+ * 			copies the frame, so it can be called from an interrupt routine:
+ * 			beginUrgent() takes the frame with interrupts disabled.
+ * 			The frame is sent before the next uplink of send() or sendACK(),
+ * 			and a running downlink wait of sendACK() is given up for it once
+ * 			the uplink is done: sendACK() then sends it and returns 
+ * 			'SIGFOX_ANSWER_CANCELLED'. A newer frame replaces a queued one.
+ * @param 	uint8_t* data: frame
+ * @param 	uint16_t length: frame length (truncated to 12)
+ * @return	void
+ */
+void LYNXBeeSigfox::queueUrgent(uint8_t* data, uint16_t length)
+{
+	if (length > SIGFOX_MAX_PAYLOAD)
+	{
+		length = SIGFOX_MAX_PAYLOAD;
+	}
+	
+	memcpy(_urgentFrame, data, length);
+	_urgentLength = length;
+	_urgentTime = millis();
+	_urgentTries = 0;
+	_urgentPending = true;
+}
+
+
+
+
+/*!
+ * @brief	This function tells if an urgent frame waits to be sent
+ * @return	'true' if queued
+ */
+bool LYNXBeeSigfox::urgentPending()
+{
+	return _urgentPending;
+}
+
+
+
+
+/*!
+ * @brief	This function starts sending the urgent frame, giving up the 
+ * 			downlink wait of beginSendACK() if one runs. The module may keep
+ * 			its receive window open and take the frame at its end, so the 
+ * 			uplink is given the downlink timeout too. A frame whose uplink
+ * 			fails stays queued for SIGFOX_URGENT_TRIES uplinks.
+ * @return	
+ * 	@arg	'SIGFOX_ANSWER_PENDING' if started
+ * 	@arg	'SIGFOX_ANSWER_ERROR' if no frame is queued or another operation runs
+ * 	@arg	'SIGFOX_ANSWER_RECOVERING' if the module is being recovered
  */
-uint8_t LYNXBeeSigfox::getPower()
+uint8_t LYNXBeeSigfox::beginUrgent()
 {
+	uint8_t frame[SIGFOX_MAX_PAYLOAD];
+	uint8_t length;
 	uint8_t answer;
 	
-	snprintf(_command, sizeof(_command), "ATS302?\r");
-	
-	// enter command mode
-	if( sendCommand(_command, AT_EOL, AT_ERROR, 1000) != 1)
+	if (!_urgentPending)
 	{
 		return SIGFOX_ANSWER_ERROR;
 	}
 	
-	answer = waitFor(AT_EOL, 1000);
+#if SIGFOX_FEATURE_DOWNLINK
+	if ((_atOp == SIGFOX_OP_SEND_ACK) && (_atStep == 1))
+	{
+		_urgentStats.cancelled++;
+		endAT(SIGFOX_ANSWER_CANCELLED);
+	}
+#endif
 	
-	// enter command mode
-	if( answer != 1)
+	if ((_atOp != SIGFOX_OP_NONE) && (_atOp != SIGFOX_OP_RECOVER))
 	{
 		return SIGFOX_ANSWER_ERROR;
 	}
 	
-	// get value from received data
-	_power = parseUint8Value();	
+	// queueUrgent() may run from an interrupt: take the frame and its 
+	// queue time in one piece
+	SIGFOX_ATOMIC
+	{
+		length = _urgentLength;
+		memcpy(frame, _urgentFrame, length);
+		_urgentStart = _urgentTime;
+		_urgentPending = false;
+	}
 	
+	answer = beginSend(frame, length);
 	
-	return SIGFOX_ANSWER_OK;	
+	if (answer != SIGFOX_ANSWER_PENDING)
+	{
+		_urgentPending = true;
+		return answer;
+	}
+	
+	// a newer frame queued meanwhile starts from no try
+	SIGFOX_ATOMIC
+	{
+		if (!_urgentPending)
+		{
+			_urgentTries = _urgentTries + 1;
+		}
+	}
+	_urgentInFlight = true;
+	if (_urgentCancel)
+	{
+		_atTimeout += SIGFOX_DOWNLINK_TIMEOUT;
+		_urgentCancel = false;
+	}
+	
+	return SIGFOX_ANSWER_PENDING;
 }
 
 
+
+
 /*!
- * @brief	This function stores the current settings in module's memory
+ * @brief	This function sends the urgent frame queued by queueUrgent()
  * @return	
- * 	@arg	'SIGFOX_ANSWER_OK' if OK
- * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
+ * 	@arg	'SIGFOX_ANSWER_OK' if OK ('_urgentStats' updated)
+ * 	@arg	'SIGFOX_ANSWER_ERROR' if error or no frame is queued
  * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
+ * 	@arg	'SIGFOX_ANSWER_RECOVERING' if the module is being recovered
  */
-uint8_t LYNXBeeSigfox::saveSettings()
-{	
-	// enter command mode
-	if( sendCommand("AT$WR\r", AT_OK, AT_ERROR, 1000) != 1)
+uint8_t LYNXBeeSigfox::sendUrgent()
+{
+	uint8_t answer;
+	
+	// TX power and micro channels as for any uplink, unless another 
+	// operation runs (beginUrgent() gives up a downlink wait only)
+	if (_urgentPending && (_atOp == SIGFOX_OP_NONE))
 	{
-		return SIGFOX_ANSWER_ERROR;
+		prepareRadio();
 	}
 	
-	return SIGFOX_ANSWER_OK;	
+	answer = beginUrgent();
+	
+	if (answer != SIGFOX_ANSWER_PENDING)
+	{
+		return answer;
+	}
+	
+	return waitAT();
 }
 
 
 
+
+
+#if SIGFOX_FEATURE_TELEMETRY
+//  Telemetry  ////////////////////////////////////////////////////////////////
+
+
+
 /*!
- * @brief	set factory configuration
- * @return	
- * 	@arg	'SIGFOX_ANSWER_OK' if OK
- * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
- * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
- * 
+ * @brief	This function turns the library counters into telemetry frames
+ * 			and slices (see SigfoxFrame.h). The firmware field needs 
+ * 			'_firmware', read by showFirmware() (SIGFOX_FEATURE_DIAG).
+ * @param	uint16_t every: a telemetry frame is sent before every 'every'-th
+ * 			uplink of send() and sendACK(), '0' for none
+ * @param	bool piggyback: append a slice to the frames of the binary 
+ * 			send functions which have SIGFOX_TELEMETRY_SLICE_SIZE spare bytes
+ * @return	void
  */
-uint8_t LYNXBeeSigfox::factorySettings()
+void LYNXBeeSigfox::enableTelemetry(uint16_t every, bool piggyback)
 {
-	uint8_t status;	
+	_tlmEvery = every;
+	_tlmCount = 0;
+	_tlmPiggyback = piggyback;
+}
+
+
+
+
+/*!
+ * @brief	This function stops telemetry frames and slices
+ * @return	void
+ */
+void LYNXBeeSigfox::disableTelemetry()
+{
+	_tlmEvery = 0;
+	_tlmPiggyback = false;
+}
+
+
+
+
+/*!
+ * @brief	This function gives the value of a telemetry field
+ * @param	uint8_t field: field (see SigfoxTelemetryFields)
+ * @return	value, saturated to the field width for times
+ */
+uint32_t LYNXBeeSigfox::telemetryValue(uint8_t field)
+{
+	uint32_t value;
+	uint32_t max = (1UL << SIGFOX_TELEMETRY_LAYOUT[field].bits) - 1;
 	
-	// SvdW - Factory default does not exist for this module.... just write AT
-	status = sendCommand("AT\r", AT_OK, AT_ERROR, 1000);
-	if( status == 1 )
+	switch (field)
 	{
-		//save config
-		status = saveSettings();
-		return status;
-	}
-	else if( status == 2 )
-	{	
-		// error
-		return SIGFOX_ANSWER_ERROR;
+		case SIGFOX_TLM_TAG:			return SIGFOX_TELEMETRY_TAG;
+#if SIGFOX_FEATURE_DIAG
+		case SIGFOX_TLM_FIRMWARE:		return sigfoxFirmwareId(_firmware);
+#endif
+		case SIGFOX_TLM_UPLINKS:		return _opStats.uplinks;
+		case SIGFOX_TLM_RETRIES:		return _opStats.retries;
+		case SIGFOX_TLM_TIMEOUTS:		return _opStats.timeouts;
+		case SIGFOX_TLM_ENERGY:			return _opStats.energy / 1000;
+		case SIGFOX_TLM_POWER_CYCLES:	return _healthStats.powerCycles;
+		case SIGFOX_TLM_HEALTH:			return _health;
+		case SIGFOX_TLM_POWER:			return _power;
+		
+		case SIGFOX_TLM_BOOT:
+			value = _opStats.bootTime / 100;
+			break;
+			
+		case SIGFOX_TLM_LATENCY:
+			value = (_opStats.commands > 0) ? (_opStats.busyTime / _opStats.commands / 10) : 0;
+			break;
+			
+		default:
+			return 0;
 	}
-	else
+	
+	return (value > max) ? max : value;
+}
+
+
+
+
+/*!
+ * @brief	This function fills a telemetry frame
+ * @param	uint8_t* frame: frame of at least SIGFOX_TELEMETRY_SIZE bytes
+ * @return	frame length (SIGFOX_TELEMETRY_SIZE)
+ */
+uint8_t LYNXBeeSigfox::buildTelemetry(uint8_t* frame)
+{
+	memset(frame, 0x00, SIGFOX_TELEMETRY_SIZE);
+	
+	for (uint8_t i = 0; i < SIGFOX_TELEMETRY_FIELDS; i++)
 	{
-		// time out
-		return SIGFOX_NO_ANSWER;
+		sigfoxPackField(frame, &SIGFOX_TELEMETRY_LAYOUT[i], (int32_t)telemetryValue(i));
 	}
+	
+	return SIGFOX_TELEMETRY_SIZE;
 }
 
 
 
+
 /*!
- * @brief	set default configuration previously stored in module's memory
+ * @brief	This function sends a telemetry frame. The send-on-change filter
+ * 			is not applied.
  * @return	
  * 	@arg	'SIGFOX_ANSWER_OK' if OK
  * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
  * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
- * 
+ * 	@arg	'SIGFOX_ANSWER_RECOVERING' if the module is being recovered
  */
-uint8_t LYNXBeeSigfox::defaultConfiguration()
+uint8_t LYNXBeeSigfox::sendTelemetry()
 {
-	uint8_t answer;	
-	
-	// SvdW - Factory default does not exist for this module.... just write AT
-	answer = sendCommand("AT\r", AT_OK, AT_ERROR, 1000);
-	if( answer == 1 )
-	{
-		delay(2000);
+	uint8_t frame[SIGFOX_TELEMETRY_SIZE];
+	uint8_t answer;
 	
-		// Check communication
-		answer = check();
+	prepareRadio();
+	answer = beginSend(frame, buildTelemetry(frame));
 	
+	if (answer != SIGFOX_ANSWER_PENDING)
+	{
 		return answer;
 	}
-	else if( answer == 2 )
-	{	
-		// error
-		return SIGFOX_ANSWER_ERROR;
+	
+	return waitAT();
+}
+
+
+
+
+/*!
+ * @brief	This function appends the next telemetry slice to a frame if it 
+ * 			has room for it and for the sequence trailer
+ * @param	uint8_t* data: frame
+ * @param	uint16_t length: frame length
+ * @param	uint8_t* frame: buffer of SIGFOX_MAX_PAYLOAD bytes for the result
+ * @return	new frame length
+ */
+uint16_t LYNXBeeSigfox::addTelemetry(uint8_t* data, uint16_t length, uint8_t* frame)
+{
+	if (frame != data)
+	{
+		memcpy(frame, data, length);
 	}
-	else
+	
+	if (length + SIGFOX_TELEMETRY_SLICE_SIZE + sigfoxSeqSize(_seqBits) > SIGFOX_MAX_PAYLOAD)
 	{
-		// time out
-		return SIGFOX_NO_ANSWER;
+		return length;
+	}
+	
+	sigfoxPutSlice(frame, length, _tlmField, telemetryValue(_tlmField));
+	
+	// the tag is known, skip it
+	if (++_tlmField >= SIGFOX_TELEMETRY_FIELDS)
+	{
+		_tlmField = SIGFOX_TLM_FIRMWARE;
 	}
+	
+	return length + SIGFOX_TELEMETRY_SLICE_SIZE;
 }
+#endif
+
+
+
+
+
+#if SIGFOX_FEATURE_FCC
+//  FCC functions  /////////////////////////////////////////////////////////////
 
 
 
 /*!
- * 
- * @brief	This function sends a SIGFOX packet
- * 
- * @param 	char* data:	data to be sent
- * @remarks	data is a sequence of digit representing the value of byte stream
- * 			expressed in hexadecimal value (i.e.: AT$SF=12A435,0 – the payload 
- * 			is composed by the following byte stream: 0x12, 0xA4, 0x35 – 6 digit
- * 			converted in 3 bytes). The maximum length of frame is 24 digit (12Bytes)
- * 
+ * @brief	This function reads the macro channel bitmask and the default 
+ * 			macro channel (RCZ2, RCZ4) into '_macroChannelBitmask' and 
+ * 			'_macroChannel'
  * @return	
  * 	@arg	'SIGFOX_ANSWER_OK' if OK
  * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
  * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
  */
-uint8_t LYNXBeeSigfox::send(char* data)
+uint8_t LYNXBeeSigfox::getMacroChannelBitmask()
 {
-	uint16_t length = strlen(data);
+	uint8_t answer;
+	char* comma;
 	
-	if (length>24)
+	snprintf(_command, sizeof(_command), "%s?\r", SIGFOX_FCC_BITMASK_COMMAND);
+	
+	// "<24 hex digits>,<macro channel>"
+	answer = queryAT(_command, 2000);
+	if (answer != SIGFOX_ANSWER_OK)
 	{
-		USB.println(F("ERROR: Sigfox packet too large"));
-		return SIGFOX_ANSWER_ERROR;
+		return answer;
 	}
 	
-	
-	// create "AT$SF=<data>" command
-	GEN_ATCOMMAND_SET("SF", data);	
-	
-	// enter command mode
-	if( sendCommand(_command, AT_OK, AT_ERROR, 15000) != 1)
+	comma = strchr(_response, ',');
+	if ((comma == NULL) || (comma - _response != 24))
 	{
 		return SIGFOX_ANSWER_ERROR;
 	}
 	
-	return SIGFOX_ANSWER_OK;	
+	memcpy(_macroChannelBitmask, _response, 24);
+	_macroChannelBitmask[24] = '\0';
+	_macroChannel = strtoul(comma + 1, NULL, 10);
+	_fccCache |= FCC_CACHE_BITMASK;
+	
+	return SIGFOX_ANSWER_OK;
 }
 
 
 
 
 /*!
- * 
- * @brief	This function sends a SIGFOX packet
- * 
- * @param 	uint8_t* data:	pointer to the data to be sent
- * @param 	uint16_t length: length of the buffer to send
- * 
+ * @brief	This function sets and saves the macro channel bitmask (RCZ2, 
+ * 			RCZ4), keeping the default macro channel
+ * @param	const char* bitmask: 24 hex digits (uppercase), i.e. 
+ * 			"000001FF0000000000000000" for RCZ2, "0000000000000001FF000000"
+ * 			for RCZ4
  * @return	
  * 	@arg	'SIGFOX_ANSWER_OK' if OK
  * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
  * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
  */
-uint8_t LYNXBeeSigfox::send(uint8_t* data, uint16_t length)
+uint8_t LYNXBeeSigfox::setMacroChannelBitmask(const char* bitmask)
 {
-	//define buffer
-	char ascii_command[30];
+	uint8_t answer;
 	
-	// truncate if greater than 12
-	if (length>12)
+	if (!(_fccCache & FCC_CACHE_BITMASK))
 	{
-		length = 12;
+		answer = getMacroChannelBitmask();
+		if (answer != SIGFOX_ANSWER_OK)		return answer;
 	}
 	
-	// convert from binary to ASCII
-	Utils.hex2str(data, ascii_command, length);
-	
-	#if DEBUG_SIGFOX > 1
-		PRINT_SIGFOX(F("ascii_command: "));
-		USB.println( ascii_command );
-	#endif	
-	
-	return send(ascii_command);
+	return writeMacroChannels(bitmask, _macroChannel);
 }
 
 
 
 
+/*!
+ * @brief	This function reads the default macro channel (RCZ2, RCZ4) into 
+ * 			'_macroChannel', with the bitmask
+ * @return	
+ * 	@arg	'SIGFOX_ANSWER_OK' if OK
+ * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
+ * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
+ */
+uint8_t LYNXBeeSigfox::getMacroChannel()
+{
+	return getMacroChannelBitmask();
+}
+
+
+
 
 /*!
- * @brief	This function sends a SIGFOX packet
- * 
- * @param 	char* data:	data to be sent
- * @remarks	data is a sequence of digit representing the value of byte stream
- * 			expressed in hexadecimal value (i.e.: AT$SF=12A435,0 – the payload 
- * 			is composed by the following byte stream: 0x12, 0xA4, 0x35 – 6 digit
- * 			converted in 3 bytes). The maximum length of frame is 24 digit (12Bytes)
+ * @brief	This function sets and saves the default macro channel (RCZ2, 
+ * 			RCZ4), keeping the bitmask
+ * @param	uint8_t channel: default macro channel, i.e. 1 for RCZ2, 63 for 
+ * 			RCZ4
  * @return	
  * 	@arg	'SIGFOX_ANSWER_OK' if OK
  * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
  * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
  */
-uint8_t LYNXBeeSigfox::sendACK(char* data)
+uint8_t LYNXBeeSigfox::setMacroChannel(uint8_t channel)
 {
-	uint16_t length = strlen(data);
-	uint8_t status;
+	uint8_t answer;
 	
-	if (length>24)
+	if (!(_fccCache & FCC_CACHE_BITMASK))
 	{
-		USB.println(F("ERROR: Sigfox packet too large"));
-		return SIGFOX_ANSWER_ERROR;
+		answer = getMacroChannelBitmask();
+		if (answer != SIGFOX_ANSWER_OK)		return answer;
 	}
 	
+	return writeMacroChannels(_macroChannelBitmask, channel);
+}
+
+
+
+
+/*!
+ * @brief	This function writes the macro channel settings, the single path
+ * 			for both of them. Nothing is sent when the module already has 
+ * 			them. The micro channels are reset before the next uplink, or by
+ * 			serviceChannel().
+ * @param	const char* bitmask: 24 hex digits
+ * @param	uint8_t channel: default macro channel
+ * @return	
+ * 	@arg	'SIGFOX_ANSWER_OK' if OK
+ * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
+ * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
+ */
+uint8_t LYNXBeeSigfox::writeMacroChannels(const char* bitmask, uint8_t channel)
+{
+	uint8_t answer;
+	char copy[25];
 	
-	// SvdW - create "AT$SF=<data>,1" command
-	GEN_ATCOMMAND_SET("SF", data, "1");	
-	
-	// enter command mode
-	if( sendCommand(_command, AT_OK, AT_ERROR, 10000) != 1)
+	if (strlen(bitmask) != 24)
 	{
 		return SIGFOX_ANSWER_ERROR;
 	}
 	
-	// SvdW - added RX=
-	status = waitFor("RX=", AT_ERROR, 20000);
+	// 'bitmask' may be '_macroChannelBitmask'
+	strcpy(copy, bitmask);
 	
-	if (status == 2)
-	{
-		return SIGFOX_ANSWER_ERROR;		
-	}	
-	else if (status == 0)
+	if ((_fccCache & FCC_CACHE_BITMASK) && 
+		(strcmp(_macroChannelBitmask, bitmask) == 0) && 
+		(_macroChannel == channel))
 	{
-		return SIGFOX_NO_ANSWER;	
+		return SIGFOX_ANSWER_OK;
 	}
 	
-	// SvcdW - added LF+CR as end of RX data received
-	status = waitFor("\r\n", AT_ERROR, 25000);
+	snprintf(_command, sizeof(_command), "%s=%s,%u\r", SIGFOX_FCC_BITMASK_COMMAND, copy, channel);
 	
-	if (status == 1)
+	answer = sendAT(_command, 1000);
+	if (answer == SIGFOX_ANSWER_OK)
 	{
-		return SIGFOX_ANSWER_OK;
+		answer = saveSettings();
 	}
-	else if (status == 2)
+	if (answer != SIGFOX_ANSWER_OK)
 	{
-		return SIGFOX_ANSWER_ERROR;		
-	}	
-	else
-	{
-		return SIGFOX_NO_ANSWER;	
+		_fccCache &= ~FCC_CACHE_BITMASK;
+		return answer;
 	}
+	
+	strcpy(_macroChannelBitmask, copy);
+	_macroChannel = channel;
+	_fccCache |= FCC_CACHE_BITMASK;
+	_fccReset = true;
+	
+	return SIGFOX_ANSWER_OK;
 }
 
 
 
 
 /*!
- * 
- * @brief	This function sends a SIGFOX packet waiting for an ACK
- * 
- * @param 	uint8_t* data:	pointer to the data to be sent
- * @param 	uint16_t length: length of the buffer to send
- * 
+ * @brief	This function reads the downlink frequency offset (RCZ2, RCZ4) 
+ * 			into '_downFreqOffset'
  * @return	
  * 	@arg	'SIGFOX_ANSWER_OK' if OK
  * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
  * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
  */
-uint8_t LYNXBeeSigfox::sendACK(uint8_t* data, uint16_t length)
+uint8_t LYNXBeeSigfox::getDownFreqOffset()
 {
-	//define buffer
-	char ascii_command[30];
+	uint8_t answer;
 	
-	// truncate if greater than 12
-	if (length>12)
+	snprintf(_command, sizeof(_command), "%s?\r", SIGFOX_FCC_OFFSET_COMMAND);
+	
+	answer = queryAT(_command, 2000);
+	if (answer != SIGFOX_ANSWER_OK)
 	{
-		length = 12;
+		return answer;
 	}
 	
-	// convert from binary to ASCII
-	Utils.hex2str(data, ascii_command, length);
-	
-	#if DEBUG_SIGFOX > 1
-		PRINT_SIGFOX(F("ascii_command: "));
-		USB.println( ascii_command );
-	#endif	
+	_downFreqOffset = strtol(_response, NULL, 10);
+	_fccCache |= FCC_CACHE_OFFSET;
 	
-	return sendACK(ascii_command);
+	return SIGFOX_ANSWER_OK;
 }
 
 
 
-
-/*!
- * 
- * @brief	This function is used to send a test SIGFOX frame across a 
- * 			specific channel
- * @param	uint16_t count = 0..65535: Count of SIGFOX™ test RF messages. Default: 10
- * @param	uint16_t period = 1..255 Period in seconds between Sigfox test RF messages. Default: 10
- * @param	int channel = 0..180 or 220..400 or -1 Use automatic channel selection (default)
- * 			Channel number to use for SIGFOX™ test RF messages. Channels have a 
- * 			fixed 100 Hz bandwidth, starting at 868.180 MHz for channel 0, 
- * 			ending at 868.198 Mhz for channel 180, restarting at 868.202 MHz for 
- * 			channel 220 and ending at 868.220 MHz for channel 400.
- * 
+
+/*!
+ * @brief	This function sets and saves the downlink frequency offset 
+ * 			(RCZ2, RCZ4). Nothing is sent when the module already has it.
+ * @param	int32_t offset: offset (in Hz)
  * @return	
  * 	@arg	'SIGFOX_ANSWER_OK' if OK
  * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
  * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
  */
-uint8_t LYNXBeeSigfox::testTransmit(uint16_t count, uint16_t period, int channel)
+uint8_t LYNXBeeSigfox::setDownFreqOffset(int32_t offset)
 {
-	char param1[20];
-	char param2[20];
-	char param3[20];
+	uint8_t answer;
 	
-	// convert to string
-	itoa(count, param1, 10);
-	utoa(period, param2, 10);
-	itoa(channel, param3, 10);
+	if ((_fccCache & FCC_CACHE_OFFSET) && (_downFreqOffset == offset))
+	{
+		return SIGFOX_ANSWER_OK;
+	}
 	
-	// create "AT$ST=<count>,<period>,<channel>" command
-	// SvdW - Changed to just send AT, as no test tx available for this module
-//	GEN_ATCOMMAND_SET("ST", param1, param2, param3);
-	GEN_ATCOMMAND_SET("AT");
+	snprintf(_command, sizeof(_command), "%s=%ld\r", SIGFOX_FCC_OFFSET_COMMAND, (long)offset);
 	
-	// enter command mode
-	if( sendCommand(_command, AT_OK, AT_ERROR, 10000*count*period) != 1)
+	answer = sendAT(_command, 1000);
+	if (answer == SIGFOX_ANSWER_OK)
 	{
-		return SIGFOX_ANSWER_ERROR;
+		answer = saveSettings();
+	}
+	if (answer != SIGFOX_ANSWER_OK)
+	{
+		_fccCache &= ~FCC_CACHE_OFFSET;
+		return answer;
 	}
 	
-// SvdW - no tst tx exists
-//	return SIGFOX_ANSWER_OK;	
-	return SIGFOX_ANSWER_ERROR;	
+	_downFreqOffset = offset;
+	_fccCache |= FCC_CACHE_OFFSET;
+	
+	return SIGFOX_ANSWER_OK;
 }
 
 
 
 
-
 /*!
- * 
- * @brief	This function displays the library version number as follows: 
- * 			SOFTxxxx, where 'xxxx' is the version number
+ * @brief	This function reads the micro channel state into '_channelFree'
+ * 			and '_freeChannels'. Modules which answer are FCC modules 
+ * 			('_region'); the others answer "ERROR" and are not asked again.
  * @return	
  * 	@arg	'SIGFOX_ANSWER_OK' if OK
  * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
  * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
  */
-uint8_t LYNXBeeSigfox::showFirmware()
+uint8_t LYNXBeeSigfox::getChannelInfo()
 {
-	uint8_t status;
+	uint8_t answer;
+	char* comma;
+	
+	snprintf(_command, sizeof(_command), "%s\r", SIGFOX_FCC_INFO_COMMAND);
 	
-	// enter command mode
-	if( sendCommand("AT$I=9\r", "UDL", AT_ERROR, 1000) != 1)
+	// "<free channel>,<free channels>"
+	answer = queryAT(_command, 2000);
+	if (answer == SIGFOX_ANSWER_ERROR)
 	{
-		return SIGFOX_ANSWER_ERROR;
+		_fccState = FCC_NONE;
 	}
-	
-	// wait for ending pattern
-	status = waitFor("/r/n",1000);
-	
-	if( status != 1)
+	if (answer != SIGFOX_ANSWER_OK)
 	{
-		return SIGFOX_ANSWER_ERROR;
+		return answer;
 	}
 	
-	// clear buffers
-	memset(_firmware, 0x00, sizeof(_firmware));
-	memcpy(_firmware, _buffer, _length);
-	
-	_firmware[0] = 'U';
-	_firmware[1] = 'D';
-	_firmware[2] = 'L';
-	_firmware[3] = _buffer[0];
-	_firmware[4] = _buffer[1];
-	_firmware[5] = _buffer[2];
-	_firmware[6] = _buffer[3];
-	_firmware[7] = _buffer[4];
-	_firmware[8] = _buffer[5]; 
-	_firmware[9] = _buffer[6];
-	_firmware[10] = _buffer[7];
-	_firmware[11] = '\0';
-	
-	USB.print(F("Firmware Version:"));
-	USB.println(_firmware);
+	_channelFree = (strtoul(_response, &comma, 10) != 0);
+	_freeChannels = (*comma == ',') ? strtoul(comma + 1, NULL, 10) : 0;
+	_fccState = FCC_MODULE;
+	_region = SIGFOX_REGION_FCC;
 	
-	return SIGFOX_ANSWER_OK;	
+	return SIGFOX_ANSWER_OK;
 }
 
 
 
-	
+
 /*!
- * 
- * @brief	This function sends a Keep-Alive message
- * 
- * @return	
- * 	@arg	'SIGFOX_ANSWER_OK' if OK
- * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
- * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
+ * @brief	This function tells if the micro channels have to be reset: 
+ * 			after a macro channel change, or when fewer than 
+ * 			SIGFOX_FCC_MIN_CHANNELS are free. The count is read once after
+ * 			ON() and then decreased by every uplink, so it errs on the side 
+ * 			of resetting.
+ * @return	'true' if a reset is due
  */
-uint8_t LYNXBeeSigfox::sendKeepAlive()
+bool LYNXBeeSigfox::channelResetNeeded()
 {
-	// use the default settings
-	sendKeepAlive(24);
+	if (_fccState != FCC_MODULE)
+	{
+		return false;
+	}
+	
+	return _fccReset || !_channelFree || (_freeChannels < SIGFOX_FCC_MIN_CHANNELS);
 }
 
-	
+
+
+
 /*!
- * 
- * @brief	This function sends a Keep-Alive message
- * 
- * @param 	uint8_t period: Number of hours. 0 Disable SIGFOX keepalive RF messages.
- * 			1..127 Period between 2 SIGFOX keepalive RF messages in hours 
- * 			(default value is 24)
+ * @brief	This function resets the micro channels and reads their state
  * @return	
  * 	@arg	'SIGFOX_ANSWER_OK' if OK
  * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
  * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
  */
-uint8_t LYNXBeeSigfox::sendKeepAlive(uint8_t period)
+uint8_t LYNXBeeSigfox::resetChannel()
 {
-	char param1[20];
 	uint8_t answer;
-		
-	// create "ATS300=<period>" command
-	snprintf(_command, sizeof(_command),"ATS300=%u\r", period);
 	
-	// set frequency setting
-	if( sendCommand(_command, AT_OK, AT_ERROR, 10000) != 1)
+	snprintf(_command, sizeof(_command), "%s\r", SIGFOX_FCC_RESET_COMMAND);
+	
+	answer = sendAT(_command, 1000);
+	if (answer != SIGFOX_ANSWER_OK)
 	{
-		return SIGFOX_ANSWER_ERROR;
+		return answer;
 	}
 	
-	return SIGFOX_ANSWER_OK;
+	_fccReset = false;
+	
+	return getChannelInfo();
 }
 
 
 
-	
+
 /*!
- * 
- * @brief	This function is used to radiate continuous wave without any modulation 
- * 
- * @param 	uint32_t freq: center frequency for carrier
- * @param 	bool enable: '1'=enable; '0'=disable
+ * @brief	This function resets the micro channels if it is due. send() and
+ * 			sendACK() call it before each uplink; calling it at a quiet 
+ * 			moment (i.e. after an uplink, before sleeping) keeps the reset
+ * 			off the path of the next uplink. ON() does not reset them.
  * @return	
- * 	@arg	'SIGFOX_ANSWER_OK' if OK
+ * 	@arg	'SIGFOX_ANSWER_OK' if OK or nothing to do
  * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
  * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
  */
-uint8_t LYNXBeeSigfox::continuosWave(uint32_t freq, bool enable)
+uint8_t LYNXBeeSigfox::serviceChannel()
 {
-	char param1[20];
-	char param2[20];		
-
-	// convert to string	
-	ltoa((uint32_t)freq, param1, 10);
-	utoa((uint16_t)enable, param2, 10);
+	uint8_t answer;
 	
-	// create "AT$CW=freq,<enable>,24" command - defasulty 24dbm for RCZ4
-	GEN_ATCOMMAND_SET("CW", param1, param2, "24");
+	// first uplink since ON(): read the micro channel state
+	if (_fccState == FCC_UNKNOWN)
+	{
+		answer = getChannelInfo();
 		
-	// set CW mode: enabled or disabled
-	if( sendCommand(_command, AT_OK, AT_ERROR, 500) != 1)
+		// not an FCC module: nothing to do
+		if (_fccState == FCC_NONE)
+		{
+			answer = SIGFOX_ANSWER_OK;
+		}
+		if (answer != SIGFOX_ANSWER_OK)
+		{
+			return answer;
+		}
+	}
+	
+	if (channelResetNeeded())
 	{
-		return SIGFOX_ANSWER_ERROR;
+		return resetChannel();
 	}
 	
-	return SIGFOX_ANSWER_OK;	
+	return SIGFOX_ANSWER_OK;
 }
+#endif
 
 
 
 
-//  RF functions  //////////////////////////////////////////////////////////////
 
+#if SIGFOX_FEATURE_DOWNLINK
+//  Downlink request policy  //////////////////////////////////////////////////
 
 
 
 /*!
- * @brief	set frequency and save settings
- * @param	uint32_t freq: new working frequency
- * @return	
- * 	@arg	'SIGFOX_ANSWER_OK' if OK
- * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
- * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
- * 
+ * @brief	This function enables the downlink request policy in front of 
+ * 			sendACK(). Each request keeps the module and the MCU awake for 
+ * 			the receive window and uses one of the few daily downlinks, so 
+ * 			a downlink is only requested when it is due (see downlinkDue()); 
+ * 			otherwise the packet is sent as a plain uplink. The first 
+ * 			request is always due.
+ * @param	uint32_t interval: minimum time between downlink requests (in ms)
+ * @param	uint8_t budget: downlink requests allowed every 24 hours, i.e. 
+ * 			SIGFOX_DOWNLINK_DAILY
+ * @return	void
  */
-uint8_t LYNXBeeSigfox::setFrequency(uint32_t freq)
+void LYNXBeeSigfox::enableDownlinkPolicy(uint32_t interval, uint8_t budget)
 {
-	uint8_t status;	
-	snprintf(_command, sizeof(_command), "AT$IF=%lu\r", freq);
-	
-	status = sendCommand(_command, AT_OK, AT_ERROR, 1000);
-	if( status == 1 )
-	{
-		// ok
-		status = saveSettings();
-		if (status == 0) _frequency = freq;
-		return status;
-	}
-	else if( status == 2 )
-	{	
-		// error
-		return 1;
-	}
-	else
-	{
-		// time out
-		return SIGFOX_NO_ANSWER;
-	}
+	_dlEnabled = true;
+	_dlPending = false;
+	_dlInterval = interval;
+	_dlBudget = budget;
+	_dlUsed = 0;
+	_dlDay = millis();
+	_dlLast = _dlDay - interval;
+	_downlinkStats = SigfoxDownlinkStats();
+}
+
+
+
+
+/*!
+ * @brief	This function disables the downlink request policy: every 
+ * 			sendACK() requests a downlink
+ * @return	void
+ */
+void LYNXBeeSigfox::disableDownlinkPolicy()
+{
+	_dlEnabled = false;
 }
 
 
 
 
+/*!
+ * @brief	This function asks for a downlink with the next sendACK(), 
+ * 			before the interval has elapsed (i.e. the backend has a new 
+ * 			configuration waiting). The daily budget still applies. The 
+ * 			request is cleared when a downlink is received.
+ * @return	void
+ */
+void LYNXBeeSigfox::requestDownlink()
+{
+	_dlPending = true;
+}
+
+
+
 
 /*!
- * @brief	get frequency from module
- * @return	
- * 	@arg	'SIGFOX_ANSWER_OK' if OK
- * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
- * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
- * 
+ * @brief	This function tells if the next sendACK() requests a downlink: 
+ * 			the budget of the current 24 hour window is not used up, and a 
+ * 			downlink was asked for with requestDownlink() or the interval 
+ * 			since the last request has elapsed
+ * @return	'true' if a downlink is due, always 'true' if the policy is off
  */
-uint8_t LYNXBeeSigfox::getFrequency()
+bool LYNXBeeSigfox::downlinkDue()
 {
-	uint8_t status;	
-	
-	status = sendCommand("AT$IF?\r", "\r\n", AT_ERROR, 1000);
-	
-	if (status != 1)
+	if (!_dlEnabled)
 	{
-		return SIGFOX_ANSWER_ERROR;
+		return true;
 	}
 	
-	status = waitFor("\r\n", AT_ERROR, 1000);
-
-	if( status == 1 )
+	// new budget window every 24 hours
+	if ((millis() - _dlDay) >= 86400000UL)
 	{
-		// get value from received data
-		_frequency = parseUint32Value();	
-		
-		return 0;
-	}
-	else if( status == 2 )
-	{	
-		// error
-		return 1;
+		_dlDay = millis();
+		_dlUsed = 0;
 	}
-	else
+	
+	if (_dlUsed >= _dlBudget)
 	{
-		// time out
-		return 2;
-	}	
+		return false;
+	}
+	
+	return _dlPending || ((millis() - _dlLast) >= _dlInterval);
 }
 
 
 
+
+
+//  Remote configuration  /////////////////////////////////////////////////////
+
+
+
 /*!
- * @brief	set powel level for RF transmissions
- * @param	int power: power level to set
- * @return	
- * 	@arg	'SIGFOX_ANSWER_OK' if OK
- * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
- * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
- * 
+ * @brief	This function enables remote configuration: downlinks starting 
+ * 			with SIGFOX_REMOTE_TAG (layout in SigfoxFrame.h) are kept and 
+ * 			applied by applyRemote(), which sendACK() calls after the 
+ * 			downlink and send() before the next uplink. The version is 
+ * 			acknowledged in the next frame of the binary send functions.
+ * @return	void
  */
-uint8_t LYNXBeeSigfox::setPowerLAN(int power)
+void LYNXBeeSigfox::enableRemote()
 {
-	uint8_t status;	
-	
-	if ((power < 0) || (power > 24)) return 1; // error
-				
-	snprintf(_command, sizeof(_command), "ATS302=%d\r", power);
-	
-	status = sendCommand(_command, AT_OK, AT_ERROR, 1000);
-	if( status == 1 )
-	{
-		// ok
-		status = saveSettings();
-		if (status == 0) _powerLAN = power;
-		return status;
-	}
-	else if( status == 2 )
-	{	
-		// error
-		return 1;
-	}
-	else
-	{
-		// time out
-		return SIGFOX_NO_ANSWER;
-	}
+	_rcEnabled = true;
 }
 
 
 
 
+/*!
+ * @brief	This function disables remote configuration. A configuration 
+ * 			already received is still applied.
+ * @return	void
+ */
+void LYNXBeeSigfox::disableRemote()
+{
+	_rcEnabled = false;
+}
+
+
+
 
 /*!
- * @brief	get Power level from module in decimal format
+ * @brief	This function applies the remote configuration received with 
+ * 			the last downlink, if any. All the opcodes are checked first, 
+ * 			so a configuration is applied entirely or not at all. Module 
+ * 			settings go through applyConfig(), i.e. a single "AT$WR" and 
+ * 			none if they did not change; the others take effect at once. 
+ * 			The same version is not applied twice in a row.
  * @return	
- * 	@arg	'SIGFOX_ANSWER_OK' if OK
- * 	@arg	'SIGFOX_ANSWER_ERROR' if error 
- * 	@arg	'SIGFOX_NO_ANSWER' if no answer 
- * 
+ * 	@arg	'SIGFOX_ANSWER_OK' if applied, or nothing to apply
+ * 	@arg	'SIGFOX_ANSWER_ERROR' if rejected (unknown opcode, truncated, 
+ * 			refused by the module)
+ * 	@arg	'SIGFOX_NO_ANSWER' if no answer, kept for the next call
+ * 	@arg	'SIGFOX_ANSWER_RECOVERING' if the module is being recovered, 
+ * 			kept for the next call
  */
-uint8_t LYNXBeeSigfox::getPowerLAN()
+uint8_t LYNXBeeSigfox::applyRemote()
 {
-	uint8_t status;	
+	SigfoxConfig config;
+	uint8_t version = _rcFrame[0] & 0x0F;
+	uint8_t opcodes = 0;
+	uint8_t position;
+	uint8_t opcode;
+	uint32_t value;
+	uint8_t answer;
 	
-	status = sendCommand("ATS302?\r", "\r\n", AT_ERROR, 1000);
+	if (!_rcPending)
+	{
+		return SIGFOX_ANSWER_OK;
+	}
 	
-	if (status != 1)
+	// sent again by the backend: acknowledge it again
+	if (_rcFrame[0] == _rcLast)
 	{
-		return SIGFOX_ANSWER_ERROR;
+		_rcPending = false;
+		_rcAck = _rcLast;
+		return SIGFOX_ANSWER_OK;
 	}
 	
-	status = waitFor("\r\n", AT_ERROR, 1000);
-
-	if( status == 1 )
+	// 1. check the opcodes, collect the module settings
+	config.mask = 0;
+	position = 1;
+	while ((position < _rcLength) && (_rcFrame[position] != SIGFOX_RC_END))
 	{
-		// get value from received data
-		_powerLAN = parseUint8Value();	
+		position = sigfoxRemoteNext(_rcFrame, _rcLength, position, &opcode, &value);
 		
-		return 0;
+		if ((position == 0) || 
+			((opcode == SIGFOX_RC_DEADBAND) && ((value >> 16) >= SIGFOX_FILTER_FIELDS)))
+		{
+			_rcPending = false;
+			_rcAck = (SIGFOX_REMOTE_REJECTED << 4) | version;
+			_remote.rejected++;
+			return SIGFOX_ANSWER_ERROR;
+		}
+		opcodes |= (1 << opcode);
+		
+		if ((opcode == SIGFOX_RC_POWER) && !_pcEnabled)
+		{
+			config.power = value;
+			config.mask |= SIGFOX_CONFIG_POWER;
+		}
+		else if (opcode == SIGFOX_RC_KEEP_ALIVE)
+		{
+			config.keepAlive = value;
+			config.mask |= SIGFOX_CONFIG_KEEP_ALIVE;
+		}
 	}
-	else if( status == 2 )
-	{	
-		// error
-		return 1;
+	
+	// 2. module settings, saved at once
+	if (config.mask != 0)
+	{
+		answer = applyConfig(config);
+		
+		if (answer == SIGFOX_ANSWER_ERROR)
+		{
+			_rcPending = false;
+			_rcAck = (SIGFOX_REMOTE_REJECTED << 4) | version;
+			_remote.rejected++;
+			return answer;
+		}
+		if (answer != SIGFOX_ANSWER_OK)
+		{
+			return answer;
+		}
 	}
-	else
+	
+	// 3. library settings
+	position = 1;
+	while ((position < _rcLength) && (_rcFrame[position] != SIGFOX_RC_END))
 	{
-		// time out
-		return 2;
-	}	
+		position = sigfoxRemoteNext(_rcFrame, _rcLength, position, &opcode, &value);
+		
+		switch (opcode)
+		{
+			case SIGFOX_RC_POWER:
+				// the controller would undo it: cap the controller instead
+				if (_pcEnabled)
+				{
+					_pcMax = value;
+					if (_pcMin > _pcMax)	_pcMin = _pcMax;
+					if (_pcLevel > _pcMax)	_pcLevel = _pcMax;
+				}
+				break;
+				
+			case SIGFOX_RC_INTERVAL:
+				_remote.interval = value;
+				break;
+				
+			case SIGFOX_RC_DOWNLINKS:
+				if (value == 0)	disableDownlinkPolicy();
+				else			enableDownlinkPolicy(86400000UL / value, value);
+				break;
+				
+#if SIGFOX_FEATURE_TELEMETRY
+			case SIGFOX_RC_TELEMETRY:
+				enableTelemetry(value, _tlmPiggyback);
+				break;
+#endif
+				
+			case SIGFOX_RC_HEARTBEAT:
+				_filterHeartbeat = value;
+				break;
+				
+			case SIGFOX_RC_DEADBAND:
+				_filterFields[value >> 16].deadband = value & 0xFFFF;
+				break;
+		}
+	}
+	
+	_rcPending = false;
+	_rcAck = _rcFrame[0];
+	_rcLast = _rcFrame[0];
+	_remote.version = version;
+	_remote.opcodes = opcodes;
+	_remote.applied++;
+	
+	return SIGFOX_ANSWER_OK;
 }
 
 
+
+
 /*!
- * @brief	Prints data received through USB
- * @return	void
- * 
+ * @brief	This function appends the remote configuration acknowledge to a 
+ * 			frame if it has room for it and for the sequence trailer
+ * @param	uint8_t* data: frame
+ * @param	uint16_t length: frame length
+ * @param	uint8_t* frame: buffer of SIGFOX_MAX_PAYLOAD bytes for the result
+ * @return	new frame length
  */
- void LYNXBeeSigfox::showPacket()
-{		
-	USB.println(_buffer,_length);
+uint16_t LYNXBeeSigfox::addRemoteAck(uint8_t* data, uint16_t length, uint8_t* frame)
+{
+	memcpy(frame, data, length);
+	
+	if (length + SIGFOX_REMOTE_ACK_SIZE + sigfoxSeqSize(_seqBits) > SIGFOX_MAX_PAYLOAD)
+	{
+		return length;
+	}
+	
+	frame[length] = _rcAck;
+	_rcAckInFlight = true;
+	
+	return length + SIGFOX_REMOTE_ACK_SIZE;
 }
+#endif
 
 
 
@@ -30,7 +30,19 @@
  *****************************************************************************/
 
 #include <inttypes.h>
+#include "SigfoxFeatures.h"
+#include "SigfoxFrame.h"
+#include "SigfoxMatcher.h"
+
+// The driver is built on top of a transport class providing the WaspUART 
+// members it uses. Host builds select another one, i.e.
+// -DSIGFOX_TRANSPORT_HEADER='"extras/host/SigfoxPosixUART.h"'
+#if defined(SIGFOX_TRANSPORT_HEADER)
+#include SIGFOX_TRANSPORT_HEADER
+#else
 #include <WaspUART.h>
+typedef WaspUART SigfoxTransport;
+#endif
 
 
 /******************************************************************************
@@ -53,15 +65,114 @@
 //! UART baudrate
 #define SIGFOX_RATE 9600
 
+//! Command switching the module UART baudrate, followed by the rate. 
+//! Firmwares without it answer "ERROR" and the link stays as it is
+#ifndef SIGFOX_RATE_COMMAND
+#define SIGFOX_RATE_COMMAND	"AT+IPR="
+#endif
+
+//! Rate tried at power on when the module does not answer at SIGFOX_RATE 
+//! (a rate saved in the module but not in the EEPROM)
+#ifndef SIGFOX_RATE_MAX
+#define SIGFOX_RATE_MAX		115200
+#endif
+
+//! FCC (RCZ2, RCZ4) commands: macro channel bitmask and default macro 
+//! channel, downlink frequency offset, micro channel information and reset
+#ifndef SIGFOX_FCC_BITMASK_COMMAND
+#define SIGFOX_FCC_BITMASK_COMMAND	"ATS400"
+#endif
+#ifndef SIGFOX_FCC_OFFSET_COMMAND
+#define SIGFOX_FCC_OFFSET_COMMAND	"ATS401"
+#endif
+#ifndef SIGFOX_FCC_INFO_COMMAND
+#define SIGFOX_FCC_INFO_COMMAND		"AT$GI?"
+#endif
+#ifndef SIGFOX_FCC_RESET_COMMAND
+#define SIGFOX_FCC_RESET_COMMAND	"AT$RC"
+#endif
+
+//! Free micro channels below which they are reset before an uplink
+#define SIGFOX_FCC_MIN_CHANNELS		3
+
+//! Module boot time after powering the socket (in ms)
+#ifndef SIGFOX_BOOT_TIME
+#define SIGFOX_BOOT_TIME 5000
+#endif
+
 //! ATcommands responses
 static char AT_OK[] 	= "OK";
 static char AT_ERROR[] 	= "ERROR";
-static char AT_EOL[] 	= "\r\n";
-static char AT_HEADER[] = "AT$";
-static char AT_HEADER_COLON[] = "AT:";
 
+#if SIGFOX_FEATURE_LAN
 //! Maximum LAN packet size
-static int SIGFOX_LAN_MAX_PAYLOAD = 17;
+static const int SIGFOX_LAN_MAX_PAYLOAD = 17;
+#endif
+
+//! Receive ring buffer size (power of two, up to 256 bytes)
+#define SIGFOX_RX_RING_SIZE	128
+
+//! Maximum length of a received response line
+#define SIGFOX_LINE_SIZE	64
+
+//! Maximum downlink payload size (in bytes)
+#define SIGFOX_DOWNLINK_SIZE	8
+
+//! Time to wait for the downlink after the uplink of sendACK() (in ms)
+#define SIGFOX_DOWNLINK_TIMEOUT	45000
+
+//! Time an uplink keeps the radio busy (3 repetitions, in ms)
+#define SIGFOX_UPLINK_TIME		6000
+
+//! Downlinks delivered by the network per device and day
+#define SIGFOX_DOWNLINK_DAILY	4
+
+//! Adaptive TX power: step (in dB), margin above the target RSSI kept before
+//! stepping down (in dB), downlinks received in a row before stepping down
+#define SIGFOX_POWER_STEP		2
+#define SIGFOX_POWER_HYSTERESIS	6
+#define SIGFOX_POWER_GOOD		3
+
+//! Supply voltage used for the energy estimates (in mV)
+#define SIGFOX_SUPPLY_VOLTAGE	3300
+
+//! Module supply current while waiting for a downlink (in mA)
+#define SIGFOX_RX_CURRENT		10
+
+//! Health monitor: failed or garbled answers in a row before a resync, "AT" 
+//! tries of a resync before a power cycle and their timeout (in ms), power 
+//! off time (in ms), wait before trying again after a failed power cycle (in ms)
+#define SIGFOX_HEALTH_FAILURES	2
+#define SIGFOX_RESYNC_TRIES		2
+#define SIGFOX_RESYNC_TIMEOUT	500
+#define SIGFOX_POWER_OFF_TIME	500
+#define SIGFOX_HEALTH_BACKOFF	60000
+
+//! Uplinks tried for an urgent frame before it is dropped
+#define SIGFOX_URGENT_TRIES		3
+
+//! EEPROM address of the sequence counter (Waspmote user area)
+#ifndef SIGFOX_SEQ_ADDRESS
+#define SIGFOX_SEQ_ADDRESS		1024
+#endif
+
+//! Slots of the sequence counter ring (2 bytes each, 2 to 255). Uplinks 
+//! write the slots in turn, so each cell is written once every 
+//! SIGFOX_SEQ_SLOTS uplinks
+#ifndef SIGFOX_SEQ_SLOTS
+#define SIGFOX_SEQ_SLOTS		16
+#endif
+
+//! EEPROM address of the module boot rate (4 bytes, after the sequence ring)
+#ifndef SIGFOX_RATE_ADDRESS
+#define SIGFOX_RATE_ADDRESS		(SIGFOX_SEQ_ADDRESS + 2 * SIGFOX_SEQ_SLOTS)
+#endif
+
+//! Number of fields tracked by the send-on-change filter
+#define SIGFOX_FILTER_FIELDS	4
+
+//! Duration of each continuous wave burst in testTransmit() (in ms)
+#define SIGFOX_BURST_CW_TIME	1000
 	
 
 /*! @enum AnswersTypes
@@ -72,6 +183,10 @@ enum AnswersTypes
 	SIGFOX_ANSWER_OK = 0,
 	SIGFOX_ANSWER_ERROR = 1,
 	SIGFOX_NO_ANSWER = 2,
+	SIGFOX_ANSWER_SUPPRESSED = 3,
+	SIGFOX_ANSWER_PENDING = 4,
+	SIGFOX_ANSWER_RECOVERING = 5,	// not sent: the module is being recovered
+	SIGFOX_ANSWER_CANCELLED = 6,	// uplink sent, downlink wait given up for an urgent frame
 };
 
 
@@ -85,6 +200,59 @@ enum CommandTypes
 	SIGFOX_CMD_CONFIG = 3, // AT:<cmd>?
 };
 
+/*! @enum EventTypes
+ * Receive events raised as response lines are completed
+ */
+enum EventTypes
+{
+	SIGFOX_EVENT_LINE 		= 0x01,	// data line received
+	SIGFOX_EVENT_OK 		= 0x02,	// "OK" terminator received
+	SIGFOX_EVENT_ERROR 		= 0x04,	// "ERROR" terminator received
+	SIGFOX_EVENT_DOWNLINK 	= 0x08,	// "RX=" downlink line received
+	SIGFOX_EVENT_UNSOLICITED = 0x10,	// line with a pattern from addPattern()
+	SIGFOX_EVENT_OVERFLOW 	= 0x80,	// receive ring buffer overrun
+};
+
+/*! @enum PatternTypes
+ * Patterns of the response matcher. addPattern() adds the next ones.
+ */
+enum PatternTypes
+{
+	SIGFOX_PATTERN_OK 		= 0,	// "OK", whole line
+	SIGFOX_PATTERN_ERROR 	= 1,	// "ERROR" at the start of the line
+	SIGFOX_PATTERN_DOWNLINK = 2,	// "RX=" at the start of the line
+	SIGFOX_PATTERN_ECHO 	= 3,	// "AT" at the start of the line
+	SIGFOX_PATTERN_USER 	= 4,	// first pattern from addPattern()
+};
+
+/*! @enum OperationTypes
+ * Operations run by the non-blocking functions
+ */
+enum OperationTypes
+{
+	SIGFOX_OP_NONE 			= 0,
+	SIGFOX_OP_BOOT 			= 1,	// boot time, then "AT" (again at the fallback rate)
+	SIGFOX_OP_COMMAND 		= 2,	// wait for "OK"
+	SIGFOX_OP_QUERY 		= 3,	// wait for a data line
+	SIGFOX_OP_GET_ID 		= 4,	// query, then parse '_id'
+	SIGFOX_OP_SEND_ACK 		= 5,	// wait for "OK", then the downlink
+	SIGFOX_OP_SET_POWER 	= 6,	// set, then "AT$WR"
+	SIGFOX_OP_SET_FREQUENCY = 7,	// set, then "AT$WR"
+	SIGFOX_OP_RECOVER 		= 8,	// "AT" until "OK", then power cycle
+};
+
+/*! @enum HealthTypes
+ * States of the health monitor ('_health')
+ */
+enum HealthTypes
+{
+	SIGFOX_HEALTH_OK 		= 0,
+	SIGFOX_HEALTH_SUSPECT 	= 1,	// last answers failed or were garbled
+	SIGFOX_HEALTH_RESYNC 	= 2,	// flushing and sending "AT"
+	SIGFOX_HEALTH_RESET 	= 3,	// power cycling the socket
+	SIGFOX_HEALTH_DOWN 		= 4,	// power cycle failed, waiting SIGFOX_HEALTH_BACKOFF
+};
+
 /*! @enum RegionTypes
  */
 enum RegionTypes
@@ -95,6 +263,135 @@ enum RegionTypes
 	SIGFOX_REGION_ARIB 		= 3,
 };
 
+/*! @enum ConfigTypes
+ * Settings handled by applyConfig()
+ */
+enum ConfigTypes
+{
+	SIGFOX_CONFIG_POWER 		= 0x01,	// ATS302
+	SIGFOX_CONFIG_KEEP_ALIVE 	= 0x02,	// ATS300
+	SIGFOX_CONFIG_FREQUENCY 	= 0x04,	// AT$IF
+};
+
+/*! @struct SigfoxConfig
+ * Module settings applied by applyConfig()
+ */
+struct SigfoxConfig
+{
+	uint32_t frequency;	// working frequency (in Hz)
+	uint8_t power;		// TX power (in dBm)
+	uint8_t keepAlive;	// hours between keep-alive messages, '0' disables them
+	uint8_t mask;		// settings to apply (see ConfigTypes)
+};
+
+/*! @struct SigfoxRemoteConfig
+ * Remote configuration received in downlinks (see applyRemote())
+ */
+struct SigfoxRemoteConfig
+{
+	uint8_t version;	// version of the last configuration applied
+	uint8_t opcodes;	// opcodes it carried (bit 'n' for opcode 'n')
+	uint16_t interval;	// application uplink interval (in minutes), '0' if not set
+	uint16_t applied;	// configurations applied
+	uint16_t rejected;	// configurations rejected
+};
+
+/*! @struct SigfoxFilterField
+ * Frame field compared by the send-on-change filter
+ */
+struct SigfoxFilterField
+{
+	uint8_t offset;		// first byte of the field inside the frame
+	uint8_t size;		// field size in bytes (1..4, MSB first). '0' if unused
+	bool isSigned;		// field holds a two's complement value
+	uint16_t deadband;	// maximum change that is not transmitted
+	uint32_t last;		// value in the last transmitted frame (sign extended if signed)
+};
+
+/*! @struct SigfoxDownlinkStats
+ * Counters of the downlink request policy. The average wait for a downlink
+ * is rxTime / requested
+ */
+struct SigfoxDownlinkStats
+{
+	uint16_t requested;		// uplinks sent requesting a downlink
+	uint16_t downgraded;	// sendACK() calls sent as plain uplinks
+	uint16_t received;		// downlinks received
+	uint32_t rxTime;		// time spent waiting for downlinks (in ms)
+	uint32_t rxSaved;		// estimated wait avoided by downgrades (in ms)
+};
+
+/*! @struct SigfoxPowerStats
+ * Steps of the adaptive TX power controller. The energy of an uplink at each 
+ * power level is estimated from the module supply current.
+ */
+struct SigfoxPowerStats
+{
+	uint8_t power;			// power after the last step (in dBm)
+	int8_t step;			// last step (in dB)
+	int32_t saving;			// energy saved per uplink by the last step (in uJ, <0 if it costs)
+	uint16_t steps;			// steps taken
+	uint16_t writes;		// "ATS302" commands sent for the steps
+};
+
+/*! @struct SigfoxOpStats
+ * Counters of the operations, sent in telemetry frames. The average command
+ * time is busyTime / commands
+ */
+struct SigfoxOpStats
+{
+	uint32_t commands;		// operations ended, uplinks, boots and recoveries aside
+	uint32_t busyTime;		// time taken by those (in ms)
+	uint16_t timeouts;		// operations without answer
+	uint16_t errors;		// operations answered "ERROR"
+	uint16_t retries;		// commands written again (boot, resync)
+	uint16_t uplinks;		// uplinks sent
+	uint16_t bootTime;		// last boot, until "OK" (in ms)
+	uint32_t energy;		// radio energy estimate: uplinks and downlink waits (in mJ)
+};
+
+/*! @struct SigfoxHealthStats
+ * Counters of the health monitor
+ */
+struct SigfoxHealthStats
+{
+	uint32_t failures;		// commands without answer or with a garbled one
+	uint16_t resyncs;		// recoveries started
+	uint16_t powerCycles;	// resyncs which needed a power cycle
+	uint16_t recoveries;	// recoveries which brought the module back
+	uint32_t failFast;		// commands refused during a recovery
+};
+
+/*! @struct SigfoxUrgentStats
+ * Urgent frames sent with queueUrgent(). The latency runs from queueUrgent()
+ * to the end of the uplink; the average is totalLatency / sent
+ */
+struct SigfoxUrgentStats
+{
+	uint16_t sent;			// urgent frames sent
+	uint16_t cancelled;		// downlink waits given up for them
+	uint16_t dropped;		// frames given up after SIGFOX_URGENT_TRIES uplinks
+	uint32_t lastLatency;	// latency of the last one (in ms)
+	uint32_t maxLatency;	// highest latency (in ms)
+	uint32_t totalLatency;	// sum of the latencies (in ms)
+};
+
+/*! @struct SigfoxBurstReport
+ * Results of the last testTransmit() burst. Throughput in frames per hour
+ * is sent * 3600000 / elapsed
+ */
+struct SigfoxBurstReport
+{
+	uint16_t sent;			// frames answered with OK
+	uint16_t failed;		// frames answered with ERROR
+	uint16_t noAnswer;		// frames without answer
+	uint16_t late;			// frames started after their slot
+	uint32_t minTime;		// fastest frame (in ms)
+	uint32_t maxTime;		// slowest frame (in ms)
+	uint32_t totalTime;		// sum of all frame times (in ms)
+	uint32_t elapsed;		// duration of the whole burst (in ms)
+};
+
 /******************************************************************************
  * Class
  *****************************************************************************/
@@ -103,73 +400,409 @@ enum RegionTypes
  * LYNXBeeSigfox Class defines all the variables and functions used to manage
  * TD1207 modules
  */
-class LYNXBeeSigfox : public WaspUART
+class LYNXBeeSigfox : public SigfoxTransport
 {
 	  
 	private:
 		// private attributes
 		char _command[100];
 		
+		// receive ring buffer: serviceRX() moves the UART bytes in through rxByte() and reads them out
+		volatile uint8_t _rxRing[SIGFOX_RX_RING_SIZE];
+		volatile uint8_t _rxHead;
+		volatile uint8_t _rxTail;
+		volatile uint8_t _rxOverflow;
+		uint8_t _rxEvents;
+		char _line[SIGFOX_LINE_SIZE];
+		uint8_t _lineLength;
+		SigfoxMatcher _matcher;
+		int8_t _lineMatch;				// first pattern found in the line
+		uint8_t _lineOffset;			// and where it starts
+		uint8_t _idleChars;				// idle gap ending a response, '0' if off
+		unsigned long _rxLast;			// time of the last received byte
+		bool _rxAnswered;				// data line received since the command
+		bool _sleepWhileWaiting;
+		uint8_t _fragId;
+		
+		// operation run by the non-blocking functions
+		uint8_t _atOp;
+		uint8_t _atStep;
+		unsigned long _atStart;
+		uint32_t _atTimeout;
+		uint32_t _atValue;
+		unsigned long _opBegin;			// start of the operation
+		bool _opUplink;					// operation sends an uplink
+		
+		// health monitor
+		uint8_t _healthFails;			// failures in a row
+		bool _healthAnomaly;			// answer without terminator
+		unsigned long _healthSince;		// start of SIGFOX_HEALTH_DOWN
+		
+		// urgent frame, written by queueUrgent() (maybe from an interrupt)
+		uint8_t _urgentFrame[SIGFOX_MAX_PAYLOAD];
+		volatile uint8_t _urgentLength;
+		volatile bool _urgentPending;
+		volatile unsigned long _urgentTime;
+		unsigned long _urgentStart;		// queue time of the frame being sent
+		bool _urgentInFlight;
+		bool _urgentCancel;				// downlink wait given up just before
+		volatile uint8_t _urgentTries;	// uplinks tried for the queued frame
+		
+		// transmit slot scheduler
+		uint32_t _slotPeriod;
+		uint16_t _slotCount;
+		uint32_t _slotSeed;
+		
+		// sequence counter, '0' bits if off
+		uint8_t _seqBits;
+		uint8_t _seqSlot;				// ring slot written last
+		
+		// adaptive TX power
+		bool _powerKnown;				// '_power' is the level of the module
+		uint8_t _configKnown;			// '_keepAlive', '_frequency' read since ON (see ConfigTypes)
+		bool _pcEnabled;
+		uint8_t _pcMin;
+		uint8_t _pcMax;
+		uint8_t _pcLevel;				// level chosen by the controller
+		uint8_t _pcGood;				// downlinks received in a row
+		int16_t _pcTarget;				// RSSI to keep at the base station
+		
+#if SIGFOX_FEATURE_TELEMETRY
+		// telemetry frames and slices
+		uint16_t _tlmEvery;				// uplinks between telemetry frames, '0' if off
+		uint16_t _tlmCount;
+		bool _tlmPiggyback;
+		uint8_t _tlmField;				// next field of the slices
+#endif
+		
+#if SIGFOX_FEATURE_FCC
+		// FCC channel management
+		uint8_t _fccState;				// module type, see LYNXBeeSigfox.cpp
+		uint8_t _fccCache;				// settings known without reading them
+		bool _fccReset;					// micro channel reset due
+#endif
+		
+		// send-on-change filter
+		SigfoxFilterField _filterFields[SIGFOX_FILTER_FIELDS];
+		bool _filterEnabled;
+		bool _filterPrimed;
+		uint16_t _filterHeartbeat;
+		uint16_t _filterSilence;
+		
+#if SIGFOX_FEATURE_DOWNLINK
+		// downlink request policy
+		bool _dlEnabled;
+		bool _dlPending;
+		uint8_t _dlBudget;
+		uint8_t _dlUsed;
+		uint32_t _dlInterval;
+		unsigned long _dlLast;			// last downlink request
+		unsigned long _dlDay;			// start of the budget window
+		
+		// remote configuration
+		bool _rcEnabled;
+		bool _rcPending;				// '_rcFrame' waits for applyRemote()
+		uint8_t _rcFrame[SIGFOX_REMOTE_SIZE];
+		uint8_t _rcLength;
+		uint8_t _rcAck;					// acknowledge to send, '0' if none
+		uint8_t _rcLast;				// last acknowledge of an applied one
+		bool _rcAckInFlight;
+#endif
+		
 		// private methods
 		void generator(uint8_t type, int n, const char *cmdCode, ...);		
+		void resetRX();
+		void rxByte(uint8_t data);
+		void idle();
+		void waitUntil(unsigned long time);
+		void processLine();
+		void endLine();
+		uint32_t idleGap();
+		uint32_t idleLeft();
+		void writeAT(const char* cmd);
+		uint8_t beginAT(const char* cmd, uint8_t op, uint32_t timeout);
+		uint8_t nextAT(uint32_t timeout);
+		uint8_t endAT(uint8_t answer);
+		uint8_t waitAT();
+		bool healthReady();
+		void checkHealth(uint8_t answer);
+		uint8_t pollRecover();
+		uint8_t sendAT(const char* cmd, uint32_t timeout);
+		uint8_t queryAT(const char* cmd, uint32_t timeout);
+		uint32_t readField(uint8_t* data, uint8_t index);
+		bool filterFrame(uint8_t* data, uint16_t length);
+		void updateFilter(uint8_t* data, uint16_t length);
 		uint32_t parseHexValue();	
 		uint8_t parseUint8Value();
 		uint32_t parseUint32Value();
+		void switchRate(uint32_t rate);
+		uint32_t readBootRate();
+		void writeBootRate(uint32_t rate);
+		uint8_t buildFrame(uint8_t* data, uint16_t length, char* ascii);
+		uint16_t addSequence(uint8_t* data, uint16_t length, uint8_t* frame);
+		uint16_t readSequence(uint8_t slot);
+		void writeSequence(uint8_t slot, uint16_t value);
+		uint8_t writePower(uint8_t power);
+		void stepPower(int8_t step);
+		void powerFeedback(bool received);
+		void prepareUplink();
+		void prepareRadio();
+#if SIGFOX_FEATURE_TELEMETRY
+		uint32_t telemetryValue(uint8_t field);
+		uint16_t addTelemetry(uint8_t* data, uint16_t length, uint8_t* frame);
+#endif
+#if SIGFOX_FEATURE_DOWNLINK
+		uint16_t addRemoteAck(uint8_t* data, uint16_t length, uint8_t* frame);
+#endif
+#if SIGFOX_FEATURE_FCC
+		uint8_t writeMacroChannels(const char* bitmask, uint8_t channel);
+#endif
 
 	public:
 		uint8_t _power;					/*!< Sigfox tx power (in dBm)	*/		
+		uint32_t _bootRate;				/*!< Module baudrate at power on (stored in the EEPROM)	*/
+		uint8_t _keepAlive;				/*!< Keep-alive period (in h)	*/
+		uint8_t _changed;				/*!< Settings changed by applyConfig()	*/
 		uint32_t _id;					/*!< Sigfox module id			*/	
 		uint32_t _pac;
+#if SIGFOX_FEATURE_DIAG
 		char _firmware[12];				/*!< Module firmware version	*/
+#endif
+#if SIGFOX_FEATURE_LAN
 		uint32_t _address;				/*!< LAN address				*/	 
 		uint32_t _mask;					/*!< Mask address				*/		
-		uint32_t _frequency;			/*!< Frequency					*/	
 		int _powerLAN;					/*!< LAN tx power (in dBm)		*/	
 		char _packet[35];				/*!< LAN packet structure		*/	
+#endif
+		uint32_t _frequency;			/*!< Frequency					*/	
 		uint8_t _region;				/*!< actual region of the module*/	
+#if SIGFOX_FEATURE_FCC
 		char _macroChannelBitmask[25];	/*!< Macro channel bitmask		*/	
 		uint8_t _macroChannel;			/*!< Macro channel 				*/	
 		int32_t _downFreqOffset;		/*!< Downlink Frequency Offset	*/	
+		bool _channelFree;				/*!< A micro channel is free	*/
+		uint8_t _freeChannels;			/*!< Free micro channels		*/
+#endif
+		char _response[SIGFOX_LINE_SIZE];		/*!< Last data line received	*/
+#if SIGFOX_FEATURE_DOWNLINK
+		uint8_t _downlink[SIGFOX_DOWNLINK_SIZE];	/*!< Last downlink payload		*/
+		uint8_t _downlinkLength;		/*!< Downlink payload length	*/
+		SigfoxDownlinkStats _downlinkStats;	/*!< Downlink policy counters	*/
+		SigfoxRemoteConfig _remote;		/*!< Remote configuration		*/
+#endif
+		uint32_t _suppressed;			/*!< Uplinks suppressed by filter*/
+		uint16_t _sequence;				/*!< Counter of the next uplink (low bits sent)	*/
+		SigfoxPowerStats _powerStats;	/*!< Adaptive TX power steps	*/
+		uint8_t _health;				/*!< Health monitor state		*/
+		SigfoxHealthStats _healthStats;	/*!< Health monitor counters	*/
+		SigfoxUrgentStats _urgentStats;	/*!< Urgent frame latencies		*/
+		SigfoxOpStats _opStats;			/*!< Operation counters			*/
+#if SIGFOX_FEATURE_RF_TEST
+		SigfoxBurstReport _burst;		/*!< Last testTransmit() report	*/
+#endif
+		int8_t _unsolicited;			/*!< Pattern of the last unsolicited line	*/
+		uint8_t _unsolicitedOffset;		/*!< Pattern offset in that line ('_response')	*/
 		
 		//! class constructor
 		LYNXBeeSigfox()
 		{
-			//do nothing
+			_sleepWhileWaiting = false;
+			_rxHead = 0;
+			_rxTail = 0;
+			_filterEnabled = false;
+			for (uint8_t i = 0; i < SIGFOX_FILTER_FIELDS; i++)
+			{
+				_filterFields[i] = SigfoxFilterField();
+			}
+			_fragId = 0;
+			_atOp = SIGFOX_OP_NONE;
+			_lineMatch = -1;
+			_unsolicited = -1;
+			_idleChars = 0;
+			_rxAnswered = false;
+#if SIGFOX_FEATURE_DOWNLINK
+			_dlEnabled = false;
+			_dlPending = false;
+			_downlinkStats = SigfoxDownlinkStats();
+			_rcEnabled = false;
+			_rcPending = false;
+			_rcAck = 0;
+			_rcLast = 0;
+			_rcAckInFlight = false;
+			_remote = SigfoxRemoteConfig();
+#endif
+			_bootRate = SIGFOX_RATE;
+			_slotCount = 0;
+			_seqBits = 0;
+			_seqSlot = 0;
+			_sequence = 0;
+			_powerKnown = false;
+			_configKnown = 0;
+			_pcEnabled = false;
+			_powerStats = SigfoxPowerStats();
+			_health = SIGFOX_HEALTH_OK;
+			_healthFails = 0;
+			_healthAnomaly = false;
+			_healthStats = SigfoxHealthStats();
+			_urgentLength = 0;
+			_urgentPending = false;
+			_urgentInFlight = false;
+			_urgentCancel = false;
+			_urgentTries = 0;
+			_urgentStats = SigfoxUrgentStats();
+			_opUplink = false;
+			_opStats = SigfoxOpStats();
+#if SIGFOX_FEATURE_TELEMETRY
+			_tlmEvery = 0;
+			_tlmCount = 0;
+			_tlmPiggyback = false;
+			_tlmField = SIGFOX_TLM_FIRMWARE;
+#endif
+#if SIGFOX_FEATURE_FCC
+			_fccState = 0;
+			_fccCache = 0;
+			_fccReset = false;
+			_macroChannelBitmask[0] = '\0';
+#endif
+			
+			// response patterns, in PatternTypes order
+			_matcher.add(AT_OK);
+			_matcher.add(AT_ERROR);
+			_matcher.add("RX=");
+			_matcher.add("AT");
 		};
 		
+		// Receive functions
+		uint8_t serviceRX();
+		uint8_t waitEvent(uint8_t events, uint32_t timeout);
+		void setSleepWhileWaiting(bool enable);
+		int8_t addPattern(const char* pattern);
+		void setIdleGap(uint8_t chars);
+		
+		// Non-blocking functions: start an operation, then call pollAT() 
+		// until it stops returning SIGFOX_ANSWER_PENDING
+		uint8_t beginON(uint8_t socket);
+		uint8_t beginCheck();
+		uint8_t beginGetID();
+		uint8_t beginSend(char* data);
+		uint8_t beginSend(uint8_t* data, uint16_t length);
+#if SIGFOX_FEATURE_DOWNLINK
+		uint8_t beginSendACK(char* data);
+		uint8_t beginSendACK(uint8_t* data, uint16_t length);
+#endif
+		uint8_t beginSetPower(uint8_t power);
+		uint8_t beginSetFrequency(uint32_t freq);
+		uint8_t beginSendKeepAlive(uint8_t period);
+		uint8_t beginRecover();
+		uint8_t beginUrgent();
+		uint8_t pollAT();
+		uint32_t timeLeftAT();
+		
 		// Switch on/off functions
 		uint8_t ON(uint8_t socket);	
 		uint8_t OFF(uint8_t socket);	
 		uint8_t check();
+		uint8_t recover();
+#if SIGFOX_FEATURE_DIAG
 		uint8_t setPublicKey();
+#endif
+		uint8_t setBaudrate(uint32_t rate, bool save);
 		
 		// Sigfox functions
 		uint8_t getID();
 		uint8_t getPAC();
 		uint8_t send(char* data);
 		uint8_t send(uint8_t* data, uint16_t length);
+#if SIGFOX_FEATURE_DOWNLINK
 		uint8_t sendACK(char* data);
 		uint8_t sendACK(uint8_t* data, uint16_t length);		
+#endif
+		uint8_t sendFragmented(uint8_t* data, uint16_t length);
+#if SIGFOX_FEATURE_RF_TEST
 		uint8_t testTransmit(uint16_t count, uint16_t period, int channel);
+		uint8_t continuosWave(uint32_t freq, bool enable);
+#endif
+#if SIGFOX_FEATURE_DIAG
 		uint8_t showFirmware();
+#endif
 		uint8_t setPower(uint8_t power);
 		uint8_t getPower();	
 		uint8_t sendKeepAlive();
 		uint8_t sendKeepAlive(uint8_t period);
-		uint8_t continuosWave(uint32_t freq, bool enable);
 		
 		uint8_t saveSettings();
 		uint8_t factorySettings();
 		uint8_t defaultConfiguration();
+		uint8_t getKeepAlive();
+		uint8_t applyConfig(const SigfoxConfig& config);
 		
 		// LAN
 		uint8_t setFrequency(uint32_t frec);
 		uint8_t getFrequency();
+#if SIGFOX_FEATURE_LAN
 		uint8_t setPowerLAN(int power);
 		uint8_t getPowerLAN();
 		void showPacket();
+#endif
+		
+		// Send-on-change filter
+		uint8_t setFilterField(uint8_t index, uint8_t offset, uint8_t size, uint16_t deadband, bool isSigned);
+		void enableFilter(uint16_t heartbeat);
+		void disableFilter();
+		
+		// Transmit slot scheduler
+		void setSlots(uint32_t period, uint16_t slots);
+		uint32_t nextSlot();
+		
+		// Sequence counter
+		void enableSequence(uint8_t bits);
+		void disableSequence();
 		
+		// Urgent frames
+		void queueUrgent(uint8_t* data, uint16_t length);
+		bool urgentPending();
+		uint8_t sendUrgent();
+		
+#if SIGFOX_FEATURE_TELEMETRY
+		// Telemetry
+		void enableTelemetry(uint16_t every, bool piggyback);
+		void disableTelemetry();
+		uint8_t buildTelemetry(uint8_t* frame);
+		uint8_t sendTelemetry();
+#endif
+		
+		// Adaptive TX power
+		void enablePowerControl(uint8_t minPower, uint8_t maxPower, int16_t targetRSSI);
+		void disablePowerControl();
+		void reportLink(int16_t rssi);
+		uint8_t adjustPower();
+		
+#if SIGFOX_FEATURE_DOWNLINK
+		// Downlink request policy
+		void enableDownlinkPolicy(uint32_t interval, uint8_t budget);
+		void disableDownlinkPolicy();
+		void requestDownlink();
+		bool downlinkDue();
+		
+		// Remote configuration
+		void enableRemote();
+		void disableRemote();
+		uint8_t applyRemote();
+#endif
+		
+#if SIGFOX_FEATURE_FCC
 		// FCC functions
+		uint8_t getMacroChannelBitmask();
+		uint8_t setMacroChannelBitmask(const char* bitmask);
+		uint8_t getMacroChannel();
+		uint8_t setMacroChannel(uint8_t channel);
+		uint8_t getDownFreqOffset();
+		uint8_t setDownFreqOffset(int32_t offset);
+		uint8_t getChannelInfo();
+		bool channelResetNeeded();
+		uint8_t resetChannel();
+		uint8_t serviceChannel();
+#endif
 };
 
 //! Define the object
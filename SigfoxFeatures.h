@@ -0,0 +1,85 @@
+/*! 
+ * @file 	SigfoxFeatures.h
+ * @author	Sean van der Walt / Walt Technologies Pty Ltd
+ * @version	0.1
+ * @brief 	Optional capability groups of LYNXBeeSigfox. Each group is 
+ * 			selected with SIGFOX_FEATURE_<name> set to 1, here or with -D 
+ * 			build flags. Functions and attributes of the groups which are not
+ * 			selected are not compiled, so they cost no flash or RAM.
+ *
+ *  Copyright (C) 2017 Walt Technologies Pty Ltd
+ *  https://walt-tech.com.au
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *    
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *   
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *	
+ */
+ 
+#ifndef SigfoxFeatures_h
+#define SigfoxFeatures_h
+
+/******************************************************************************
+ * Definitions & Declarations
+ *****************************************************************************/
+
+//! RF test: testTransmit(), continuosWave() and '_burst'. Selected by 
+//! default like the groups below, so existing sketches keep building; set 
+//! the ones a sketch does not use to 0 here to save flash
+#ifndef SIGFOX_FEATURE_RF_TEST
+#define SIGFOX_FEATURE_RF_TEST		1
+#endif
+
+//! LAN: setPowerLAN(), getPowerLAN(), showPacket() and their attributes
+#ifndef SIGFOX_FEATURE_LAN
+#define SIGFOX_FEATURE_LAN			1
+#endif
+
+//! Diagnostics: showFirmware(), setPublicKey() (SNEK emulator) and '_firmware'
+#ifndef SIGFOX_FEATURE_DIAG
+#define SIGFOX_FEATURE_DIAG			1
+#endif
+
+//! Downlink: sendACK(), beginSendACK(), '_downlink' and the downlink request
+//! policy. Selected by default: the host tools in extras/host need it
+#ifndef SIGFOX_FEATURE_DOWNLINK
+#define SIGFOX_FEATURE_DOWNLINK		1
+#endif
+
+//! FCC: macro channel settings and micro channel resets of RCZ2/RCZ4 modules.
+//! Selected by default; ETSI modules answer "ERROR" and skip it at run time
+#ifndef SIGFOX_FEATURE_FCC
+#define SIGFOX_FEATURE_FCC			1
+#endif
+
+//! Telemetry: telemetry frames and slices built from the library counters
+//! (sendTelemetry(), enableTelemetry()). The counters are kept anyway
+#ifndef SIGFOX_FEATURE_TELEMETRY
+#define SIGFOX_FEATURE_TELEMETRY	1
+#endif
+
+
+// -DSIGFOX_FEATURE_REPORT lists the selection in the build output. The flash 
+// used by each group is printed by extras/host/sigfox_size.sh
+#if defined(SIGFOX_FEATURE_REPORT)
+#define SIGFOX_STRING(x)	#x
+#define SIGFOX_FEATURE(name, value)	"LYNXBeeSigfox feature " name " = " SIGFOX_STRING(value)
+#pragma message(SIGFOX_FEATURE("RF_TEST", SIGFOX_FEATURE_RF_TEST))
+#pragma message(SIGFOX_FEATURE("LAN", SIGFOX_FEATURE_LAN))
+#pragma message(SIGFOX_FEATURE("DIAG", SIGFOX_FEATURE_DIAG))
+#pragma message(SIGFOX_FEATURE("DOWNLINK", SIGFOX_FEATURE_DOWNLINK))
+#pragma message(SIGFOX_FEATURE("FCC", SIGFOX_FEATURE_FCC))
+#pragma message(SIGFOX_FEATURE("TELEMETRY", SIGFOX_FEATURE_TELEMETRY))
+#endif
+
+
+#endif
@@ -0,0 +1,383 @@
+/*! 
+ * @file 	SigfoxFrame.h
+ * @author	Sean van der Walt / Walt Technologies Pty Ltd
+ * @version	0.1
+ * @brief 	Frame layouts shared by the LYNX-Bee Sigfox library and the host 
+ * 			side tools (see extras/host)
+ *
+ *  Copyright (C) 2017 Walt Technologies Pty Ltd
+ *  https://walt-tech.com.au
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *    
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *   
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *	
+ */
+ 
+#ifndef SigfoxFrame_h
+#define SigfoxFrame_h
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+
+#include <inttypes.h>
+
+
+/******************************************************************************
+ * Definitions & Declarations
+ *****************************************************************************/
+
+//! Maximum Sigfox uplink payload (in bytes)
+#define SIGFOX_MAX_PAYLOAD		12
+
+/*
+ * Fragment header (1 byte) placed before every fragment payload:
+ * 	bits 7..5: message id (wraps every 8 messages)
+ * 	bits 4..2: fragment index
+ * 	bit 1: last fragment of the message
+ * 	bit 0: reserved (0)
+ */
+#define SIGFOX_FRAG_HEADER_SIZE	1
+#define SIGFOX_FRAG_PAYLOAD		(SIGFOX_MAX_PAYLOAD - SIGFOX_FRAG_HEADER_SIZE)
+#define SIGFOX_FRAG_MAX_COUNT	8
+#define SIGFOX_FRAG_MAX_LENGTH	(SIGFOX_FRAG_MAX_COUNT * SIGFOX_FRAG_PAYLOAD)
+#define SIGFOX_FRAG_ID_MASK		0x07
+
+//! Build a fragment header
+static inline uint8_t sigfoxFragHeader(uint8_t id, uint8_t index, bool last)
+{
+	return ((id & SIGFOX_FRAG_ID_MASK) << 5) | ((index & 0x07) << 2) | (last ? 0x02 : 0x00);
+}
+
+//! Message id of a fragment header
+static inline uint8_t sigfoxFragId(uint8_t header)
+{
+	return (header >> 5) & SIGFOX_FRAG_ID_MASK;
+}
+
+//! Fragment index of a fragment header
+static inline uint8_t sigfoxFragIndex(uint8_t header)
+{
+	return (header >> 2) & 0x07;
+}
+
+//! Last fragment flag of a fragment header
+static inline bool sigfoxFragLast(uint8_t header)
+{
+	return (header & 0x02) != 0;
+}
+
+
+
+/*
+ * Sequence trailer (enableSequence()): uplink counter of 1 to 16 bits, wrapping,
+ * in the low bits of the last sigfoxSeqSize() bytes of the frame (MSB first).
+ * The counter counts every uplink started, so missing values are lost frames.
+ */
+#define SIGFOX_SEQ_MAX_BITS		16
+
+//! Bytes taken by a sequence counter of 'bits' bits
+static inline uint8_t sigfoxSeqSize(uint8_t bits)
+{
+	return (bits + 7) >> 3;
+}
+
+//! Write the sequence trailer at the end of a frame of 'length' bytes
+static inline void sigfoxPutSeq(uint8_t* frame, uint8_t length, uint16_t seq, uint8_t bits)
+{
+	uint8_t size = sigfoxSeqSize(bits);
+	
+	for (uint8_t i = 0; i < size; i++)
+	{
+		frame[length - 1 - i] = (seq >> (8*i)) & 0xFF;
+	}
+}
+
+//! Read the sequence trailer of a frame of 'length' bytes
+static inline uint16_t sigfoxGetSeq(const uint8_t* frame, uint8_t length, uint8_t bits)
+{
+	uint8_t size = sigfoxSeqSize(bits);
+	uint16_t seq = 0;
+	
+	for (uint8_t i = 0; i < size; i++)
+	{
+		seq = (seq << 8) | frame[length - size + i];
+	}
+	
+	return seq & (uint16_t)((1UL << bits) - 1);
+}
+
+
+
+/*! @enum SigfoxFieldTypes
+ * Encoding of a frame field
+ */
+enum SigfoxFieldTypes
+{
+	SIGFOX_FIELD_UNSIGNED	= 0,
+	SIGFOX_FIELD_SIGNED		= 1,	// two's complement
+};
+
+/*! @struct SigfoxFieldLayout
+ * Field of an application frame. Fields are bit-packed MSB first: bit 0 is 
+ * the most significant bit of the first payload byte. The same layout table
+ * is used by the firmware to pack frames and by the backend to decode them.
+ */
+struct SigfoxFieldLayout
+{
+	const char* name;	// field name, '0' on AVR (see SIGFOX_FIELD_NAME)
+	uint8_t offset;		// first bit of the field (0..95)
+	uint8_t bits;		// field width (1..32)
+	uint8_t type;		// see SigfoxFieldTypes
+};
+
+//! Field names are for the backend: on AVR the string would take SRAM, so 
+//! the firmware build leaves it out
+#if defined(__AVR__)
+#define SIGFOX_FIELD_NAME(name)	0
+#else
+#define SIGFOX_FIELD_NAME(name)	(name)
+#endif
+
+//! Write a field into a frame
+static inline void sigfoxPackField(uint8_t* frame, const SigfoxFieldLayout* field, int32_t value)
+{
+	uint32_t data = (uint32_t)value;
+	uint8_t bit;
+	
+	// from the least significant bit of the value, backwards
+	for (uint8_t i = 0; i < field->bits; i++)
+	{
+		bit = field->offset + field->bits - 1 - i;
+		
+		if (data & 0x01)	frame[bit >> 3] |= (0x80 >> (bit & 0x07));
+		else				frame[bit >> 3] &= ~(0x80 >> (bit & 0x07));
+		
+		data >>= 1;
+	}
+}
+
+//! Read a field from a frame
+static inline int32_t sigfoxUnpackField(const uint8_t* frame, const SigfoxFieldLayout* field)
+{
+	uint8_t end = field->offset + field->bits - 1;
+	uint64_t raw = 0;
+	uint32_t data;
+	
+	for (uint8_t i = field->offset >> 3; i <= (end >> 3); i++)
+	{
+		raw = (raw << 8) | frame[i];
+	}
+	raw >>= 7 - (end & 0x07);
+	
+	data = (uint32_t)raw;
+	if (field->bits < 32)
+	{
+		data &= (1UL << field->bits) - 1;
+		
+		// sign extend
+		if ((field->type == SIGFOX_FIELD_SIGNED) && (data & (1UL << (field->bits - 1))))
+		{
+			data |= 0xFFFFFFFFUL << field->bits;
+		}
+	}
+	
+	return (int32_t)data;
+}
+
+
+
+/*
+ * Telemetry frame (sendTelemetry()): SIGFOX_TELEMETRY_SIZE bytes laid out by 
+ * SIGFOX_TELEMETRY_LAYOUT, so a 16 bits sequence trailer still fits. The 
+ * first 4 bits are SIGFOX_TELEMETRY_TAG; applications sending telemetry keep
+ * that value out of the first 4 bits of their own frames. Counters keep their
+ * low bits (they wrap), the boot time and latency saturate.
+ *
+ * Telemetry slice (enableTelemetry() piggyback): one field appended to a data
+ * frame with SIGFOX_TELEMETRY_SLICE_SIZE spare bytes, before the sequence
+ * trailer: 4 bits field index, 20 bits field value. Fields rotate from one
+ * frame to the next.
+ */
+#define SIGFOX_TELEMETRY_TAG		0x0F
+#define SIGFOX_TELEMETRY_SIZE		10
+#define SIGFOX_TELEMETRY_SLICE_SIZE	3
+
+/*! @enum SigfoxTelemetryFields
+ * Fields of a telemetry frame, in SIGFOX_TELEMETRY_LAYOUT order
+ */
+enum SigfoxTelemetryFields
+{
+	SIGFOX_TLM_TAG			= 0,	// SIGFOX_TELEMETRY_TAG
+	SIGFOX_TLM_FIRMWARE		= 1,	// sigfoxFirmwareId() of '_firmware', '0' if unknown
+	SIGFOX_TLM_BOOT			= 2,	// last boot time (in 100 ms)
+	SIGFOX_TLM_UPLINKS		= 3,	// uplinks sent
+	SIGFOX_TLM_RETRIES		= 4,	// commands written again (boot, resync)
+	SIGFOX_TLM_TIMEOUTS		= 5,	// commands without answer
+	SIGFOX_TLM_LATENCY		= 6,	// average command time, uplinks aside (in 10 ms)
+	SIGFOX_TLM_ENERGY		= 7,	// radio energy estimate (in J)
+	SIGFOX_TLM_POWER_CYCLES	= 8,	// power cycles of the health monitor
+	SIGFOX_TLM_HEALTH		= 9,	// health monitor state
+	SIGFOX_TLM_POWER		= 10,	// TX power (in dBm)
+	SIGFOX_TELEMETRY_FIELDS	= 11,
+};
+
+static const SigfoxFieldLayout SIGFOX_TELEMETRY_LAYOUT[SIGFOX_TELEMETRY_FIELDS] =
+{
+	{ SIGFOX_FIELD_NAME("tag"),			0,	4,	SIGFOX_FIELD_UNSIGNED },
+	{ SIGFOX_FIELD_NAME("firmware"),	4,	16,	SIGFOX_FIELD_UNSIGNED },
+	{ SIGFOX_FIELD_NAME("boot"),		20,	8,	SIGFOX_FIELD_UNSIGNED },
+	{ SIGFOX_FIELD_NAME("uplinks"),		28,	8,	SIGFOX_FIELD_UNSIGNED },
+	{ SIGFOX_FIELD_NAME("retries"),		36,	6,	SIGFOX_FIELD_UNSIGNED },
+	{ SIGFOX_FIELD_NAME("timeouts"),	42,	6,	SIGFOX_FIELD_UNSIGNED },
+	{ SIGFOX_FIELD_NAME("latency"),		48,	8,	SIGFOX_FIELD_UNSIGNED },
+	{ SIGFOX_FIELD_NAME("energy"),		56,	12,	SIGFOX_FIELD_UNSIGNED },
+	{ SIGFOX_FIELD_NAME("powerCycles"),	68,	4,	SIGFOX_FIELD_UNSIGNED },
+	{ SIGFOX_FIELD_NAME("health"),		72,	3,	SIGFOX_FIELD_UNSIGNED },
+	{ SIGFOX_FIELD_NAME("power"),		75,	5,	SIGFOX_FIELD_UNSIGNED },
+};
+
+//! Firmware identity of telemetry frames: FNV-1a of the version string, 
+//! folded to 16 bits
+static inline uint16_t sigfoxFirmwareId(const char* version)
+{
+	uint32_t hash = 2166136261UL;
+	
+	while (*version)
+	{
+		hash ^= (uint8_t)*version++;
+		hash *= 16777619UL;
+	}
+	
+	return (uint16_t)((hash >> 16) ^ hash);
+}
+
+//! Write a telemetry slice at byte 'position' of a frame
+static inline void sigfoxPutSlice(uint8_t* frame, uint8_t position, uint8_t field, uint32_t value)
+{
+	frame[position] = (field << 4) | ((value >> 16) & 0x0F);
+	frame[position + 1] = (value >> 8) & 0xFF;
+	frame[position + 2] = value & 0xFF;
+}
+
+//! Read the telemetry slice at byte 'position' of a frame, returns its value
+static inline uint32_t sigfoxGetSlice(const uint8_t* frame, uint8_t position, uint8_t* field)
+{
+	*field = frame[position] >> 4;
+	
+	return ((uint32_t)(frame[position] & 0x0F) << 16) | ((uint16_t)frame[position + 1] << 8) | frame[position + 2];
+}
+
+
+/*
+ * Remote configuration downlink (enableRemote()): SIGFOX_REMOTE_SIZE bytes
+ * 	byte 0: bits 7..4 SIGFOX_REMOTE_TAG, bits 3..0 configuration version
+ * 	then opcodes (see SigfoxRemoteOpcodes), each followed by its value in
+ * 	SIGFOX_REMOTE_ARGS bytes (MSB first), up to SIGFOX_RC_END or the end of 
+ * 	the payload
+ * Applications using it keep SIGFOX_REMOTE_TAG out of the first 4 bits of 
+ * their own downlinks.
+ *
+ * Acknowledge (SIGFOX_REMOTE_ACK_SIZE byte): appended to the next frame of 
+ * the binary send functions with a spare byte, before the telemetry slice 
+ * and the sequence trailer: bits 7..4 SIGFOX_REMOTE_TAG if the configuration
+ * was applied, SIGFOX_REMOTE_REJECTED if not, bits 3..0 its version.
+ */
+#define SIGFOX_REMOTE_TAG			0x0C
+#define SIGFOX_REMOTE_REJECTED		0x0D
+#define SIGFOX_REMOTE_SIZE			8
+#define SIGFOX_REMOTE_ACK_SIZE		1
+
+/*! @enum SigfoxRemoteOpcodes
+ * Opcodes of a remote configuration downlink
+ */
+enum SigfoxRemoteOpcodes
+{
+	SIGFOX_RC_END			= 0,	// no more opcodes (padding)
+	SIGFOX_RC_POWER			= 1,	// TX power (in dBm), maximum of the power controller if on
+	SIGFOX_RC_KEEP_ALIVE	= 2,	// hours between keep-alive messages
+	SIGFOX_RC_INTERVAL		= 3,	// application uplink interval (in minutes)
+	SIGFOX_RC_DOWNLINKS		= 4,	// downlink requests per day, '0' for every sendACK()
+	SIGFOX_RC_TELEMETRY		= 5,	// uplinks between telemetry frames, '0' for none
+	SIGFOX_RC_HEARTBEAT		= 6,	// send-on-change filter heartbeat
+	SIGFOX_RC_DEADBAND		= 7,	// filter field index (8 bits), deadband (16 bits)
+	SIGFOX_RC_OPCODES		= 8,
+};
+
+//! Value bytes of each opcode
+static const uint8_t SIGFOX_REMOTE_ARGS[SIGFOX_RC_OPCODES] = { 0, 1, 1, 2, 1, 1, 2, 3 };
+
+//! Start a remote configuration downlink, returns its length so far
+static inline uint8_t sigfoxRemoteBegin(uint8_t* frame, uint8_t version)
+{
+	for (uint8_t i = 0; i < SIGFOX_REMOTE_SIZE; i++)
+	{
+		frame[i] = SIGFOX_RC_END;
+	}
+	frame[0] = (SIGFOX_REMOTE_TAG << 4) | (version & 0x0F);
+	
+	return 1;
+}
+
+//! Append an opcode and its value, returns the new length or '0' if it 
+//! does not fit
+static inline uint8_t sigfoxRemoteAdd(uint8_t* frame, uint8_t length, uint8_t opcode, uint32_t value)
+{
+	uint8_t bytes = SIGFOX_REMOTE_ARGS[opcode];
+	
+	if (length + 1 + bytes > SIGFOX_REMOTE_SIZE)
+	{
+		return 0;
+	}
+	
+	frame[length++] = opcode;
+	while (bytes > 0)
+	{
+		bytes--;
+		frame[length++] = (value >> (bytes * 8)) & 0xFF;
+	}
+	
+	return length;
+}
+
+//! Read the opcode at 'position' and its value, returns the position of 
+//! the next one or '0' if the opcode is unknown or truncated
+static inline uint8_t sigfoxRemoteNext(const uint8_t* frame, uint8_t length, uint8_t position, uint8_t* opcode, uint32_t* value)
+{
+	uint8_t bytes;
+	
+	*opcode = frame[position++];
+	*value = 0;
+	
+	if (*opcode >= SIGFOX_RC_OPCODES)
+	{
+		return 0;
+	}
+	
+	bytes = SIGFOX_REMOTE_ARGS[*opcode];
+	if (position + bytes > length)
+	{
+		return 0;
+	}
+	
+	while (bytes > 0)
+	{
+		*value = (*value << 8) | frame[position++];
+		bytes--;
+	}
+	
+	return position;
+}
+
+
+#endif
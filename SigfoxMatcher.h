@@ -0,0 +1,244 @@
+/*! 
+ * @file 	SigfoxMatcher.h
+ * @author	Sean van der Walt / Walt Technologies Pty Ltd
+ * @version	0.1
+ * @brief 	Multi-pattern matcher (Aho-Corasick automaton) used to classify 
+ * 			the lines received from the module in a single pass
+ *
+ *  Copyright (C) 2017 Walt Technologies Pty Ltd
+ *  https://walt-tech.com.au
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *    
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *   
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *	
+ */
+ 
+#ifndef SigfoxMatcher_h
+#define SigfoxMatcher_h
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+
+#include <inttypes.h>
+
+
+/******************************************************************************
+ * Definitions & Declarations
+ *****************************************************************************/
+
+//! Automaton size: total pattern length + 1 (up to 255)
+#ifndef SIGFOX_MATCH_STATES
+#define SIGFOX_MATCH_STATES		32
+#endif
+
+//! Maximum number of patterns
+#ifndef SIGFOX_MATCH_PATTERNS
+#define SIGFOX_MATCH_PATTERNS	8
+#endif
+
+
+/******************************************************************************
+ * Class
+ *****************************************************************************/
+
+/*! @class SigfoxMatcher
+ * Patterns are compiled into a trie with failure links, so feeding one byte
+ * follows at most a few links and reports the pattern ending there, whatever
+ * the number of patterns. State '0' is the root.
+ */
+class SigfoxMatcher
+{
+	private:
+		uint8_t _label[SIGFOX_MATCH_STATES];	// byte leading to the state
+		uint8_t _child[SIGFOX_MATCH_STATES];	// first child, '0' if none
+		uint8_t _sibling[SIGFOX_MATCH_STATES];	// next child of the parent
+		uint8_t _fail[SIGFOX_MATCH_STATES];		// longest proper suffix state
+		uint8_t _output[SIGFOX_MATCH_STATES];	// pattern ending here + 1
+		uint8_t _dict[SIGFOX_MATCH_STATES];		// nearest suffix state with output
+		uint8_t _length[SIGFOX_MATCH_PATTERNS];
+		uint8_t _states;
+		uint8_t _patterns;
+		uint8_t _state;
+		
+		//! transition of the trie, '0' if none
+		uint8_t next(uint8_t state, uint8_t c)
+		{
+			for (uint8_t s = _child[state]; s != 0; s = _sibling[s])
+			{
+				if (_label[s] == c)		return s;
+			}
+			return 0;
+		}
+		
+		//! failure and dictionary links, breadth first
+		void compile()
+		{
+			uint8_t queue[SIGFOX_MATCH_STATES];
+			uint8_t head = 0;
+			uint8_t tail = 0;
+			
+			for (uint8_t s = _child[0]; s != 0; s = _sibling[s])
+			{
+				_fail[s] = 0;
+				_dict[s] = 0;
+				queue[tail++] = s;
+			}
+			
+			while (head < tail)
+			{
+				uint8_t u = queue[head++];
+				
+				for (uint8_t v = _child[u]; v != 0; v = _sibling[v])
+				{
+					uint8_t f = _fail[u];
+					uint8_t w;
+					
+					while (((w = next(f, _label[v])) == 0) && (f != 0))
+					{
+						f = _fail[f];
+					}
+					_fail[v] = w;
+					_dict[v] = _output[w] ? w : _dict[w];
+					queue[tail++] = v;
+				}
+			}
+		}
+		
+	public:
+		//! class constructor
+		SigfoxMatcher()
+		{
+			clear();
+		};
+		
+		//! remove all patterns
+		void clear()
+		{
+			_label[0] = 0;
+			_child[0] = 0;
+			_sibling[0] = 0;
+			_fail[0] = 0;
+			_output[0] = 0;
+			_dict[0] = 0;
+			_states = 1;
+			_patterns = 0;
+			_state = 0;
+		}
+		
+		/*!
+		 * @brief	This function adds a pattern and recompiles the automaton
+		 * @param	const char* pattern: bytes to match (not empty)
+		 * @return	pattern index, '-1' if there is no room left
+		 */
+		int8_t add(const char* pattern)
+		{
+			uint8_t state = 0;
+			uint8_t length = 0;
+			uint8_t needed = 0;
+			
+			if ((pattern[0] == 0) || (_patterns >= SIGFOX_MATCH_PATTERNS))
+			{
+				return -1;
+			}
+			
+			// check room first so a failed add leaves the automaton intact
+			for (const char* p = pattern; *p; p++)
+			{
+				if (needed == 0)
+				{
+					uint8_t s = next(state, *p);
+					if (s != 0)
+					{
+						state = s;
+						continue;
+					}
+				}
+				needed++;
+			}
+			if ((_states + needed) > SIGFOX_MATCH_STATES)
+			{
+				return -1;
+			}
+			
+			state = 0;
+			for (const char* p = pattern; *p; p++, length++)
+			{
+				uint8_t s = next(state, *p);
+				
+				if (s == 0)
+				{
+					s = _states++;
+					_label[s] = *p;
+					_child[s] = 0;
+					_output[s] = 0;
+					_sibling[s] = _child[state];
+					_child[state] = s;
+				}
+				state = s;
+			}
+			
+			if (_output[state] != 0)
+			{
+				// same pattern already added
+				return _output[state] - 1;
+			}
+			
+			_output[state] = _patterns + 1;
+			_length[_patterns] = length;
+			compile();
+			
+			return _patterns++;
+		}
+		
+		//! restart matching, i.e. at the beginning of a line
+		void reset()
+		{
+			_state = 0;
+		}
+		
+		/*!
+		 * @brief	This function feeds one byte
+		 * @param	uint8_t c: received byte
+		 * @return	index of a pattern ending with this byte, '-1' if none
+		 */
+		int8_t feed(uint8_t c)
+		{
+			uint8_t s;
+			
+			while (((s = next(_state, c)) == 0) && (_state != 0))
+			{
+				_state = _fail[_state];
+			}
+			_state = s;
+			
+			if (_output[s])		return _output[s] - 1;
+			if (_dict[s])		return _output[_dict[s]] - 1;
+			return -1;
+		}
+		
+		//! length of a pattern
+		uint8_t length(uint8_t pattern)
+		{
+			return _length[pattern];
+		}
+		
+		//! number of patterns
+		uint8_t patterns()
+		{
+			return _patterns;
+		}
+};
+
+
+#endif
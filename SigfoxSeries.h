@@ -0,0 +1,385 @@
+/*!
+ * @file 	SigfoxSeries.h
+ * @author	Sean van der Walt / Walt Technologies Pty Ltd
+ * @version	0.1
+ * @brief 	Streaming time series compressor filling Sigfox frames (Gorilla
+ * 			style): delta-of-delta timestamps, zig-zag varint deltas for
+ * 			integer values and XOR encoding for float values. The encoder
+ * 			works in the frame itself, so it needs no memory beyond the
+ * 			object. The host decoder is extras/host/SigfoxSeriesDecoder.
+ *
+ *  Copyright (C) 2017 Walt Technologies Pty Ltd
+ *  https://walt-tech.com.au
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SigfoxSeries_h
+#define SigfoxSeries_h
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+
+#include <inttypes.h>
+#include <string.h>
+#include "SigfoxFrame.h"
+
+
+/******************************************************************************
+ * Definitions & Declarations
+ *****************************************************************************/
+
+/*
+ * Frame layout, bit-packed MSB first like SigfoxFieldLayout:
+ * 	header (8 bits): bits 7..6 series type, bits 5..0 sample count
+ * 	first sample:	time (16 bits, wraps), value (integer: varint of the
+ * 					zig-zag value, float: 32 raw bits)
+ * 	second sample:	time delta (varint), value
+ * 	next samples:	time delta-of-delta, value
+ *
+ * Time delta-of-delta (zig-zag):
+ * 	'0'					same delta
+ * 	'10'   + 4 bits		up to 15
+ * 	'110'  + 8 bits		up to 255
+ * 	'1110' + 12 bits	up to 4095
+ * 	'1111' + 32 bits	anything else
+ *
+ * Integer value after the first one:
+ * 	'0'					same value
+ * 	'1' + varint		zig-zag delta - 1
+ *
+ * Float value after the first one (XOR with the previous value):
+ * 	'0'					same value
+ * 	'10' + bits			meaningful bits inside the previous window
+ * 	'11' + 5 bits leading zeros + 5 bits length - 1 + bits
+ *
+ * Varints are groups of 4 bits, least significant first: 1 bit "more
+ * groups follow" and 3 value bits.
+ */
+#define SIGFOX_SERIES_HEADER_BITS	8
+#define SIGFOX_SERIES_TIME_BITS		16
+#define SIGFOX_SERIES_MAX_COUNT		63
+#define SIGFOX_SERIES_BITS			(SIGFOX_MAX_PAYLOAD * 8)
+
+/*! @enum SigfoxSeriesTypes
+ * Value encoding of a series
+ */
+enum SigfoxSeriesTypes
+{
+	SIGFOX_SERIES_INTEGER	= 0,	// int32_t, zig-zag varint deltas
+	SIGFOX_SERIES_FLOAT		= 1,	// float, XOR with the previous value
+};
+
+//! Write 'bits' bits of a value at a bit position (MSB first)
+static inline void sigfoxPutBits(uint8_t* frame, uint8_t position, uint32_t value, uint8_t bits)
+{
+	while (bits > 0)
+	{
+		bits--;
+		if ((value >> bits) & 0x01)	frame[position >> 3] |= (0x80 >> (position & 0x07));
+		else						frame[position >> 3] &= ~(0x80 >> (position & 0x07));
+		position++;
+	}
+}
+
+//! Read 'bits' bits at a bit position (MSB first)
+static inline uint32_t sigfoxGetBits(const uint8_t* frame, uint8_t position, uint8_t bits)
+{
+	uint32_t value = 0;
+
+	while (bits > 0)
+	{
+		value = (value << 1) | ((frame[position >> 3] >> (7 - (position & 0x07))) & 0x01);
+		position++;
+		bits--;
+	}
+
+	return value;
+}
+
+//! Zig-zag encoding: small negative and positive values give small codes
+static inline uint32_t sigfoxZigZag(int32_t value)
+{
+	return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+//! Zig-zag decoding
+static inline int32_t sigfoxUnZigZag(uint32_t code)
+{
+	return (int32_t)(code >> 1) ^ -(int32_t)(code & 0x01);
+}
+
+//! Number of bits of a varint
+static inline uint8_t sigfoxVarintBits(uint32_t value)
+{
+	uint8_t bits = 4;
+
+	while (value > 0x07)
+	{
+		value >>= 3;
+		bits += 4;
+	}
+
+	return bits;
+}
+
+
+/******************************************************************************
+ * Class
+ *****************************************************************************/
+
+/*! @class SigfoxSeries
+ * Compresses one sensor series into a frame. add() appends a sample if it
+ * fits; when it does not, send '_frame' (length() bytes), call reset() and
+ * add the sample again. Timestamps must not go backwards; their unit (i.e.
+ * seconds) is up to the application, and only the first one is sent (16
+ * bits, wrapping), the others are rebuilt from it.
+ */
+class SigfoxSeries
+{
+	private:
+		uint8_t _type;
+		uint8_t _bits;				// bits used in '_frame'
+		uint32_t _time;				// previous sample
+		uint32_t _value;
+		int32_t _delta;				// previous time delta
+		uint8_t _leading;			// previous XOR window, '0xFF' if none
+		uint8_t _trailing;
+
+		//! write bits at the end of the frame
+		void put(uint32_t value, uint8_t bits)
+		{
+			sigfoxPutBits(_frame, _bits, value, bits);
+			_bits += bits;
+		}
+
+		//! write a varint at the end of the frame
+		void putVarint(uint32_t value)
+		{
+			do
+			{
+				put(((value > 0x07) ? 0x08 : 0x00) | (value & 0x07), 4);
+				value >>= 3;
+			}
+			while (value > 0);
+		}
+
+		//! bits of the time code of a sample
+		uint8_t timeBits(uint32_t time)
+		{
+			int32_t delta = (int32_t)(time - _time);
+			uint32_t code;
+
+			if (_count == 1)	return sigfoxVarintBits((uint32_t)delta);
+
+			code = sigfoxZigZag(delta - _delta);
+			if (code == 0)		return 1;
+			if (code < 16)		return 2 + 4;
+			if (code < 256)		return 3 + 8;
+			if (code < 4096)	return 4 + 12;
+			return 4 + 32;
+		}
+
+		//! write the time code of a sample
+		void putTime(uint32_t time)
+		{
+			int32_t delta = (int32_t)(time - _time);
+			uint32_t code;
+
+			if (_count == 1)
+			{
+				putVarint((uint32_t)delta);
+			}
+			else
+			{
+				code = sigfoxZigZag(delta - _delta);
+				if (code == 0)			put(0x00, 1);
+				else if (code < 16)		{ put(0x02, 2); put(code, 4); }
+				else if (code < 256)	{ put(0x06, 3); put(code, 8); }
+				else if (code < 4096)	{ put(0x0E, 4); put(code, 12); }
+				else					{ put(0x0F, 4); put(code, 32); }
+			}
+
+			_delta = delta;
+			_time = time;
+		}
+
+		//! check that a sample with a value code of 'valueBits' fits
+		bool fits(uint32_t time, uint8_t valueBits)
+		{
+			uint8_t bits;
+
+			if (_count >= SIGFOX_SERIES_MAX_COUNT)
+			{
+				return false;
+			}
+
+			if (_count == 0)	bits = SIGFOX_SERIES_HEADER_BITS + SIGFOX_SERIES_TIME_BITS;
+			else				bits = timeBits(time);
+
+			return (uint16_t)_bits + bits + valueBits <= SIGFOX_SERIES_BITS;
+		}
+
+		//! write header or time, and count the sample
+		void putSample(uint32_t time)
+		{
+			if (_count == 0)
+			{
+				_bits = SIGFOX_SERIES_HEADER_BITS;
+				put(time & 0xFFFF, SIGFOX_SERIES_TIME_BITS);
+				_time = time;
+			}
+			else
+			{
+				putTime(time);
+			}
+
+			_count++;
+			_frame[0] = (_type << 6) | _count;
+		}
+
+	public:
+		uint8_t _frame[SIGFOX_MAX_PAYLOAD];	/*!< Frame being filled		*/
+		uint8_t _count;						/*!< Samples in the frame	*/
+
+		//! class constructor
+		//! @param	uint8_t type: value encoding (see SigfoxSeriesTypes)
+		SigfoxSeries(uint8_t type)
+		{
+			_type = type;
+			reset();
+		}
+
+		//! start a new frame
+		void reset()
+		{
+			memset(_frame, 0x00, sizeof(_frame));
+			_count = 0;
+			_bits = 0;
+			_delta = 0;
+			_leading = 0xFF;
+			_trailing = 0;
+		}
+
+		//! bytes used in '_frame'
+		uint8_t length() const
+		{
+			return (_bits + 7) >> 3;
+		}
+
+		//! append an integer sample. 'false' if it does not fit
+		bool add(uint32_t time, int32_t value)
+		{
+			uint32_t code;
+			uint8_t bits;
+
+			if (_count == 0)
+			{
+				code = sigfoxZigZag(value);
+				bits = sigfoxVarintBits(code);
+			}
+			else
+			{
+				code = sigfoxZigZag(value - (int32_t)_value);
+				bits = (code == 0) ? 1 : 1 + sigfoxVarintBits(code - 1);
+			}
+
+			if (!fits(time, bits))
+			{
+				return false;
+			}
+
+			putSample(time);
+
+			if (_count == 1)		putVarint(code);
+			else if (code == 0)		put(0x00, 1);
+			else					{ put(0x01, 1); putVarint(code - 1); }
+
+			_value = (uint32_t)value;
+
+			return true;
+		}
+
+		//! append a float sample. 'false' if it does not fit
+		bool add(uint32_t time, float value)
+		{
+			uint32_t raw;
+			uint32_t x;
+			uint8_t leading = 0;
+			uint8_t trailing = 0;
+			uint8_t bits;
+			bool reuse = false;
+
+			memcpy(&raw, &value, sizeof(raw));
+			x = raw ^ _value;
+
+			if (_count == 0)
+			{
+				bits = 32;
+			}
+			else if (x == 0)
+			{
+				bits = 1;
+			}
+			else
+			{
+				// meaningful bits of the XOR
+				while (!((x << leading) & 0x80000000UL))	leading++;
+				while (!((x >> trailing) & 0x01))			trailing++;
+
+				reuse = (_leading != 0xFF) && (leading >= _leading) && (trailing >= _trailing);
+				if (reuse)	bits = 2 + 32 - _leading - _trailing;
+				else		bits = 2 + 5 + 5 + 32 - leading - trailing;
+			}
+
+			if (!fits(time, bits))
+			{
+				return false;
+			}
+
+			putSample(time);
+
+			if (_count == 1)
+			{
+				put(raw, 32);
+			}
+			else if (x == 0)
+			{
+				put(0x00, 1);
+			}
+			else if (reuse)
+			{
+				put(0x02, 2);
+				put(x >> _trailing, 32 - _leading - _trailing);
+			}
+			else
+			{
+				put(0x03, 2);
+				put(leading, 5);
+				put(32 - leading - trailing - 1, 5);
+				put(x >> trailing, 32 - leading - trailing);
+				_leading = leading;
+				_trailing = trailing;
+			}
+
+			_value = raw;
+
+			return true;
+		}
+};
+
+
+#endif
@@ -0,0 +1,510 @@
+/*! 
+ * @file 	SigfoxCoroutine.cpp
+ * @author	Sean van der Walt / Walt Technologies Pty Ltd
+ * @version	0.1
+ * @brief 	C++20 coroutine API for host builds of LYNXBeeSigfox. Module
+ * 			commands are co_await-ed and run on the non-blocking command
+ * 			layer, so one thread interleaves the conversations of many
+ * 			modules.
+ *
+ *  Copyright (C) 2017 Walt Technologies Pty Ltd
+ *  https://walt-tech.com.au
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *    
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *   
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *	
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <cstddef>
+#include <new>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include "SigfoxCoroutine.h"
+
+#define SIGFOX_LOOP_EVENTS	64
+
+//! room in front of each task frame for the pool it came from
+#define SIGFOX_FRAME_HEADER	alignof(std::max_align_t)
+
+SigfoxFramePool* SigfoxFramePool::_current = NULL;
+
+
+/*!
+ * @brief	class constructor
+ * @param	size_t blockSize: size of a block, at least the largest task frame
+ * @param	size_t count: number of blocks
+ */
+SigfoxFramePool::SigfoxFramePool(size_t blockSize, size_t count)
+	: _free(NULL), _used(0), _peak(0), _fallbacks(0)
+{
+	// keep blocks aligned for any frame, with room for the frame header
+	const size_t align = alignof(std::max_align_t);
+	_blockSize = (blockSize + SIGFOX_FRAME_HEADER + align - 1) / align * align;
+	if (_blockSize < sizeof(Block))
+	{
+		_blockSize = sizeof(Block);
+	}
+
+	_storage.resize(_blockSize * count + align);
+
+	unsigned char* base = _storage.data();
+	base += (align - ((uintptr_t)base % align)) % align;
+
+	for (size_t i = count; i > 0; i--)
+	{
+		Block* block = (Block*)(base + (i - 1) * _blockSize);
+		block->next = _free;
+		_free = block;
+	}
+}
+
+
+
+
+/*!
+ * @brief	class destructor. Uninstalls the pool. Aborts if frames still
+ * 			use its blocks: they would be released to freed storage.
+ */
+SigfoxFramePool::~SigfoxFramePool()
+{
+	if (_used > 0)
+	{
+		fprintf(stderr, "SigfoxFramePool destroyed with %zu frames in use\n", _used);
+		abort();
+	}
+	
+	if (_current == this)
+	{
+		_current = NULL;
+	}
+}
+
+
+
+
+/*!
+ * @brief	This function takes a block
+ * @param	size_t size: frame size
+ * @return	block, or NULL if the frame does not fit or the pool is empty
+ */
+void* SigfoxFramePool::allocate(size_t size)
+{
+	if ((size > _blockSize) || (_free == NULL))
+	{
+		_fallbacks++;
+		return NULL;
+	}
+
+	Block* block = _free;
+	_free = block->next;
+
+	_used++;
+	if (_used > _peak)
+	{
+		_peak = _used;
+	}
+
+	return block;
+}
+
+
+
+
+/*!
+ * @brief	This function gives a block back
+ * @param	void* pointer: block
+ * @return	'false' if the pointer is not a block of this pool
+ */
+bool SigfoxFramePool::release(void* pointer)
+{
+	unsigned char* address = (unsigned char*)pointer;
+
+	if ((address < _storage.data()) || (address >= _storage.data() + _storage.size()))
+	{
+		return false;
+	}
+
+	Block* block = (Block*)pointer;
+	block->next = _free;
+	_free = block;
+	_used--;
+
+	return true;
+}
+
+
+
+
+
+//  SigfoxTask  ///////////////////////////////////////////////////////////////
+
+
+
+/*!
+ * @brief	This function allocates a task frame from the installed pool, or
+ * 			from the heap. The pool is recorded in front of the frame.
+ */
+void* SigfoxTask::promise_type::operator new(size_t size)
+{
+	SigfoxFramePool* owner = SigfoxFramePool::_current;
+	unsigned char* block = NULL;
+
+	if (owner)
+	{
+		block = (unsigned char*)owner->allocate(size + SIGFOX_FRAME_HEADER);
+	}
+	if (block == NULL)
+	{
+		owner = NULL;
+		block = (unsigned char*)::operator new(size + SIGFOX_FRAME_HEADER);
+	}
+
+	*(SigfoxFramePool**)block = owner;
+
+	return block + SIGFOX_FRAME_HEADER;
+}
+
+
+
+
+/*!
+ * @brief	This function frees a task frame, to the pool it came from even
+ * 			if another pool is installed since
+ */
+void SigfoxTask::promise_type::operator delete(void* pointer)
+{
+	unsigned char* block = (unsigned char*)pointer - SIGFOX_FRAME_HEADER;
+	SigfoxFramePool* owner = *(SigfoxFramePool**)block;
+
+	if (!owner || !owner->release(block))
+	{
+		::operator delete(block);
+	}
+}
+
+
+
+
+/*!
+ * @brief	move assignment. The previous frame is destroyed.
+ */
+SigfoxTask& SigfoxTask::operator=(SigfoxTask&& other) noexcept
+{
+	if (this != &other)
+	{
+		if (_handle)
+		{
+			_handle.destroy();
+		}
+		_handle = other._handle;
+		other._handle = NULL;
+	}
+
+	return *this;
+}
+
+
+
+
+/*!
+ * @brief	class destructor. Destroys the frame; do not destroy a task
+ * 			which is still waiting for a command.
+ */
+SigfoxTask::~SigfoxTask()
+{
+	if (_handle)
+	{
+		_handle.destroy();
+	}
+}
+
+
+
+
+
+//  SigfoxCoModule  ///////////////////////////////////////////////////////////
+
+
+
+/*!
+ * @brief	This function suspends the task until the command ends
+ * @param	std::coroutine_handle<> h: task
+ * @return	void
+ */
+void SigfoxAwait::await_suspend(std::coroutine_handle<> h)
+{
+	_module._waiter = h;
+	_module._await = this;
+}
+
+
+
+
+/*!
+ * @brief	class constructor
+ * @param	SigfoxLoop& loop: loop running the module
+ * @param	const char* device: serial port, i.e. "/dev/ttyUSB0"
+ */
+SigfoxCoModule::SigfoxCoModule(SigfoxLoop& loop, const char* device)
+	: _loop(loop), _device(device), _waiter(NULL), _await(NULL), _next(NULL), _watched(false)
+{
+	_driver.setDevice(_device.c_str());
+	_loop.add(this);
+}
+
+
+
+
+/*!
+ * @brief	class destructor. Closes the serial port.
+ */
+SigfoxCoModule::~SigfoxCoModule()
+{
+	_loop.remove(this);
+	_driver.closeUART();
+}
+
+
+
+
+/*!
+ * @brief	This function powers on the module and checks communication
+ * @return	awaitable answer
+ */
+SigfoxAwait SigfoxCoModule::ON()
+{
+	uint8_t answer = _driver.beginON(SOCKET0);
+
+	if (_driver._fd < 0)
+	{
+		return start(SIGFOX_ANSWER_ERROR);
+	}
+
+	_loop.watch(this);
+
+	return start(answer);
+}
+
+
+
+
+
+//  SigfoxLoop  ///////////////////////////////////////////////////////////////
+
+
+
+/*!
+ * @brief	class constructor
+ */
+SigfoxLoop::SigfoxLoop()
+	: _modules(NULL)
+{
+	_epoll = epoll_create1(EPOLL_CLOEXEC);
+}
+
+
+
+
+/*!
+ * @brief	class destructor
+ */
+SigfoxLoop::~SigfoxLoop()
+{
+	if (_epoll >= 0)
+	{
+		close(_epoll);
+	}
+}
+
+
+
+
+/*!
+ * @brief	This function links a module
+ * @param	SigfoxCoModule* module: module
+ * @return	void
+ */
+void SigfoxLoop::add(SigfoxCoModule* module)
+{
+	module->_next = _modules;
+	_modules = module;
+}
+
+
+
+
+/*!
+ * @brief	This function unlinks a module and stops watching its port
+ * @param	SigfoxCoModule* module: module
+ * @return	void
+ */
+void SigfoxLoop::remove(SigfoxCoModule* module)
+{
+	SigfoxCoModule** link = &_modules;
+
+	while (*link && (*link != module))
+	{
+		link = &(*link)->_next;
+	}
+	if (*link)
+	{
+		*link = module->_next;
+	}
+
+	if (module->_watched)
+	{
+		epoll_ctl(_epoll, EPOLL_CTL_DEL, module->_driver._fd, NULL);
+		module->_watched = false;
+	}
+}
+
+
+
+
+/*!
+ * @brief	This function watches the serial port of a module
+ * @param	SigfoxCoModule* module: module
+ * @return	void
+ */
+void SigfoxLoop::watch(SigfoxCoModule* module)
+{
+	struct epoll_event event;
+
+	if (module->_watched)
+	{
+		return;
+	}
+
+	event.events = EPOLLIN;
+	event.data.ptr = module;
+	module->_watched = (epoll_ctl(_epoll, EPOLL_CTL_ADD, module->_driver._fd, &event) == 0);
+}
+
+
+
+
+/*!
+ * @brief	This function runs the command of a module and resumes its task
+ * 			when the command ended
+ * @param	SigfoxCoModule* module: module
+ * @return	void
+ */
+void SigfoxLoop::poll(SigfoxCoModule* module)
+{
+	if (!module->_waiter)
+	{
+		// nobody waiting: keep the receive buffer flowing
+		module->_driver.serviceRX();
+		return;
+	}
+
+	uint8_t answer = module->_driver.pollAT();
+	if (answer == SIGFOX_ANSWER_PENDING)
+	{
+		return;
+	}
+
+	std::coroutine_handle<> waiter = module->_waiter;
+
+	module->_await->_answer = answer;
+	module->_await = NULL;
+	module->_waiter = NULL;
+
+	// may start the next command on this module
+	waiter.resume();
+}
+
+
+
+
+/*!
+ * @brief	This function tells if a task waits for a command
+ * @return	'true' if a task waits
+ */
+bool SigfoxLoop::busy() const
+{
+	for (SigfoxCoModule* module = _modules; module; module = module->_next)
+	{
+		if (module->_waiter)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+
+
+/*!
+ * @brief	This function waits for serial data or the nearest command
+ * 			timeout and resumes the tasks concerned
+ * @param	int timeout: maximum time to wait (in ms), -1 for no limit
+ * @return	number of ready ports
+ */
+int SigfoxLoop::runOnce(int timeout)
+{
+	struct epoll_event events[SIGFOX_LOOP_EVENTS];
+	SigfoxCoModule* module;
+	int count;
+
+	// do not sleep past the nearest command deadline
+	for (module = _modules; module; module = module->_next)
+	{
+		if (module->_waiter)
+		{
+			int left = (int)module->_driver.timeLeftAT();
+			if ((timeout < 0) || (left < timeout))
+			{
+				timeout = left;
+			}
+		}
+	}
+
+	count = epoll_wait(_epoll, events, SIGFOX_LOOP_EVENTS, timeout);
+
+	for (int i = 0; i < count; i++)
+	{
+		poll((SigfoxCoModule*)events[i].data.ptr);
+	}
+
+	// commands which timed out
+	for (module = _modules; module; module = module->_next)
+	{
+		if (module->_waiter && (module->_driver.timeLeftAT() == 0))
+		{
+			poll(module);
+		}
+	}
+
+	return count;
+}
+
+
+
+
+/*!
+ * @brief	This function runs until no task waits for a command
+ * @return	void
+ */
+void SigfoxLoop::run()
+{
+	while (busy())
+	{
+		runOnce(-1);
+	}
+}
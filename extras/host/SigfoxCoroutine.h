@@ -0,0 +1,236 @@
+/*! 
+ * @file 	SigfoxCoroutine.h
+ * @author	Sean van der Walt / Walt Technologies Pty Ltd
+ * @version	0.1
+ * @brief 	C++20 coroutine API for host builds of LYNXBeeSigfox. Module
+ * 			commands are co_await-ed and run on the non-blocking command
+ * 			layer, so one thread interleaves the conversations of many
+ * 			modules. Build with -std=c++20 and
+ * 			-DSIGFOX_TRANSPORT_HEADER='"extras/host/SigfoxPosixUART.h"'
+ *
+ *  Copyright (C) 2017 Walt Technologies Pty Ltd
+ *  https://walt-tech.com.au
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *    
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *   
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *	
+ */
+
+#ifndef SigfoxCoroutine_h
+#define SigfoxCoroutine_h
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+
+#include <stddef.h>
+#include <coroutine>
+#include <string>
+#include <vector>
+#include "../../LYNXBeeSigfox.h"
+
+
+/******************************************************************************
+ * Class
+ *****************************************************************************/
+
+/*! @class SigfoxFramePool
+ * Fixed size blocks for coroutine frames. Once a pool is installed, SigfoxTask
+ * frames are taken from it and running a task does not touch the heap. Frames
+ * larger than a block, or taken when the pool is empty, come from the heap
+ * and are counted in '_fallbacks'. A frame goes back to the pool it came
+ * from, even if another pool is installed meanwhile; destroy a pool only
+ * after its tasks. Not thread safe: use it from the thread running the
+ * SigfoxLoop.
+ */
+class SigfoxFramePool
+{
+	private:
+		struct Block
+		{
+			Block* next;
+		};
+
+		std::vector<unsigned char> _storage;
+		Block* _free;
+		size_t _blockSize;
+
+	public:
+		size_t _used;					/*!< Blocks in use					*/
+		size_t _peak;					/*!< Maximum blocks in use			*/
+		size_t _fallbacks;				/*!< Frames taken from the heap		*/
+
+		static SigfoxFramePool* _current;	/*!< Pool used by SigfoxTask	*/
+
+		SigfoxFramePool(size_t blockSize, size_t count);
+		~SigfoxFramePool();
+
+		void* allocate(size_t size);
+		bool release(void* pointer);
+		void install() { _current = this; }
+};
+
+
+
+class SigfoxLoop;
+class SigfoxCoModule;
+
+
+/*! @class SigfoxTask
+ * Coroutine returning a module answer (see AnswersTypes). It starts running
+ * when called; co_await it from another task to get its answer, or keep it
+ * and check done() after SigfoxLoop::run().
+ */
+class SigfoxTask
+{
+	public:
+		struct promise_type
+		{
+			uint8_t answer;
+			std::coroutine_handle<> continuation;
+
+			SigfoxTask get_return_object()
+			{
+				return SigfoxTask(std::coroutine_handle<promise_type>::from_promise(*this));
+			}
+			std::suspend_never initial_suspend() noexcept { return {}; }
+
+			// resume the awaiting task, if any
+			struct FinalAwait
+			{
+				bool await_ready() noexcept { return false; }
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept
+				{
+					std::coroutine_handle<> next = h.promise().continuation;
+					return next ? next : std::noop_coroutine();
+				}
+				void await_resume() noexcept {}
+			};
+			FinalAwait final_suspend() noexcept { return {}; }
+
+			void return_value(uint8_t value) { answer = value; }
+			void unhandled_exception() { throw; }
+
+			static void* operator new(size_t size);
+			static void operator delete(void* pointer);
+		};
+
+		SigfoxTask() : _handle(NULL) {}
+		SigfoxTask(SigfoxTask&& other) noexcept : _handle(other._handle) { other._handle = NULL; }
+		SigfoxTask& operator=(SigfoxTask&& other) noexcept;
+		~SigfoxTask();
+
+		bool done() const { return !_handle || _handle.done(); }
+		uint8_t answer() const { return _handle.promise().answer; }
+
+		// co_await support
+		bool await_ready() const { return done(); }
+		void await_suspend(std::coroutine_handle<> h) { _handle.promise().continuation = h; }
+		uint8_t await_resume() const { return answer(); }
+
+	private:
+		std::coroutine_handle<promise_type> _handle;
+
+		explicit SigfoxTask(std::coroutine_handle<promise_type> handle) : _handle(handle) {}
+};
+
+
+
+/*! @class SigfoxAwait
+ * Command started on a module. co_await returns its answer.
+ */
+class SigfoxAwait
+{
+	private:
+		SigfoxCoModule& _module;
+		uint8_t _answer;
+
+	public:
+		SigfoxAwait(SigfoxCoModule& module, uint8_t answer) : _module(module), _answer(answer) {}
+
+		bool await_ready() const { return _answer != SIGFOX_ANSWER_PENDING; }
+		void await_suspend(std::coroutine_handle<> h);
+		uint8_t await_resume() const { return _answer; }
+
+		friend class SigfoxLoop;
+};
+
+
+
+/*! @class SigfoxCoModule
+ * One module on a serial port. Each function starts the command right away
+ * and returns an awaitable; only one command may run at a time.
+ */
+class SigfoxCoModule
+{
+	private:
+		SigfoxLoop& _loop;
+		std::string _device;
+		std::coroutine_handle<> _waiter;
+		SigfoxAwait* _await;
+		SigfoxCoModule* _next;			// SigfoxLoop list
+		bool _watched;
+
+		SigfoxAwait start(uint8_t answer) { return SigfoxAwait(*this, answer); }
+
+	public:
+		LYNXBeeSigfox _driver;			/*!< Driver ('_id', '_downlink', ...)	*/
+
+		SigfoxCoModule(SigfoxLoop& loop, const char* device);
+		~SigfoxCoModule();
+
+		SigfoxAwait ON();
+		SigfoxAwait check() { return start(_driver.beginCheck()); }
+		SigfoxAwait getID() { return start(_driver.beginGetID()); }
+		SigfoxAwait send(uint8_t* data, uint16_t length) { return start(_driver.beginSend(data, length)); }
+		SigfoxAwait sendACK(uint8_t* data, uint16_t length) { return start(_driver.beginSendACK(data, length)); }
+		SigfoxAwait setPower(uint8_t power) { return start(_driver.beginSetPower(power)); }
+		SigfoxAwait setFrequency(uint32_t freq) { return start(_driver.beginSetFrequency(freq)); }
+		SigfoxAwait sendKeepAlive(uint8_t period) { return start(_driver.beginSendKeepAlive(period)); }
+
+		bool busy() const { return (bool)_waiter; }
+
+		friend class SigfoxLoop;
+		friend class SigfoxAwait;
+};
+
+
+
+/*! @class SigfoxLoop
+ * Single thread event loop: waits with epoll for serial data or the nearest
+ * command timeout and resumes the tasks whose command ended.
+ */
+class SigfoxLoop
+{
+	private:
+		int _epoll;
+		SigfoxCoModule* _modules;
+
+		void add(SigfoxCoModule* module);
+		void remove(SigfoxCoModule* module);
+		void watch(SigfoxCoModule* module);
+		void poll(SigfoxCoModule* module);
+
+	public:
+		SigfoxLoop();
+		~SigfoxLoop();
+
+		bool busy() const;
+		int runOnce(int timeout);
+		void run();
+
+		friend class SigfoxCoModule;
+};
+
+
+#endif
@@ -0,0 +1,236 @@
+/*! 
+ * @file 	SigfoxDecoder.cpp
+ * @author	Sean van der Walt / Walt Technologies Pty Ltd
+ * @version	0.1
+ * @brief 	Host side batch decoder for uplink payloads described with the 
+ * 			SigfoxFieldLayout tables of SigfoxFrame.h
+ *
+ *  Copyright (C) 2017 Walt Technologies Pty Ltd
+ *  https://walt-tech.com.au
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *    
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *   
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *	
+ */
+
+#include <thread>
+#include "SigfoxDecoder.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+
+/*!
+ * @brief	This function converts one hex digit
+ * @param	char c: hex digit
+ * @return	nibble value, or 0xFF if not a hex digit
+ */
+static inline uint8_t hexNibble(char c)
+{
+	if ((c >= '0') && (c <= '9'))		return c - '0';
+	c |= 0x20;
+	if ((c >= 'a') && (c <= 'f'))		return c - 'a' + 10;
+	return 0xFF;
+}
+
+
+
+
+/*!
+ * @brief	This function converts a hex string to binary. Blocks of 16 
+ * 			digits are converted with SSE2 when available.
+ * @param	const char* hex: hex digits
+ * @param	size_t length: number of digits (even)
+ * @param	uint8_t* data: output buffer (length/2 bytes)
+ * @return	'true' if all digits were valid
+ */
+bool sigfoxHexToBinary(const char* hex, size_t length, uint8_t* data)
+{
+	size_t i = 0;
+	
+	if (length & 0x01)
+	{
+		return false;
+	}
+	
+#if defined(__SSE2__)
+	const __m128i ascii0 = _mm_set1_epi8('0' - 1);
+	const __m128i ascii9 = _mm_set1_epi8('9' + 1);
+	const __m128i asciia = _mm_set1_epi8('a' - 1);
+	const __m128i asciif = _mm_set1_epi8('f' + 1);
+	const __m128i lower = _mm_set1_epi8(0x20);
+	const __m128i low = _mm_set1_epi16(0x00FF);
+	
+	for (; i + 16 <= length; i += 16)
+	{
+		__m128i c = _mm_loadu_si128((const __m128i*)(hex + i));
+		__m128i l = _mm_or_si128(c, lower);
+		
+		// classify digits and letters
+		__m128i digit = _mm_and_si128(_mm_cmpgt_epi8(c, ascii0), _mm_cmplt_epi8(c, ascii9));
+		__m128i letter = _mm_and_si128(_mm_cmpgt_epi8(l, asciia), _mm_cmplt_epi8(l, asciif));
+		
+		if (_mm_movemask_epi8(_mm_or_si128(digit, letter)) != 0xFFFF)
+		{
+			return false;
+		}
+		
+		// nibble values
+		__m128i nibble = _mm_or_si128(
+			_mm_and_si128(digit, _mm_sub_epi8(c, _mm_set1_epi8('0'))),
+			_mm_andnot_si128(digit, _mm_sub_epi8(l, _mm_set1_epi8('a' - 10))));
+		
+		// join pairs: (first << 4) | second in every 16-bit lane
+		__m128i pair = _mm_or_si128(
+			_mm_slli_epi16(_mm_and_si128(nibble, low), 4),
+			_mm_srli_epi16(nibble, 8));
+		
+		_mm_storel_epi64((__m128i*)(data + i/2), _mm_packus_epi16(pair, pair));
+	}
+#endif
+	
+	for (; i < length; i += 2)
+	{
+		uint8_t high = hexNibble(hex[i]);
+		uint8_t low = hexNibble(hex[i + 1]);
+		
+		if ((high | low) & 0xF0)
+		{
+			return false;
+		}
+		data[i/2] = (high << 4) | low;
+	}
+	
+	return true;
+}
+
+
+
+
+/*!
+ * @brief	class constructor
+ * @param	const SigfoxFieldLayout* layout: field table shared with the firmware
+ * @param	uint8_t count: number of fields in the table
+ */
+SigfoxDecoder::SigfoxDecoder(const SigfoxFieldLayout* layout, uint8_t count)
+	: _layout(layout), _count(count), _length(0)
+{
+	for (uint8_t i = 0; i < count; i++)
+	{
+		uint8_t end = (layout[i].offset + layout[i].bits + 7) / 8;
+		if (end > _length) _length = end;
+	}
+}
+
+
+
+
+/*!
+ * @brief	This function decodes a range of the batch
+ * @param	const std::vector<std::string>& payloads: hex payloads
+ * @param	SigfoxColumns& columns: output columns (already sized)
+ * @param	size_t first: first payload of the range
+ * @param	size_t last: end of the range (excluded)
+ * @param	size_t* decoded: number of payloads decoded
+ * @return	void
+ */
+void SigfoxDecoder::decodeRange(	const std::vector<std::string>& payloads, 
+									SigfoxColumns& columns, 
+									size_t first, 
+									size_t last, 
+									size_t* decoded) const
+{
+	uint8_t frame[SIGFOX_MAX_PAYLOAD];
+	size_t count = 0;
+	
+	for (size_t i = first; i < last; i++)
+	{
+		const std::string& hex = payloads[i];
+		
+		if ((hex.size() > 2*SIGFOX_MAX_PAYLOAD) 
+			|| (hex.size() < 2*(size_t)_length)
+			|| !sigfoxHexToBinary(hex.data(), hex.size(), frame))
+		{
+			columns.valid[i] = 0;
+			continue;
+		}
+		
+		for (uint8_t f = 0; f < _count; f++)
+		{
+			columns.fields[f][i] = sigfoxUnpackField(frame, &_layout[f]);
+		}
+		columns.valid[i] = 1;
+		count++;
+	}
+	
+	*decoded = count;
+}
+
+
+
+
+/*!
+ * @brief	This function decodes a batch of hex payloads
+ * @param	const std::vector<std::string>& payloads: hex payloads
+ * @param	SigfoxColumns& columns: decoded fields, one column per field
+ * @param	unsigned threads: number of threads. '0' uses all cores
+ * @return	number of payloads decoded
+ */
+size_t SigfoxDecoder::decode(	const std::vector<std::string>& payloads, 
+								SigfoxColumns& columns, 
+								unsigned threads) const
+{
+	size_t total = payloads.size();
+	size_t decoded = 0;
+	
+	columns.valid.resize(total);
+	columns.fields.resize(_count);
+	for (uint8_t f = 0; f < _count; f++)
+	{
+		columns.fields[f].resize(total);
+	}
+	
+	if (threads == 0)
+	{
+		threads = std::thread::hardware_concurrency();
+	}
+	if ((threads <= 1) || (total < 4096))
+	{
+		decodeRange(payloads, columns, 0, total, &decoded);
+		return decoded;
+	}
+	
+	// one contiguous range per thread
+	std::vector<std::thread> workers;
+	std::vector<size_t> counts(threads, 0);
+	size_t chunk = (total + threads - 1) / threads;
+	
+	for (unsigned t = 0; t < threads; t++)
+	{
+		size_t first = t * chunk;
+		size_t last = (first + chunk < total) ? first + chunk : total;
+		
+		if (first >= last) break;
+		workers.push_back(std::thread(&SigfoxDecoder::decodeRange, this, 
+			std::cref(payloads), std::ref(columns), first, last, &counts[t]));
+	}
+	
+	for (size_t t = 0; t < workers.size(); t++)
+	{
+		workers[t].join();
+		decoded += counts[t];
+	}
+	
+	return decoded;
+}
@@ -0,0 +1,88 @@
+/*! 
+ * @file 	SigfoxDecoder.h
+ * @author	Sean van der Walt / Walt Technologies Pty Ltd
+ * @version	0.1
+ * @brief 	Host side batch decoder for uplink payloads described with the 
+ * 			SigfoxFieldLayout tables of SigfoxFrame.h
+ *
+ *  Copyright (C) 2017 Walt Technologies Pty Ltd
+ *  https://walt-tech.com.au
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *    
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *   
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *	
+ */
+ 
+#ifndef SigfoxDecoder_h
+#define SigfoxDecoder_h
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+
+#include <stddef.h>
+#include <inttypes.h>
+#include <string>
+#include <vector>
+#include "../../SigfoxFrame.h"
+
+
+/******************************************************************************
+ * Definitions & Declarations
+ *****************************************************************************/
+
+/*! @struct SigfoxColumns
+ * Decoded batch in struct-of-arrays layout: one column per layout field, 
+ * indexed by the position of the payload in the batch
+ */
+struct SigfoxColumns
+{
+	std::vector<uint8_t> valid;					// '1' if the payload was decoded
+	std::vector< std::vector<int32_t> > fields;	// fields[field][payload]
+};
+
+bool sigfoxHexToBinary(const char* hex, size_t length, uint8_t* data);
+
+
+/******************************************************************************
+ * Class
+ *****************************************************************************/
+
+/*! @class SigfoxDecoder
+ * Decodes batches of hex payloads with the same layout table the firmware 
+ * uses to pack them. Batches are split across threads.
+ */
+class SigfoxDecoder
+{
+	private:
+		const SigfoxFieldLayout* _layout;
+		uint8_t _count;
+		uint8_t _length;		// minimum payload length (in bytes)
+		
+		void decodeRange(	const std::vector<std::string>& payloads, 
+							SigfoxColumns& columns, 
+							size_t first, 
+							size_t last, 
+							size_t* decoded) const;
+		
+	public:
+		//! class constructor
+		SigfoxDecoder(const SigfoxFieldLayout* layout, uint8_t count);
+		
+		size_t decode(	const std::vector<std::string>& payloads, 
+						SigfoxColumns& columns, 
+						unsigned threads = 0) const;
+};
+
+
+#endif
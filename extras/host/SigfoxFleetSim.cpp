@@ -0,0 +1,388 @@
+/*! 
+ * @file 	SigfoxFleetSim.cpp
+ * @author	Sean van der Walt / Walt Technologies Pty Ltd
+ * @version	0.1
+ * @brief 	Fleet simulator: runs LYNXBeeSigfox against simulated modules in 
+ * 			virtual time to evaluate sampling and uplink policies.
+ *
+ *  Copyright (C) 2017 Walt Technologies Pty Ltd
+ *  https://walt-tech.com.au
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *    
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *   
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *	
+ */
+
+#include <string.h>
+#include <mutex>
+#include "../../LYNXBeeSigfox.h"
+#include "SigfoxFleetSim.h"
+#include "SigfoxWorkPool.h"
+
+#define DAY_MS		86400000ULL
+
+
+/*!
+ * @brief	default fleet: 1000 devices for a year, 14 dBm class radio
+ */
+SigfoxFleetConfig::SigfoxFleetConfig()
+	: devices(1000), days(365), threads(0), shard(16), seed(1),
+	  uplinkTime(6000), downlinkTime(25000), voltage(3.3f), 
+	  sleepCurrent(0.005f), txCurrent(45.0f), rxCurrent(12.0f),
+	  uplinkQuota(140), downlinkQuota(4)
+{
+}
+
+
+
+
+/*!
+ * @brief	class constructor
+ */
+SigfoxFleetStats::SigfoxFleetStats()
+{
+	memset(this, 0, sizeof(*this));
+}
+
+
+
+
+/*!
+ * @brief	This function adds a latency to the histogram
+ * @param	uint64_t ms: latency
+ * @return	void
+ */
+void SigfoxFleetStats::addLatency(uint64_t ms)
+{
+	size_t bucket;
+	
+	if (ms < 16)
+	{
+		bucket = ms;
+	}
+	else
+	{
+		unsigned exponent = 63 - __builtin_clzll(ms);
+		bucket = 16 + (exponent - 4) * 8 + ((ms >> (exponent - 3)) & 7);
+		if (bucket >= SIGFOX_LATENCY_BUCKETS)
+		{
+			bucket = SIGFOX_LATENCY_BUCKETS - 1;
+		}
+	}
+	
+	latency[bucket]++;
+	if (ms > latencyMax)
+	{
+		latencyMax = ms;
+	}
+}
+
+
+
+
+/*!
+ * @brief	This function adds the results of another shard
+ * @param	const SigfoxFleetStats& other: results
+ * @return	void
+ */
+void SigfoxFleetStats::merge(const SigfoxFleetStats& other)
+{
+	samples += other.samples;
+	uplinks += other.uplinks;
+	downlinks += other.downlinks;
+	skipped += other.skipped;
+	failed += other.failed;
+	deviceDays += other.deviceDays;
+	uplinkViolations += other.uplinkViolations;
+	downlinkViolations += other.downlinkViolations;
+	overQuota += other.overQuota;
+	energy += other.energy;
+	
+	for (size_t i = 0; i < SIGFOX_LATENCY_BUCKETS; i++)
+	{
+		latency[i] += other.latency[i];
+	}
+	if (other.latencyMax > latencyMax)
+	{
+		latencyMax = other.latencyMax;
+	}
+}
+
+
+
+
+/*!
+ * @brief	This function returns a latency percentile (within 1/8 of the value)
+ * @param	double p: percentile, 0 to 100
+ * @return	latency (ms), upper bound of its bucket
+ */
+uint64_t SigfoxFleetStats::percentile(double p) const
+{
+	uint64_t total = 0;
+	uint64_t count = 0;
+	
+	for (size_t i = 0; i < SIGFOX_LATENCY_BUCKETS; i++)
+	{
+		total += latency[i];
+	}
+	if (total == 0)
+	{
+		return 0;
+	}
+	
+	for (size_t i = 0; i < SIGFOX_LATENCY_BUCKETS; i++)
+	{
+		count += latency[i];
+		if ((count * 100.0) >= (p * total))
+		{
+			if (i < 16)
+			{
+				return i;
+			}
+			
+			unsigned exponent = (i - 16) / 8 + 4;
+			uint64_t upper = (1ULL << exponent) + ((uint64_t)((i - 16) % 8 + 1) << (exponent - 3)) - 1;
+			return (upper < latencyMax) ? upper : latencyMax;
+		}
+	}
+	
+	return latencyMax;
+}
+
+
+
+
+/*!
+ * @brief	This function runs the current command of a driver, moving the 
+ * 			virtual clock to each answer of the module or timeout
+ * @param	LYNXBeeSigfox& driver: driver
+ * @param	unsigned long& clock: virtual clock
+ * @return	answer of the command
+ */
+static uint8_t runCommand(LYNXBeeSigfox& driver, unsigned long& clock)
+{
+	SigfoxSimModule* module = driver.module();
+	uint8_t answer;
+	
+	while ((answer = driver.pollAT()) == SIGFOX_ANSWER_PENDING)
+	{
+		unsigned long wait = driver.timeLeftAT();
+		
+		if (module->pending())
+		{
+			int32_t due = (int32_t)(module->nextDue() - (uint32_t)clock);
+			if (due < 0)						due = 0;
+			if ((unsigned long)due < wait)		wait = due;
+		}
+		
+		clock += wait;
+	}
+	
+	return answer;
+}
+
+
+
+
+/*!
+ * @brief	This function returns a pseudo random number (splitmix64)
+ * @param	uint64_t& state: generator state
+ * @return	random number
+ */
+static uint32_t nextRandom(uint64_t& state)
+{
+	uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+	
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	
+	return (uint32_t)((z ^ (z >> 31)) >> 32);
+}
+
+
+
+
+/*!
+ * @brief	This function closes a device day and checks the quotas
+ * @param	const SigfoxFleetConfig& config: quotas
+ * @param	const SigfoxFleetUsage& usage: messages of the day
+ * @param	SigfoxFleetStats& stats: results
+ * @return	void
+ */
+static void closeDay(const SigfoxFleetConfig& config, const SigfoxFleetUsage& usage, SigfoxFleetStats& stats)
+{
+	if (usage.uplinks > config.uplinkQuota)
+	{
+		stats.uplinkViolations++;
+		stats.overQuota += usage.uplinks - config.uplinkQuota;
+	}
+	if (usage.downlinks > config.downlinkQuota)
+	{
+		stats.downlinkViolations++;
+	}
+}
+
+
+
+
+/*!
+ * @brief	This function simulates one device over the whole period
+ * @param	uint32_t index: device index
+ * @param	SigfoxFleetStats& stats: results of the shard
+ * @return	void
+ */
+void SigfoxFleetSim::device(uint32_t index, SigfoxFleetStats& stats)
+{
+	unsigned long clock = 0;
+	uint64_t random = ((uint64_t)_config.seed << 32) ^ index;
+	uint64_t end = _config.days * DAY_MS;
+	uint64_t next;
+	uint64_t day = 0;
+	uint64_t uplinks = 0;
+	uint64_t downlinks = 0;
+	uint32_t sample = 0;
+	SigfoxFleetUsage usage = { 0, 0 };
+	SigfoxSimModule module(0x00100000 + index);
+	LYNXBeeSigfox driver;
+	
+	module._echo = false;
+	module._uplinkTime = _config.uplinkTime;
+	module._downlinkTime = _config.downlinkTime;
+	driver.attach(&module);
+	setVirtualClock(&clock);
+	
+	// power on, then start sampling at a random phase
+	driver.beginON(SOCKET0);
+	if (runCommand(driver, clock) != SIGFOX_ANSWER_OK)
+	{
+		stats.failed++;
+	}
+	next = clock + nextRandom(random) % _policy.period(index, 0);
+	
+	while (next < end)
+	{
+		// sleep until the sample is due
+		if (clock < next)
+		{
+			clock = next;
+		}
+		
+		if ((next / DAY_MS) != day)
+		{
+			closeDay(_config, usage, stats);
+			day = next / DAY_MS;
+			usage.uplinks = 0;
+			usage.downlinks = 0;
+		}
+		
+		stats.samples++;
+		uint8_t action = _policy.action(index, sample, usage, nextRandom(random));
+		
+		if (action == SIGFOX_FLEET_SKIP)
+		{
+			stats.skipped++;
+		}
+		else
+		{
+			uint8_t frame[SIGFOX_MAX_PAYLOAD];
+			uint8_t answer;
+			
+			memset(frame, 0, sizeof(frame));
+			memcpy(frame, &sample, sizeof(sample));
+			
+			if (action == SIGFOX_FLEET_UPLINK_ACK)
+			{
+				answer = driver.beginSendACK(frame, sizeof(frame));
+			}
+			else
+			{
+				answer = driver.beginSend(frame, sizeof(frame));
+			}
+			if (answer == SIGFOX_ANSWER_PENDING)
+			{
+				answer = runCommand(driver, clock);
+			}
+			
+			// usage counts what the radio did, whatever the answer
+			usage.uplinks += module._uplinks - uplinks;
+			usage.downlinks += module._downlinks - downlinks;
+			uplinks = module._uplinks;
+			downlinks = module._downlinks;
+			
+			if (answer == SIGFOX_ANSWER_OK)
+			{
+				stats.addLatency(clock - next);
+			}
+			else
+			{
+				stats.failed++;
+			}
+		}
+		
+		sample++;
+		next += _policy.period(index, sample);
+	}
+	closeDay(_config, usage, stats);
+	
+	setVirtualClock(NULL);
+	
+	// energy: sleep all along, radio current on top while on air
+	double hours = end / 3600000.0;
+	double tx = module._uplinks * (_config.uplinkTime / 3600000.0);
+	double rx = module._downlinks * (_config.downlinkTime / 3600000.0);
+	
+	stats.deviceDays += _config.days;
+	stats.uplinks += module._uplinks;
+	stats.downlinks += module._downlinks;
+	stats.energy += _config.voltage * (	_config.sleepCurrent * hours + 
+										(_config.txCurrent - _config.sleepCurrent) * tx +
+										(_config.rxCurrent - _config.sleepCurrent) * rx);
+}
+
+
+
+
+/*!
+ * @brief	This function simulates the fleet
+ * @param	SigfoxFleetStats& stats: results
+ * @return	void
+ */
+void SigfoxFleetSim::run(SigfoxFleetStats& stats)
+{
+	SigfoxWorkPool pool(_config.threads);
+	std::mutex lock;
+	uint32_t shard = (_config.shard > 0) ? _config.shard : 1;
+	size_t shards = (_config.devices + shard - 1) / shard;
+	
+	pool.run(shards, [&](size_t task, unsigned worker)
+	{
+		SigfoxFleetStats results;
+		uint32_t first = task * shard;
+		uint32_t last = first + shard;
+		(void)worker;
+		
+		if (last > _config.devices)
+		{
+			last = _config.devices;
+		}
+		for (uint32_t i = first; i < last; i++)
+		{
+			device(i, results);
+		}
+		
+		std::lock_guard<std::mutex> guard(lock);
+		stats.merge(results);
+	});
+	
+	_steals = pool._steals;
+}
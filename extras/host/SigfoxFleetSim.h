@@ -0,0 +1,162 @@
+/*! 
+ * @file 	SigfoxFleetSim.h
+ * @author	Sean van der Walt / Walt Technologies Pty Ltd
+ * @version	0.1
+ * @brief 	Fleet simulator: runs LYNXBeeSigfox against simulated modules in 
+ * 			virtual time to evaluate sampling and uplink policies. Build the
+ * 			library with 
+ * 			-DSIGFOX_TRANSPORT_HEADER='"extras/host/SigfoxSimUART.h"'
+ *
+ *  Copyright (C) 2017 Walt Technologies Pty Ltd
+ *  https://walt-tech.com.au
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *    
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *   
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *	
+ */
+ 
+#ifndef SigfoxFleetSim_h
+#define SigfoxFleetSim_h
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+
+#include <stddef.h>
+#include <inttypes.h>
+
+
+/******************************************************************************
+ * Definitions & Declarations
+ *****************************************************************************/
+
+//! Latency histogram size: exact below 16 ms, then 8 buckets per power of two
+#define SIGFOX_LATENCY_BUCKETS	(16 + 8 * 40)
+
+/*! @enum SigfoxFleetActions
+ * What a device does with a sample
+ */
+enum SigfoxFleetActions
+{
+	SIGFOX_FLEET_SKIP = 0,
+	SIGFOX_FLEET_UPLINK = 1,
+	SIGFOX_FLEET_UPLINK_ACK = 2,	// uplink requesting a downlink
+};
+
+/*! @struct SigfoxFleetUsage
+ * Messages of a device during the current day
+ */
+struct SigfoxFleetUsage
+{
+	uint16_t uplinks;
+	uint16_t downlinks;
+};
+
+/*! @struct SigfoxFleetConfig
+ * Fleet and energy model. Currents in mA, times in ms.
+ */
+struct SigfoxFleetConfig
+{
+	uint32_t devices;
+	uint32_t days;
+	unsigned threads;				// '0' for one per CPU
+	uint32_t shard;					// devices per pool task
+	uint32_t seed;
+	
+	uint32_t uplinkTime;			// AT$SF until "OK"
+	uint32_t downlinkTime;			// "OK" until the downlink
+	float voltage;
+	float sleepCurrent;
+	float txCurrent;
+	float rxCurrent;
+	
+	uint16_t uplinkQuota;			// per device and day
+	uint16_t downlinkQuota;
+	
+	SigfoxFleetConfig();
+};
+
+/*! @struct SigfoxFleetStats
+ * Results, per shard and then for the fleet
+ */
+struct SigfoxFleetStats
+{
+	uint64_t samples;
+	uint64_t uplinks;				// transmitted (AT$SF sent)
+	uint64_t downlinks;				// received
+	uint64_t skipped;				// samples not sent
+	uint64_t failed;				// commands not answered "OK"
+	uint64_t deviceDays;
+	uint64_t uplinkViolations;		// device days over the uplink quota
+	uint64_t downlinkViolations;	// device days over the downlink quota
+	uint64_t overQuota;				// uplinks beyond the quota
+	double energy;					// mWh, all devices
+	uint64_t latency[SIGFOX_LATENCY_BUCKETS];	// sample to end of the command, in ms
+	uint64_t latencyMax;
+	
+	SigfoxFleetStats();
+	void addLatency(uint64_t ms);
+	void merge(const SigfoxFleetStats& other);
+	uint64_t percentile(double p) const;
+};
+
+
+/******************************************************************************
+ * Class
+ *****************************************************************************/
+
+/*! @class SigfoxFleetPolicy
+ * Policy under evaluation. Called concurrently from the pool threads, so
+ * keep per device state out of it or index it by device.
+ */
+class SigfoxFleetPolicy
+{
+	public:
+		virtual ~SigfoxFleetPolicy() {}
+		
+		//! time until the next sample of a device (ms)
+		virtual uint32_t period(uint32_t device, uint32_t sample) = 0;
+		
+		//! action for a sample (see SigfoxFleetActions)
+		virtual uint8_t action(	uint32_t device, 
+								uint32_t sample, 
+								const SigfoxFleetUsage& today,
+								uint32_t random) = 0;
+};
+
+
+
+/*! @class SigfoxFleetSim
+ * Every device runs its own driver and simulated module on a virtual clock,
+ * jumping from event to event. Devices are independent, so shards of them 
+ * run in parallel on a SigfoxWorkPool.
+ */
+class SigfoxFleetSim
+{
+	private:
+		const SigfoxFleetConfig& _config;
+		SigfoxFleetPolicy& _policy;
+		
+		void device(uint32_t index, SigfoxFleetStats& stats);
+		
+	public:
+		size_t _steals;					/*!< Shards stolen by other threads	*/
+		
+		SigfoxFleetSim(const SigfoxFleetConfig& config, SigfoxFleetPolicy& policy)
+			: _config(config), _policy(policy), _steals(0) {}
+		
+		void run(SigfoxFleetStats& stats);
+};
+
+
+#endif
@@ -0,0 +1,413 @@
+/*! 
+ * @file 	SigfoxGateway.cpp
+ * @author	Sean van der Walt / Walt Technologies Pty Ltd
+ * @version	0.1
+ * @brief 	Linux gateway driving many LYNX-Bee modules from one thread. The
+ * 			serial ports are multiplexed with epoll and every module runs the
+ * 			non-blocking command layer of LYNXBeeSigfox.
+ *
+ *  Copyright (C) 2017 Walt Technologies Pty Ltd
+ *  https://walt-tech.com.au
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *    
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *   
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *	
+ */
+
+#include <string.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include "SigfoxGateway.h"
+
+#define SIGFOX_GATEWAY_EVENTS	64
+
+
+/*!
+ * @brief	class constructor
+ */
+SigfoxGateway::SigfoxGateway()
+	: _queued(0), _completed(0), _failed(0)
+{
+	_epoll = epoll_create1(EPOLL_CLOEXEC);
+}
+
+
+
+
+/*!
+ * @brief	class destructor. Closes the serial ports.
+ */
+SigfoxGateway::~SigfoxGateway()
+{
+	for (size_t i = 0; i < _modules.size(); i++)
+	{
+		_modules[i]->driver.closeUART();
+		delete _modules[i];
+	}
+
+	if (_epoll >= 0)
+	{
+		close(_epoll);
+	}
+}
+
+
+
+
+/*!
+ * @brief	This function adds a module and queues its power on
+ * @param	const char* device: serial port, i.e. "/dev/ttyUSB0"
+ * @param	SigfoxGatewayCallback ready: called when the module answered
+ * @return	module index
+ */
+int SigfoxGateway::addModule(const char* device, SigfoxGatewayCallback ready)
+{
+	Module* module = new Module();
+	int index = (int)_modules.size();
+
+	module->device = device;
+	module->busy = false;
+	module->watched = false;
+	module->driver.setDevice(module->device.c_str());
+	_modules.push_back(module);
+
+	queue(index, SIGFOX_JOB_ON, 0, NULL, 0, ready);
+
+	return index;
+}
+
+
+
+
+/*!
+ * @brief	This function queues a command on a module
+ * @param	int index: module index
+ * @param	uint8_t type: command (see SigfoxJobTypes)
+ * @param	uint32_t value: power, frequency or period
+ * @param	const uint8_t* data: payload to send
+ * @param	uint16_t length: payload length (truncated to 12)
+ * @param	SigfoxGatewayCallback done: completion callback
+ * @return	void
+ */
+void SigfoxGateway::queue(	int index,
+							uint8_t type,
+							uint32_t value,
+							const uint8_t* data,
+							uint16_t length,
+							SigfoxGatewayCallback done)
+{
+	Module* module = _modules[index];
+	Job job;
+
+	if (length > SIGFOX_MAX_PAYLOAD)
+	{
+		length = SIGFOX_MAX_PAYLOAD;
+	}
+
+	job.type = type;
+	job.value = value;
+	job.length = length;
+	if (length > 0)
+	{
+		memcpy(job.data, data, length);
+	}
+	job.done = done;
+
+	module->jobs.push_back(job);
+	_queued++;
+
+	start(index);
+}
+
+
+
+
+/*!
+ * @brief	This function starts the next queued commands of an idle module
+ * 			until one of them is pending
+ * @param	int index: module index
+ * @return	void
+ */
+void SigfoxGateway::start(int index)
+{
+	Module* module = _modules[index];
+	LYNXBeeSigfox& driver = module->driver;
+
+	while (!module->busy && !module->jobs.empty())
+	{
+		Job& job = module->jobs.front();
+		uint8_t answer = SIGFOX_ANSWER_ERROR;
+
+		switch (job.type)
+		{
+			case SIGFOX_JOB_ON:
+				answer = driver.beginON(SOCKET0);
+				if (driver._fd < 0)
+				{
+					answer = SIGFOX_ANSWER_ERROR;
+				}
+				else if (!module->watched)
+				{
+					struct epoll_event event;
+					event.events = EPOLLIN;
+					event.data.u32 = index;
+					module->watched = (epoll_ctl(_epoll, EPOLL_CTL_ADD, driver._fd, &event) == 0);
+				}
+				break;
+
+			case SIGFOX_JOB_CHECK:			answer = driver.beginCheck();						break;
+			case SIGFOX_JOB_GET_ID:			answer = driver.beginGetID();						break;
+			case SIGFOX_JOB_SEND:			answer = driver.beginSend(job.data, job.length);	break;
+			case SIGFOX_JOB_SEND_ACK:		answer = driver.beginSendACK(job.data, job.length);	break;
+			case SIGFOX_JOB_SET_POWER:		answer = driver.beginSetPower(job.value);			break;
+			case SIGFOX_JOB_SET_FREQUENCY:	answer = driver.beginSetFrequency(job.value);		break;
+			case SIGFOX_JOB_KEEP_ALIVE:		answer = driver.beginSendKeepAlive(job.value);		break;
+			default:																			break;
+		}
+
+		if (answer == SIGFOX_ANSWER_PENDING)
+		{
+			module->busy = true;
+		}
+		else
+		{
+			finish(index, answer);
+		}
+	}
+}
+
+
+
+
+/*!
+ * @brief	This function ends the current command of a module and calls its
+ * 			callback
+ * @param	int index: module index
+ * @param	uint8_t answer: result of the command
+ * @return	void
+ */
+void SigfoxGateway::finish(int index, uint8_t answer)
+{
+	Module* module = _modules[index];
+	SigfoxGatewayCallback done = module->jobs.front().done;
+
+	module->jobs.pop_front();
+	module->busy = false;
+	_queued--;
+	_completed++;
+	if (answer != SIGFOX_ANSWER_OK)
+	{
+		_failed++;
+	}
+
+	// the callback may queue the next command
+	if (done)
+	{
+		done(index, answer);
+	}
+}
+
+
+
+
+/*!
+ * @brief	This function runs the current command of a module. Idle modules
+ * 			only read their port so unsolicited lines do not pile up.
+ * @param	int index: module index
+ * @return	void
+ */
+void SigfoxGateway::poll(int index)
+{
+	Module* module = _modules[index];
+
+	if (!module->busy)
+	{
+		module->driver.serviceRX();
+		return;
+	}
+
+	uint8_t answer = module->driver.pollAT();
+	if (answer != SIGFOX_ANSWER_PENDING)
+	{
+		finish(index, answer);
+		start(index);
+	}
+}
+
+
+
+
+/*!
+ * @brief	This function queues a communication check
+ * @param	int index: module index
+ * @param	SigfoxGatewayCallback done: completion callback
+ * @return	void
+ */
+void SigfoxGateway::check(int index, SigfoxGatewayCallback done)
+{
+	queue(index, SIGFOX_JOB_CHECK, 0, NULL, 0, done);
+}
+
+
+
+
+/*!
+ * @brief	This function queues reading the module id into '_id'
+ * @param	int index: module index
+ * @param	SigfoxGatewayCallback done: completion callback
+ * @return	void
+ */
+void SigfoxGateway::getID(int index, SigfoxGatewayCallback done)
+{
+	queue(index, SIGFOX_JOB_GET_ID, 0, NULL, 0, done);
+}
+
+
+
+
+/*!
+ * @brief	This function queues a Sigfox packet. The data is copied.
+ * @param	int index: module index
+ * @param	const uint8_t* data: payload
+ * @param	uint16_t length: payload length (truncated to 12)
+ * @param	SigfoxGatewayCallback done: completion callback
+ * @return	void
+ */
+void SigfoxGateway::send(int index, const uint8_t* data, uint16_t length, SigfoxGatewayCallback done)
+{
+	queue(index, SIGFOX_JOB_SEND, 0, data, length, done);
+}
+
+
+
+
+/*!
+ * @brief	This function queues a Sigfox packet requesting a downlink. The
+ * 			downlink is in '_downlink' when the callback is called.
+ * @param	int index: module index
+ * @param	const uint8_t* data: payload
+ * @param	uint16_t length: payload length (truncated to 12)
+ * @param	SigfoxGatewayCallback done: completion callback
+ * @return	void
+ */
+void SigfoxGateway::sendACK(int index, const uint8_t* data, uint16_t length, SigfoxGatewayCallback done)
+{
+	queue(index, SIGFOX_JOB_SEND_ACK, 0, data, length, done);
+}
+
+
+
+
+/*!
+ * @brief	This function queues setting and saving the RF power
+ * @param	int index: module index
+ * @param	uint8_t power: power level in dBm
+ * @param	SigfoxGatewayCallback done: completion callback
+ * @return	void
+ */
+void SigfoxGateway::setPower(int index, uint8_t power, SigfoxGatewayCallback done)
+{
+	queue(index, SIGFOX_JOB_SET_POWER, power, NULL, 0, done);
+}
+
+
+
+
+/*!
+ * @brief	This function queues setting and saving the frequency
+ * @param	int index: module index
+ * @param	uint32_t freq: frequency in Hz
+ * @param	SigfoxGatewayCallback done: completion callback
+ * @return	void
+ */
+void SigfoxGateway::setFrequency(int index, uint32_t freq, SigfoxGatewayCallback done)
+{
+	queue(index, SIGFOX_JOB_SET_FREQUENCY, freq, NULL, 0, done);
+}
+
+
+
+
+/*!
+ * @brief	This function queues setting the keep-alive period
+ * @param	int index: module index
+ * @param	uint8_t period: hours between keep-alive messages
+ * @param	SigfoxGatewayCallback done: completion callback
+ * @return	void
+ */
+void SigfoxGateway::sendKeepAlive(int index, uint8_t period, SigfoxGatewayCallback done)
+{
+	queue(index, SIGFOX_JOB_KEEP_ALIVE, period, NULL, 0, done);
+}
+
+
+
+
+/*!
+ * @brief	This function waits for serial data or the nearest command timeout
+ * 			and runs the modules concerned
+ * @param	int timeout: maximum time to wait (in ms), -1 for no limit
+ * @return	number of commands completed
+ */
+int SigfoxGateway::run(int timeout)
+{
+	struct epoll_event events[SIGFOX_GATEWAY_EVENTS];
+	uint32_t completed = _completed;
+	int count;
+
+	// do not sleep past the nearest command deadline
+	for (size_t i = 0; i < _modules.size(); i++)
+	{
+		if (_modules[i]->busy)
+		{
+			int left = (int)_modules[i]->driver.timeLeftAT();
+			if ((timeout < 0) || (left < timeout))
+			{
+				timeout = left;
+			}
+		}
+	}
+
+	count = epoll_wait(_epoll, events, SIGFOX_GATEWAY_EVENTS, timeout);
+
+	for (int i = 0; i < count; i++)
+	{
+		poll(events[i].data.u32);
+	}
+
+	// commands which timed out
+	for (size_t i = 0; i < _modules.size(); i++)
+	{
+		if (_modules[i]->busy && (_modules[i]->driver.timeLeftAT() == 0))
+		{
+			poll(i);
+		}
+	}
+
+	return _completed - completed;
+}
+
+
+
+
+/*!
+ * @brief	This function runs the modules until every queued command ended
+ * @return	void
+ */
+void SigfoxGateway::runUntilIdle()
+{
+	while (_queued > 0)
+	{
+		run(-1);
+	}
+}
@@ -0,0 +1,134 @@
+/*! 
+ * @file 	SigfoxGateway.h
+ * @author	Sean van der Walt / Walt Technologies Pty Ltd
+ * @version	0.1
+ * @brief 	Linux gateway driving many LYNX-Bee modules from one thread. The
+ * 			serial ports are multiplexed with epoll and every module runs the
+ * 			non-blocking command layer of LYNXBeeSigfox.
+ * 			Build the library with
+ * 			-DSIGFOX_TRANSPORT_HEADER='"extras/host/SigfoxPosixUART.h"'
+ *
+ *  Copyright (C) 2017 Walt Technologies Pty Ltd
+ *  https://walt-tech.com.au
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *    
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *   
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *	
+ */
+
+#ifndef SigfoxGateway_h
+#define SigfoxGateway_h
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+#include "../../LYNXBeeSigfox.h"
+
+
+/******************************************************************************
+ * Definitions & Declarations
+ *****************************************************************************/
+
+/*! @enum SigfoxJobTypes
+ * Commands queued on a module
+ */
+enum SigfoxJobTypes
+{
+	SIGFOX_JOB_ON = 0,
+	SIGFOX_JOB_CHECK = 1,
+	SIGFOX_JOB_GET_ID = 2,
+	SIGFOX_JOB_SEND = 3,
+	SIGFOX_JOB_SEND_ACK = 4,
+	SIGFOX_JOB_SET_POWER = 5,
+	SIGFOX_JOB_SET_FREQUENCY = 6,
+	SIGFOX_JOB_KEEP_ALIVE = 7,
+};
+
+/*! Completion callback: module index and answer (see AnswersTypes). The
+ * module's '_id', '_downlink', ... are valid inside the callback.
+ */
+typedef std::function<void(int, uint8_t)> SigfoxGatewayCallback;
+
+
+/******************************************************************************
+ * Class
+ *****************************************************************************/
+
+/*! @class SigfoxGateway
+ * Owns one LYNXBeeSigfox per serial port and one epoll instance. Each module
+ * runs its queued commands one at a time; run() sleeps in epoll_wait() until
+ * a port has data or the nearest command timeout, so there is no thread per
+ * module and an idle gateway uses no CPU.
+ */
+class SigfoxGateway
+{
+	private:
+		struct Job
+		{
+			uint8_t type;
+			uint8_t length;
+			uint32_t value;
+			uint8_t data[SIGFOX_MAX_PAYLOAD];
+			SigfoxGatewayCallback done;
+		};
+
+		struct Module
+		{
+			LYNXBeeSigfox driver;
+			std::string device;
+			std::deque<Job> jobs;
+			bool busy;
+			bool watched;				// descriptor added to epoll
+		};
+
+		std::vector<Module*> _modules;
+		int _epoll;
+		size_t _queued;
+
+		void queue(int index, uint8_t type, uint32_t value,
+					const uint8_t* data, uint16_t length, SigfoxGatewayCallback done);
+		void start(int index);
+		void finish(int index, uint8_t answer);
+		void poll(int index);
+
+	public:
+		uint32_t _completed;			/*!< Commands completed			*/
+		uint32_t _failed;				/*!< Commands not answered OK	*/
+
+		SigfoxGateway();
+		~SigfoxGateway();
+
+		int addModule(const char* device, SigfoxGatewayCallback ready = NULL);
+		LYNXBeeSigfox& module(int index) { return _modules[index]->driver; }
+		size_t size() const { return _modules.size(); }
+		size_t pending() const { return _queued; }
+
+		void check(int index, SigfoxGatewayCallback done = NULL);
+		void getID(int index, SigfoxGatewayCallback done = NULL);
+		void send(int index, const uint8_t* data, uint16_t length, SigfoxGatewayCallback done = NULL);
+		void sendACK(int index, const uint8_t* data, uint16_t length, SigfoxGatewayCallback done = NULL);
+		void setPower(int index, uint8_t power, SigfoxGatewayCallback done = NULL);
+		void setFrequency(int index, uint32_t freq, SigfoxGatewayCallback done = NULL);
+		void sendKeepAlive(int index, uint8_t period, SigfoxGatewayCallback done = NULL);
+
+		int run(int timeout);
+		void runUntilIdle();
+};
+
+
+#endif
@@ -0,0 +1,141 @@
+/*! 
+ * @file 	SigfoxHostPort.cpp
+ * @author	Sean van der Walt / Walt Technologies Pty Ltd
+ * @version	0.1
+ * @brief 	Waspmote API subset used by LYNXBeeSigfox.cpp, for host (Linux)
+ * 			builds
+ *
+ *  Copyright (C) 2017 Walt Technologies Pty Ltd
+ *  https://walt-tech.com.au
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *    
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *   
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *	
+ */
+
+#include <time.h>
+#include "SigfoxHostPort.h"
+
+SigfoxHostUtils Utils;
+SigfoxHostPWR PWR;
+SigfoxHostUSB USB;
+
+// virtual time of this thread, NULL for real time
+static thread_local unsigned long* virtualClock = NULL;
+
+
+/*!
+ * @brief	This function makes millis() and delay() of the calling thread use
+ * 			a simulated clock. delay() advances it instead of sleeping.
+ * @param	unsigned long* clock: simulated time (in ms), NULL for real time
+ * @return	void
+ */
+void setVirtualClock(unsigned long* clock)
+{
+	virtualClock = clock;
+}
+
+
+
+
+/*!
+ * @brief	This function returns the milliseconds since the first call
+ * @return	milliseconds
+ */
+unsigned long millis()
+{
+	static struct timespec start = { 0, 0 };
+	struct timespec now;
+	
+	if (virtualClock)
+	{
+		return *virtualClock;
+	}
+	
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if ((start.tv_sec == 0) && (start.tv_nsec == 0))
+	{
+		start = now;
+	}
+	
+	return (now.tv_sec - start.tv_sec) * 1000UL + (now.tv_nsec - start.tv_nsec) / 1000000L;
+}
+
+
+
+
+/*!
+ * @brief	This function waits for some milliseconds
+ * @param	unsigned long ms: time to wait
+ * @return	void
+ */
+void delay(unsigned long ms)
+{
+	struct timespec wait;
+	
+	if (virtualClock)
+	{
+		*virtualClock += ms;
+		return;
+	}
+	
+	wait.tv_sec = ms / 1000;
+	wait.tv_nsec = (ms % 1000) * 1000000L;
+	
+	while (nanosleep(&wait, &wait) != 0);
+}
+
+
+
+
+/*!
+ * @brief	avr-libc number to string conversions
+ */
+char* ltoa(long value, char* str, int base)
+{
+	snprintf(str, 34, (base == HEX) ? "%lx" : "%ld", value);
+	return str;
+}
+
+char* itoa(int value, char* str, int base)
+{
+	return ltoa(value, str, base);
+}
+
+char* utoa(unsigned int value, char* str, int base)
+{
+	snprintf(str, 34, (base == HEX) ? "%x" : "%u", value);
+	return str;
+}
+
+
+
+
+/*!
+ * @brief	This function converts a binary buffer to a hex string
+ * @param	uint8_t* number: binary buffer
+ * @param	char* macDest: output string (2*length + 1 bytes)
+ * @param	uint8_t length: buffer length
+ * @return	void
+ */
+void SigfoxHostUtils::hex2str(uint8_t* number, char* macDest, uint8_t length)
+{
+	static const char digits[] = "0123456789ABCDEF";
+	
+	for (uint8_t i = 0; i < length; i++)
+	{
+		macDest[2*i] = digits[number[i] >> 4];
+		macDest[2*i + 1] = digits[number[i] & 0x0F];
+	}
+	macDest[2*length] = '\0';
+}
@@ -0,0 +1,122 @@
+/*! 
+ * @file 	SigfoxHostPort.h
+ * @author	Sean van der Walt / Walt Technologies Pty Ltd
+ * @version	0.1
+ * @brief 	Waspmote API subset used by LYNXBeeSigfox.cpp, for host (Linux)
+ * 			builds. Included by the host transport headers.
+ *
+ *  Copyright (C) 2017 Walt Technologies Pty Ltd
+ *  https://walt-tech.com.au
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *    
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *   
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *	
+ */
+ 
+#ifndef SigfoxHostPort_h
+#define SigfoxHostPort_h
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/******************************************************************************
+ * Definitions & Declarations
+ *****************************************************************************/
+
+#define SOCKET0		0
+#define SOCKET1		1
+#define HIGH		1
+#define LOW			0
+#define DEC			10
+#define HEX			16
+
+//! strings stay in RAM on the host
+#define F(str)		(str)
+
+unsigned long millis();
+void delay(unsigned long ms);
+void setVirtualClock(unsigned long* clock);
+
+char* itoa(int value, char* str, int base);
+char* utoa(unsigned int value, char* str, int base);
+char* ltoa(long value, char* str, int base);
+
+
+//! EEPROM size emulated by SigfoxHostUtils
+#define SIGFOX_HOST_EEPROM	4096
+
+/*! @class SigfoxHostUtils
+ * Waspmote 'Utils' subset. Socket multiplexers do not exist on the host. The
+ * EEPROM is kept in RAM: it survives OFF()/ON() but not the process. The host
+ * transports hold one of their own, so each driver (each simulated device of 
+ * a fleet or gateway) has its own EEPROM image.
+ */
+class SigfoxHostUtils
+{
+	private:
+		uint8_t _eeprom[SIGFOX_HOST_EEPROM];
+		
+	public:
+		SigfoxHostUtils() { memset(_eeprom, 0xFF, sizeof(_eeprom)); }
+		
+		void setMuxSocket0() {}
+		void setMuxSocket1() {}
+		void setMuxUSB() {}
+		void muxOFF1() {}
+		void hex2str(uint8_t* number, char* macDest, uint8_t length);
+		uint8_t readEEPROM(int address) { return _eeprom[address % SIGFOX_HOST_EEPROM]; }
+		int writeEEPROM(int address, uint8_t value) { _eeprom[address % SIGFOX_HOST_EEPROM] = value; return 0; }
+};
+
+
+/*! @class SigfoxHostPWR
+ * Waspmote 'PWR' subset. Module power is not switched by the host.
+ */
+class SigfoxHostPWR
+{
+	public:
+		void powerSocket(uint8_t socket, uint8_t state) { (void)socket; (void)state; }
+};
+
+
+/*! @class SigfoxHostUSB
+ * Waspmote 'USB' subset printing to stdout
+ */
+class SigfoxHostUSB
+{
+	public:
+		void print(const char* str) { fputs(str, stdout); }
+		void print(char c) { fputc(c, stdout); }
+		void print(int value, int base = DEC) { print((long)value, base); }
+		void print(unsigned int value, int base = DEC) { print((unsigned long)value, base); }
+		void print(long value, int base = DEC) { printf((base == HEX) ? "%lX" : "%ld", value); }
+		void print(unsigned long value, int base = DEC) { printf((base == HEX) ? "%lX" : "%lu", value); }
+		void println() { fputc('\n', stdout); }
+		template<typename T> void println(T value) { print(value); println(); }
+		template<typename T> void println(T value, int base) { print(value, base); println(); }
+};
+
+extern SigfoxHostUtils Utils;
+extern SigfoxHostPWR PWR;
+extern SigfoxHostUSB USB;
+
+
+#endif
@@ -0,0 +1,267 @@
+/*! 
+ * @file 	SigfoxPosixUART.cpp
+ * @author	Sean van der Walt / Walt Technologies Pty Ltd
+ * @version	0.1
+ * @brief 	POSIX serial port transport for host builds of LYNXBeeSigfox
+ *
+ *  Copyright (C) 2017 Walt Technologies Pty Ltd
+ *  https://walt-tech.com.au
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *    
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *   
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *	
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include "SigfoxPosixUART.h"
+
+
+/*!
+ * @brief	This function converts a baudrate to its termios constant
+ * @param	uint32_t baudrate: baudrate
+ * @return	termios speed, B9600 if not supported
+ */
+static speed_t toSpeed(uint32_t baudrate)
+{
+	switch (baudrate)
+	{
+		case 1200:		return B1200;
+		case 2400:		return B2400;
+		case 4800:		return B4800;
+		case 19200:		return B19200;
+		case 38400:		return B38400;
+		case 57600:		return B57600;
+		case 115200:	return B115200;
+		case 230400:	return B230400;
+		default:		return B9600;
+	}
+}
+
+
+
+
+/*!
+ * @brief	This function selects the serial device opened by beginUART()
+ * @param	const char* device: device path (i.e. "/dev/ttyUSB0" or a pty)
+ * @return	void
+ */
+void SigfoxPosixUART::setDevice(const char* device)
+{
+	_device = device;
+}
+
+
+
+
+/*!
+ * @brief	This function uses an already open descriptor instead of a 
+ * 			device path. The descriptor is not closed by closeUART().
+ * @param	int fd: serial port, pty or socket descriptor
+ * @return	void
+ */
+void SigfoxPosixUART::setDescriptor(int fd)
+{
+	_device = NULL;
+	_owner = false;
+	_fd = fd;
+	fcntl(_fd, F_SETFL, fcntl(_fd, F_GETFL) | O_NONBLOCK);
+}
+
+
+
+
+/*!
+ * @brief	This function opens the serial port as 8N1 raw at '_baudrate'. 
+ * 			It is called again to apply a new baudrate.
+ * @return	void
+ */
+void SigfoxPosixUART::beginUART()
+{
+	struct termios tty;
+	
+	if ((_fd < 0) && (_device != NULL))
+	{
+		_fd = open(_device, O_RDWR | O_NOCTTY | O_NONBLOCK);
+		_owner = (_fd >= 0);
+	}
+	
+	_rxIndex = 0;
+	_rxLength = 0;
+	
+	// sockets and pipes have no line settings
+	if ((_fd < 0) || (tcgetattr(_fd, &tty) != 0))
+	{
+		return (void)0;
+	}
+	
+	cfmakeraw(&tty);
+	cfsetispeed(&tty, toSpeed(_baudrate));
+	cfsetospeed(&tty, toSpeed(_baudrate));
+	tty.c_cflag |= CLOCAL | CREAD;
+	tty.c_cflag &= ~(CSTOPB | CRTSCTS);
+	tty.c_cc[VMIN] = 0;
+	tty.c_cc[VTIME] = 0;
+	tcsetattr(_fd, TCSANOW, &tty);
+}
+
+
+
+
+/*!
+ * @brief	This function closes the serial port if it was opened by 
+ * 			beginUART()
+ * @return	void
+ */
+void SigfoxPosixUART::closeUART()
+{
+	if (_owner && (_fd >= 0))
+	{
+		close(_fd);
+		_fd = -1;
+		_owner = false;
+	}
+	_rxIndex = 0;
+	_rxLength = 0;
+}
+
+
+
+
+/*!
+ * @brief	This function returns the number of received bytes ready to be 
+ * 			read. It never blocks.
+ * @param	uint8_t uart: unused
+ * @return	number of bytes
+ */
+int SigfoxPosixUART::serialAvailable(uint8_t uart)
+{
+	ssize_t count;
+	(void)uart;
+	
+	if ((_rxIndex == _rxLength) && (_fd >= 0))
+	{
+		count = read(_fd, _rx, sizeof(_rx));
+		
+		_rxIndex = 0;
+		_rxLength = (count > 0) ? count : 0;
+	}
+	
+	return _rxLength - _rxIndex;
+}
+
+
+
+
+/*!
+ * @brief	This function reads a received byte
+ * @param	uint8_t uart: unused
+ * @return	received byte or -1 if none
+ */
+int SigfoxPosixUART::serialRead(uint8_t uart)
+{
+	if (serialAvailable(uart) == 0)
+	{
+		return -1;
+	}
+	return _rx[_rxIndex++];
+}
+
+
+
+
+/*!
+ * @brief	This function discards the received bytes
+ * @param	uint8_t uart: unused
+ * @return	void
+ */
+void SigfoxPosixUART::serialFlush(uint8_t uart)
+{
+	(void)uart;
+	
+	_rxIndex = 0;
+	_rxLength = 0;
+	
+	if (_fd >= 0)
+	{
+		tcflush(_fd, TCIFLUSH);
+	}
+}
+
+
+
+
+/*!
+ * @brief	This function blocks until data is received or the timeout 
+ * 			expires
+ * @param	uint8_t uart: unused
+ * @param	uint32_t timeout: time to wait (in ms)
+ * @return	'true' if data is ready
+ */
+bool SigfoxPosixUART::serialWait(uint8_t uart, uint32_t timeout)
+{
+	struct pollfd fds;
+	(void)uart;
+	
+	if ((_rxIndex != _rxLength) || (_fd < 0))
+	{
+		return (_rxIndex != _rxLength);
+	}
+	
+	fds.fd = _fd;
+	fds.events = POLLIN;
+	
+	return (poll(&fds, 1, timeout) > 0);
+}
+
+
+
+
+/*!
+ * @brief	This function writes a string to the serial port
+ * @param	const char* str: string
+ * @param	uint8_t uart: unused
+ * @return	void
+ */
+void SigfoxPosixUART::printString(const char* str, uint8_t uart)
+{
+	size_t length = strlen(str);
+	ssize_t count;
+	struct pollfd fds;
+	(void)uart;
+	
+	while ((length > 0) && (_fd >= 0))
+	{
+		count = write(_fd, str, length);
+		
+		if (count > 0)
+		{
+			str += count;
+			length -= count;
+		}
+		else if ((count < 0) && (errno != EAGAIN) && (errno != EINTR))
+		{
+			return (void)0;
+		}
+		else
+		{
+			// output full: wait until writable
+			fds.fd = _fd;
+			fds.events = POLLOUT;
+			poll(&fds, 1, 100);
+		}
+	}
+}
@@ -0,0 +1,88 @@
+/*! 
+ * @file 	SigfoxPosixUART.h
+ * @author	Sean van der Walt / Walt Technologies Pty Ltd
+ * @version	0.1
+ * @brief 	POSIX serial port transport for host builds of LYNXBeeSigfox.
+ * 			Build the library with
+ * 			-DSIGFOX_TRANSPORT_HEADER='"extras/host/SigfoxPosixUART.h"'
+ *
+ *  Copyright (C) 2017 Walt Technologies Pty Ltd
+ *  https://walt-tech.com.au
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *    
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *   
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *	
+ */
+ 
+#ifndef SigfoxPosixUART_h
+#define SigfoxPosixUART_h
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+
+#include "SigfoxHostPort.h"
+
+
+/******************************************************************************
+ * Class
+ *****************************************************************************/
+
+/*! @class SigfoxPosixUART
+ * Provides the WaspUART members used by LYNXBeeSigfox on top of a termios 
+ * serial port or pty. The serial functions are members, so inside the driver
+ * they hide the Waspmote globals of the same name and no virtual dispatch is
+ * involved.
+ */
+class SigfoxPosixUART
+{
+	private:
+		const char* _device;
+		bool _owner;					// descriptor opened by beginUART()
+		uint8_t _rx[256];
+		uint16_t _rxIndex;
+		uint16_t _rxLength;
+		
+	public:
+		uint8_t _uart;					/*!< Socket number (unused)		*/
+		SigfoxHostUtils Utils;			/*!< Hides the global 'Utils' in the driver: EEPROM of this device	*/
+		uint32_t _baudrate;				/*!< UART baudrate				*/
+		int _fd;						/*!< Serial port descriptor		*/
+		
+		//! class constructor
+		SigfoxPosixUART()
+		{
+			_device = NULL;
+			_owner = false;
+			_rxIndex = 0;
+			_rxLength = 0;
+			_fd = -1;
+		};
+		
+		void setDevice(const char* device);
+		void setDescriptor(int fd);
+		
+		void beginUART();
+		void closeUART();
+		int serialAvailable(uint8_t uart);
+		int serialRead(uint8_t uart);
+		void serialFlush(uint8_t uart);
+		bool serialWait(uint8_t uart, uint32_t timeout);
+		void printString(const char* str, uint8_t uart);
+};
+
+//! Transport used by LYNXBeeSigfox
+typedef SigfoxPosixUART SigfoxTransport;
+
+
+#endif
@@ -0,0 +1,210 @@
+/*! 
+ * @file 	SigfoxReassembler.cpp
+ * @author	Sean van der Walt / Walt Technologies Pty Ltd
+ * @version	0.1
+ * @brief 	Host side reassembler for messages sent with 
+ * 			LYNXBeeSigfox::sendFragmented()
+ *
+ *  Copyright (C) 2017 Walt Technologies Pty Ltd
+ *  https://walt-tech.com.au
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *    
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *   
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *	
+ */
+
+#include <string.h>
+#include "SigfoxReassembler.h"
+
+
+/*!
+ * @brief	class constructor
+ * @param	uint32_t timeout: maximum time between the first fragment of a 
+ * 			message and its completion (same unit as the 'time' arguments)
+ */
+SigfoxReassembler::SigfoxReassembler(uint32_t timeout)
+	: _timeout(timeout), _completed(0), _dropped(0), _duplicates(0), _malformed(0)
+{
+}
+
+
+
+
+/*!
+ * @brief	This function clears a partial message
+ * @param	Partial& partial: partial message
+ * @param	uint32_t time: time of its first fragment
+ * @return	void
+ */
+void SigfoxReassembler::start(Partial& partial, uint32_t time)
+{
+	partial.first = time;
+	partial.received = 0;
+	partial.last = -1;
+	partial.done = false;
+}
+
+
+
+
+/*!
+ * @brief	This function adds a received frame
+ * @param	uint32_t device: Sigfox device id
+ * @param	uint32_t time: reception time (i.e. backend timestamp in seconds)
+ * @param	const uint8_t* frame: frame payload, header included
+ * @param	size_t length: frame length
+ * @param	std::vector<uint8_t>& message: rebuilt message when complete
+ * @return	'true' if the frame completed a message
+ */
+bool SigfoxReassembler::push(	uint32_t device, 
+								uint32_t time, 
+								const uint8_t* frame, 
+								size_t length, 
+								std::vector<uint8_t>& message)
+{
+	uint8_t id;
+	uint8_t index;
+	bool last;
+	size_t size;
+	
+	if ((length <= SIGFOX_FRAG_HEADER_SIZE) || (length > SIGFOX_MAX_PAYLOAD))
+	{
+		_malformed++;
+		return false;
+	}
+	
+	id = sigfoxFragId(frame[0]);
+	index = sigfoxFragIndex(frame[0]);
+	last = sigfoxFragLast(frame[0]);
+	size = length - SIGFOX_FRAG_HEADER_SIZE;
+	
+	// only the last fragment may be shorter
+	if (!last && (size != SIGFOX_FRAG_PAYLOAD))
+	{
+		_malformed++;
+		return false;
+	}
+	
+	uint64_t key = ((uint64_t)device << 3) | id;
+	std::unordered_map<uint64_t, Partial>::iterator it = _partials.find(key);
+	
+	if (it == _partials.end())
+	{
+		it = _partials.insert(std::make_pair(key, Partial())).first;
+		start(it->second, time);
+	}
+	
+	Partial& partial = it->second;
+	
+	// message id reused by a newer message: drop the old one
+	if ((time - partial.first > _timeout) 
+		|| ((partial.last >= 0) && (index > partial.last))
+		|| (last && (partial.received >> index) > 1))
+	{
+		if (!partial.done) _dropped++;
+		start(partial, time);
+	}
+	
+	if (partial.received & (1 << index))
+	{
+		if ((partial.sizes[index] == size) 
+			&& (memcmp(partial.data[index], &frame[SIGFOX_FRAG_HEADER_SIZE], size) == 0))
+		{
+			_duplicates++;
+			return false;
+		}
+		
+		// same slot with new content: a newer message
+		if (!partial.done) _dropped++;
+		start(partial, time);
+	}
+	else if (partial.done)
+	{
+		// new fragment for a rebuilt message: a newer message
+		start(partial, time);
+	}
+	
+	partial.received |= (1 << index);
+	partial.sizes[index] = size;
+	memcpy(partial.data[index], &frame[SIGFOX_FRAG_HEADER_SIZE], size);
+	
+	if (last)
+	{
+		partial.last = index;
+	}
+	
+	// complete when all fragments up to the last one are there
+	if ((partial.last < 0) || (partial.received != (uint8_t)((2 << partial.last) - 1)))
+	{
+		return false;
+	}
+	
+	message.clear();
+	for (int8_t i = 0; i <= partial.last; i++)
+	{
+		message.insert(message.end(), partial.data[i], partial.data[i] + partial.sizes[i]);
+	}
+	
+	partial.done = true;
+	_completed++;
+	
+	return true;
+}
+
+
+
+
+/*!
+ * @brief	This function forgets the messages older than the timeout
+ * @param	uint32_t time: current time
+ * @return	number of incomplete messages dropped
+ */
+size_t SigfoxReassembler::expire(uint32_t time)
+{
+	size_t count = 0;
+	
+	for (std::unordered_map<uint64_t, Partial>::iterator it = _partials.begin(); it != _partials.end(); )
+	{
+		if (time - it->second.first > _timeout)
+		{
+			if (!it->second.done) count++;
+			it = _partials.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+	
+	_dropped += count;
+	return count;
+}
+
+
+
+
+/*!
+ * @brief	This function counts the incomplete messages
+ * @return	number of messages waiting for fragments
+ */
+size_t SigfoxReassembler::pending() const
+{
+	size_t count = 0;
+	
+	for (std::unordered_map<uint64_t, Partial>::const_iterator it = _partials.begin(); it != _partials.end(); ++it)
+	{
+		if (!it->second.done) count++;
+	}
+	
+	return count;
+}
@@ -0,0 +1,87 @@
+/*! 
+ * @file 	SigfoxReassembler.h
+ * @author	Sean van der Walt / Walt Technologies Pty Ltd
+ * @version	0.1
+ * @brief 	Host side reassembler for messages sent with 
+ * 			LYNXBeeSigfox::sendFragmented()
+ *
+ *  Copyright (C) 2017 Walt Technologies Pty Ltd
+ *  https://walt-tech.com.au
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *    
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *   
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *	
+ */
+ 
+#ifndef SigfoxReassembler_h
+#define SigfoxReassembler_h
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+
+#include <stddef.h>
+#include <inttypes.h>
+#include <vector>
+#include <unordered_map>
+#include "../../SigfoxFrame.h"
+
+
+/******************************************************************************
+ * Class
+ *****************************************************************************/
+
+/*! @class SigfoxReassembler
+ * Collects fragments per device and message id. Fragments may arrive in any
+ * order; incomplete messages are dropped once they are older than the 
+ * timeout or their message id is reused. Rebuilt messages are remembered 
+ * until the timeout so repeated fragments are not taken as a new message.
+ */
+class SigfoxReassembler
+{
+	private:
+		struct Partial
+		{
+			uint32_t first;						// time of the first fragment
+			uint8_t received;					// bitmask of received fragments
+			int8_t last;						// index of the last fragment, -1 if unknown
+			bool done;							// already rebuilt, kept to spot duplicates
+			uint8_t sizes[SIGFOX_FRAG_MAX_COUNT];
+			uint8_t data[SIGFOX_FRAG_MAX_COUNT][SIGFOX_FRAG_PAYLOAD];
+		};
+		
+		std::unordered_map<uint64_t, Partial> _partials;
+		uint32_t _timeout;
+		
+		void start(Partial& partial, uint32_t time);
+		
+	public:
+		uint64_t _completed;		/*!< Messages rebuilt				*/
+		uint64_t _dropped;			/*!< Incomplete messages discarded	*/
+		uint64_t _duplicates;		/*!< Repeated fragments ignored		*/
+		uint64_t _malformed;		/*!< Frames with wrong size			*/
+		
+		//! class constructor
+		explicit SigfoxReassembler(uint32_t timeout);
+		
+		bool push(	uint32_t device, 
+					uint32_t time, 
+					const uint8_t* frame, 
+					size_t length, 
+					std::vector<uint8_t>& message);
+		size_t expire(uint32_t time);
+		size_t pending() const;
+};
+
+
+#endif
@@ -0,0 +1,193 @@
+/*! 
+ * @file 	SigfoxSeqTracker.cpp
+ * @author	Sean van der Walt / Walt Technologies Pty Ltd
+ * @version	0.1
+ * @brief 	Host side delivery accounting of the sequence counters appended
+ * 			by LYNXBeeSigfox::enableSequence()
+ *
+ *  Copyright (C) 2017 Walt Technologies Pty Ltd
+ *  https://walt-tech.com.au
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *    
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *   
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *	
+ */
+
+#include "SigfoxSeqTracker.h"
+
+#define SIGFOX_SEQ_WINDOW	64
+
+
+/*!
+ * @brief	class constructor
+ * @param	uint8_t bits: counter width set with enableSequence() (1..16)
+ * @param	size_t devices: expected number of devices, to size the table
+ */
+SigfoxSeqTracker::SigfoxSeqTracker(uint8_t bits, size_t devices)
+	: _bits(bits), _malformed(0)
+{
+	if (_bits > SIGFOX_SEQ_MAX_BITS)
+	{
+		_bits = SIGFOX_SEQ_MAX_BITS;
+	}
+	_mask = (1UL << _bits) - 1;
+	
+	if (devices > 0)
+	{
+		_devices.reserve(devices);
+	}
+}
+
+
+
+
+/*!
+ * @brief	This function adds a received counter
+ * @param	uint32_t device: Sigfox device id
+ * @param	uint16_t seq: sequence counter of the frame
+ * @return	see SigfoxSeqResults
+ */
+uint8_t SigfoxSeqTracker::push(uint32_t device, uint16_t seq)
+{
+	std::pair<std::unordered_map<uint32_t, Device>::iterator, bool> found;
+	uint32_t delta;
+	uint32_t back;
+	
+	found = _devices.insert(std::make_pair(device, Device()));
+	Device& state = found.first->second;
+	
+	seq &= _mask;
+	
+	if (found.second)
+	{
+		state.last = seq;
+		state.window = 1;
+		state.stats.received = 1;
+		return SIGFOX_SEQ_FIRST;
+	}
+	
+	delta = (seq - (uint32_t)state.last) & _mask;
+	
+	if (delta == 0)
+	{
+		state.stats.duplicates++;
+		return SIGFOX_SEQ_DUPLICATE;
+	}
+	
+	// newer frame
+	if (delta <= (_mask >> 1))
+	{
+		state.last += delta;
+		state.window = (delta < SIGFOX_SEQ_WINDOW) ? ((state.window << delta) | 1) : 1;
+		state.stats.received++;
+		
+		if (delta > 1)
+		{
+			state.stats.gaps++;
+			state.stats.missing += delta - 1;
+			return SIGFOX_SEQ_GAP;
+		}
+		return SIGFOX_SEQ_NEXT;
+	}
+	
+	// older frame
+	back = (_mask + 1) - delta;
+	
+	if ((back < SIGFOX_SEQ_WINDOW) && (back <= state.last))
+	{
+		if (state.window & (1ULL << back))
+		{
+			state.stats.duplicates++;
+			return SIGFOX_SEQ_DUPLICATE;
+		}
+		
+		state.window |= 1ULL << back;
+		state.stats.received++;
+		state.stats.late++;
+		if (state.stats.missing > 0)
+		{
+			state.stats.missing--;
+		}
+		return SIGFOX_SEQ_LATE;
+	}
+	
+	// too old to be a late frame: the device lost its counter
+	state.last += delta;
+	state.window = 1;
+	state.stats.received++;
+	state.stats.resets++;
+	
+	return SIGFOX_SEQ_RESET;
+}
+
+
+
+
+/*!
+ * @brief	This function adds a received frame
+ * @param	uint32_t device: Sigfox device id
+ * @param	const uint8_t* frame: frame payload, sequence trailer included
+ * @param	size_t length: frame length
+ * @return	see SigfoxSeqResults
+ */
+uint8_t SigfoxSeqTracker::push(uint32_t device, const uint8_t* frame, size_t length)
+{
+	if ((length < sigfoxSeqSize(_bits)) || (length > SIGFOX_MAX_PAYLOAD))
+	{
+		_malformed++;
+		return SIGFOX_SEQ_MALFORMED;
+	}
+	
+	return push(device, sigfoxGetSeq(frame, length, _bits));
+}
+
+
+
+
+/*!
+ * @brief	This function gives the counters of a device
+ * @param	uint32_t device: Sigfox device id
+ * @return	counters, NULL if the device was never seen
+ */
+const SigfoxSeqStats* SigfoxSeqTracker::stats(uint32_t device) const
+{
+	std::unordered_map<uint32_t, Device>::const_iterator it = _devices.find(device);
+	
+	return (it == _devices.end()) ? NULL : &it->second.stats;
+}
+
+
+
+
+/*!
+ * @brief	This function sums the counters of all devices
+ * @return	counters
+ */
+SigfoxSeqStats SigfoxSeqTracker::total() const
+{
+	SigfoxSeqStats sum;
+	
+	for (std::unordered_map<uint32_t, Device>::const_iterator it = _devices.begin(); it != _devices.end(); ++it)
+	{
+		const SigfoxSeqStats& stats = it->second.stats;
+		
+		sum.received += stats.received;
+		sum.duplicates += stats.duplicates;
+		sum.missing += stats.missing;
+		sum.gaps += stats.gaps;
+		sum.late += stats.late;
+		sum.resets += stats.resets;
+	}
+	
+	return sum;
+}
@@ -0,0 +1,118 @@
+/*! 
+ * @file 	SigfoxSeqTracker.h
+ * @author	Sean van der Walt / Walt Technologies Pty Ltd
+ * @version	0.1
+ * @brief 	Host side delivery accounting of the sequence counters appended
+ * 			by LYNXBeeSigfox::enableSequence()
+ *
+ *  Copyright (C) 2017 Walt Technologies Pty Ltd
+ *  https://walt-tech.com.au
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *    
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *   
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *	
+ */
+
+#ifndef SigfoxSeqTracker_h
+#define SigfoxSeqTracker_h
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+
+#include <stddef.h>
+#include <inttypes.h>
+#include <unordered_map>
+#include "../../SigfoxFrame.h"
+
+
+/******************************************************************************
+ * Definitions & Declarations
+ *****************************************************************************/
+
+/*! @enum SigfoxSeqResults
+ * What a received counter tells
+ */
+enum SigfoxSeqResults
+{
+	SIGFOX_SEQ_FIRST		= 0,	// first frame of the device
+	SIGFOX_SEQ_NEXT			= 1,	// the expected counter
+	SIGFOX_SEQ_GAP			= 2,	// counters skipped: frames missing
+	SIGFOX_SEQ_LATE			= 3,	// a missing frame arrived
+	SIGFOX_SEQ_DUPLICATE	= 4,	// already received
+	SIGFOX_SEQ_RESET		= 5,	// far behind: counter restarted
+	SIGFOX_SEQ_MALFORMED	= 6,	// frame too short for the counter
+};
+
+/*! @struct SigfoxSeqStats
+ * Delivery counters of a device, or of all devices
+ */
+struct SigfoxSeqStats
+{
+	uint64_t received;		/*!< Distinct frames received				*/
+	uint64_t duplicates;	/*!< Frames received again					*/
+	uint64_t missing;		/*!< Counters skipped and not received yet	*/
+	uint64_t gaps;			/*!< Jumps over missing counters			*/
+	uint64_t late;			/*!< Missing frames received afterwards		*/
+	uint64_t resets;		/*!< Counter restarts						*/
+	
+	SigfoxSeqStats() : received(0), duplicates(0), missing(0), gaps(0), late(0), resets(0) {}
+	
+	//! share of the frames sent which were received
+	double delivery() const
+	{
+		return (received + missing) ? (double)received / (received + missing) : 1.0;
+	}
+};
+
+
+/******************************************************************************
+ * Class
+ *****************************************************************************/
+
+/*! @class SigfoxSeqTracker
+ * Follows the sequence counter of each device. Counters are unwrapped: a
+ * counter less than half the range ahead of the last one is a newer frame,
+ * otherwise an older one. The last 64 counters are remembered to tell late
+ * frames from duplicates. One lookup per frame, no allocation once every
+ * device has been seen.
+ */
+class SigfoxSeqTracker
+{
+	private:
+		struct Device
+		{
+			uint64_t last;			// highest counter, unwrapped
+			uint64_t window;		// bit i: counter 'last - i' received
+			SigfoxSeqStats stats;
+		};
+		
+		std::unordered_map<uint32_t, Device> _devices;
+		uint8_t _bits;
+		uint32_t _mask;
+		
+	public:
+		uint64_t _malformed;		/*!< Frames too short for the counter	*/
+		
+		//! class constructor
+		SigfoxSeqTracker(uint8_t bits, size_t devices = 0);
+		
+		uint8_t push(uint32_t device, uint16_t seq);
+		uint8_t push(uint32_t device, const uint8_t* frame, size_t length);
+		const SigfoxSeqStats* stats(uint32_t device) const;
+		SigfoxSeqStats total() const;
+		size_t size() const { return _devices.size(); }
+};
+
+
+#endif
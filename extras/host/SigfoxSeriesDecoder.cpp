@@ -0,0 +1,190 @@
+/*! 
+ * @file 	SigfoxSeriesDecoder.cpp
+ * @author	Sean van der Walt / Walt Technologies Pty Ltd
+ * @version	0.1
+ * @brief 	Host side decoder of the time series frames built by SigfoxSeries
+ *
+ *  Copyright (C) 2017 Walt Technologies Pty Ltd
+ *  https://walt-tech.com.au
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *    
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *   
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *	
+ */
+
+#include <string.h>
+#include "SigfoxSeriesDecoder.h"
+
+
+/*! @class SeriesReader
+ * Bit reader over a frame which fails instead of reading past its end
+ */
+class SeriesReader
+{
+	private:
+		const uint8_t* _frame;
+		uint16_t _bits;
+		uint16_t _position;
+
+	public:
+		bool _error;
+
+		SeriesReader(const uint8_t* frame, size_t length)
+			: _frame(frame), _bits(length * 8), _position(0), _error(false) {}
+
+		uint32_t get(uint8_t bits)
+		{
+			if (_error || (_position + bits > _bits))
+			{
+				_error = true;
+				return 0;
+			}
+
+			uint32_t value = sigfoxGetBits(_frame, _position, bits);
+			_position += bits;
+			return value;
+		}
+
+		uint32_t getVarint()
+		{
+			uint32_t value = 0;
+			uint8_t shift = 0;
+			uint32_t group;
+
+			do
+			{
+				group = get(4);
+				if (shift < 32)
+				{
+					value |= (group & 0x07) << shift;
+				}
+				shift += 3;
+			}
+			while ((group & 0x08) && !_error);
+
+			return value;
+		}
+};
+
+
+
+
+/*!
+ * @brief	This function returns the value encoding of a frame
+ * @param	const uint8_t* frame: frame
+ * @return	type (see SigfoxSeriesTypes)
+ */
+uint8_t sigfoxSeriesType(const uint8_t* frame)
+{
+	return frame[0] >> 6;
+}
+
+
+
+
+/*!
+ * @brief	This function decodes a frame built by SigfoxSeries
+ * @param	const uint8_t* frame: frame
+ * @param	size_t length: frame length (in bytes)
+ * @param	std::vector<SigfoxSample>& samples: decoded samples are appended
+ * @return	'false' if the frame is truncated or malformed
+ */
+bool sigfoxDecodeSeries(const uint8_t* frame, size_t length, std::vector<SigfoxSample>& samples)
+{
+	SeriesReader reader(frame, length);
+	uint8_t type;
+	uint8_t count;
+	uint32_t time;
+	uint32_t value = 0;
+	int32_t delta = 0;
+	uint8_t leading = 0;
+	uint8_t trailing = 0;
+	SigfoxSample sample;
+
+	type = reader.get(2);
+	count = reader.get(6);
+	if (reader._error || (type > SIGFOX_SERIES_FLOAT))
+	{
+		return false;
+	}
+
+	time = reader.get(SIGFOX_SERIES_TIME_BITS);
+
+	for (uint8_t i = 0; i < count; i++)
+	{
+		// time
+		if (i == 1)
+		{
+			delta = (int32_t)reader.getVarint();
+			time += delta;
+		}
+		else if (i > 1)
+		{
+			uint32_t code = 0;
+
+			if (reader.get(1) == 0)			code = 0;
+			else if (reader.get(1) == 0)	code = reader.get(4);
+			else if (reader.get(1) == 0)	code = reader.get(8);
+			else if (reader.get(1) == 0)	code = reader.get(12);
+			else							code = reader.get(32);
+
+			delta += sigfoxUnZigZag(code);
+			time += delta;
+		}
+
+		// value
+		if (type == SIGFOX_SERIES_INTEGER)
+		{
+			if (i == 0)
+			{
+				value = (uint32_t)sigfoxUnZigZag(reader.getVarint());
+			}
+			else if (reader.get(1) == 1)
+			{
+				value += (uint32_t)sigfoxUnZigZag(reader.getVarint() + 1);
+			}
+		}
+		else
+		{
+			if (i == 0)
+			{
+				value = reader.get(32);
+			}
+			else if (reader.get(1) == 1)
+			{
+				if (reader.get(1) == 1)
+				{
+					leading = reader.get(5);
+					trailing = 32 - leading - (reader.get(5) + 1);
+				}
+				if (leading + trailing > 31)
+				{
+					return false;
+				}
+				value ^= reader.get(32 - leading - trailing) << trailing;
+			}
+		}
+
+		if (reader._error)
+		{
+			return false;
+		}
+
+		sample.time = time;
+		sample.integer = (int32_t)value;
+		memcpy(&sample.real, &value, sizeof(sample.real));
+		samples.push_back(sample);
+	}
+
+	return true;
+}
@@ -0,0 +1,57 @@
+/*! 
+ * @file 	SigfoxSeriesDecoder.h
+ * @author	Sean van der Walt / Walt Technologies Pty Ltd
+ * @version	0.1
+ * @brief 	Host side decoder of the time series frames built by SigfoxSeries
+ *
+ *  Copyright (C) 2017 Walt Technologies Pty Ltd
+ *  https://walt-tech.com.au
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *    
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *   
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *	
+ */
+ 
+#ifndef SigfoxSeriesDecoder_h
+#define SigfoxSeriesDecoder_h
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+
+#include <stddef.h>
+#include <inttypes.h>
+#include <vector>
+#include "../../SigfoxSeries.h"
+
+
+/******************************************************************************
+ * Definitions & Declarations
+ *****************************************************************************/
+
+/*! @struct SigfoxSample
+ * Decoded sample. 'time' starts from the 16-bit time of the frame; align it
+ * with the reception time of the frame if absolute times are needed.
+ */
+struct SigfoxSample
+{
+	uint32_t time;
+	int32_t integer;	// SIGFOX_SERIES_INTEGER value
+	float real;			// SIGFOX_SERIES_FLOAT value
+};
+
+uint8_t sigfoxSeriesType(const uint8_t* frame);
+bool sigfoxDecodeSeries(const uint8_t* frame, size_t length, std::vector<SigfoxSample>& samples);
+
+
+#endif
@@ -0,0 +1,557 @@
+/*! 
+ * @file 	SigfoxSimModule.cpp
+ * @author	Sean van der Walt / Walt Technologies Pty Ltd
+ * @version	0.1
+ * @brief 	Simulated LYNX-Bee module answering the AT commands used by
+ * 			LYNXBeeSigfox, plus a pty host to attach simulated modules to
+ * 			the POSIX transport.
+ *
+ *  Copyright (C) 2017 Walt Technologies Pty Ltd
+ *  https://walt-tech.com.au
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *    
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *   
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *	
+ */
+
+#include <fcntl.h>
+#include <poll.h>
+#include <pty.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include "SigfoxHostPort.h"
+#include "SigfoxSimModule.h"
+
+
+/*!
+ * @brief	class constructor
+ * @param	uint32_t id: module id returned by AT$I=10
+ */
+SigfoxSimModule::SigfoxSimModule(uint32_t id)
+	: _nextBaudrate(0),
+	  _id(id), _power(14), _keepAlive(24), _frequency(868130000), _echo(true),
+	  _baudrate(9600), _savedBaudrate(9600), _maxBaudrate(115200),
+	  _commandTime(2), _uplinkTime(6000), _downlinkTime(20000),
+	  _fcc(false), _macroChannelBitmask("000001FF0000000000000000"), _macroChannel(1),
+	  _downFreqOffset(0), _microChannels(SIGFOX_SIM_MICRO_CHANNELS), _channelWait(20000),
+	  _dropCommands(0), _stalled(false), _abortDownlink(false), _downlinkSet(false), _noDownlink(false),
+	  _uplinks(0), _downlinks(0), _nvmWrites(0), _errors(0), _channelResets(0), _channelWaits(0),
+	  _powerCycles(0), _aborted(0)
+{
+}
+
+
+
+
+/*!
+ * @brief	This function queues an answer. Answers keep their order.
+ * @param	uint32_t due: time the answer is sent
+ * @param	const std::string& text: answer
+ * @return	void
+ */
+void SigfoxSimModule::reply(uint32_t due, const std::string& text)
+{
+	if (!_replies.empty() && ((int32_t)(due - _replies.back().due) < 0))
+	{
+		due = _replies.back().due;
+	}
+
+	Reply entry = { due, text };
+	_replies.push_back(entry);
+}
+
+
+
+
+/*!
+ * @brief	This function executes a command
+ * @param	const std::string& cmd: command without "\r"
+ * @param	uint32_t now: current time (ms)
+ * @return	void
+ */
+void SigfoxSimModule::command(const std::string& cmd, uint32_t now)
+{
+	char line[40];
+	uint32_t due = now + _commandTime;
+
+	// the receive window ends before the command is taken
+	if (_abortDownlink)
+	{
+		for (std::deque<Reply>::iterator it = _replies.begin(); it != _replies.end(); ++it)
+		{
+			if (it->text.compare(0, 3, "RX=") == 0)
+			{
+				_replies.erase(it);
+				_downlinks--;
+				_aborted++;
+				break;
+			}
+		}
+	}
+
+	if (_echo)
+	{
+		reply(now, cmd + "\r\n");
+	}
+
+	if (cmd == "AT")
+	{
+		reply(due, "OK\r\n");
+	}
+	else if (cmd == "AT$I=10")
+	{
+		snprintf(line, sizeof(line), "%08lX\r\nOK\r\n", (unsigned long)_id);
+		reply(due, line);
+	}
+	else if (cmd == "AT$I=11")
+	{
+		snprintf(line, sizeof(line), "%08lX%08lX\r\nOK\r\n", (unsigned long)~_id, (unsigned long)_id);
+		reply(due, line);
+	}
+	else if (cmd == "AT$I=9")
+	{
+		reply(due, "UDL0-SIM\r\nOK\r\n");
+	}
+	else if (cmd == "ATS302?")
+	{
+		snprintf(line, sizeof(line), "%u\r\nOK\r\n", _power);
+		reply(due, line);
+	}
+	else if (cmd.compare(0, 7, "ATS302=") == 0)
+	{
+		_power = (uint8_t)strtoul(cmd.c_str() + 7, NULL, 10);
+		reply(due, "OK\r\n");
+	}
+	else if (cmd == "ATS300?")
+	{
+		snprintf(line, sizeof(line), "%u\r\nOK\r\n", _keepAlive);
+		reply(due, line);
+	}
+	else if (cmd.compare(0, 7, "ATS300=") == 0)
+	{
+		_keepAlive = (uint8_t)strtoul(cmd.c_str() + 7, NULL, 10);
+		reply(due, "OK\r\n");
+	}
+	else if (cmd == "AT$IF?")
+	{
+		snprintf(line, sizeof(line), "%lu\r\nOK\r\n", (unsigned long)_frequency);
+		reply(due, line);
+	}
+	else if (cmd.compare(0, 6, "AT$IF=") == 0)
+	{
+		_frequency = strtoul(cmd.c_str() + 6, NULL, 10);
+		reply(due, "OK\r\n");
+	}
+	else if ((cmd == "AT$WR") || (cmd == "ATS410=1"))
+	{
+		if (cmd == "AT$WR")
+		{
+			_savedBaudrate = _baudrate;
+		}
+		_nvmWrites++;
+		reply(due, "OK\r\n");
+	}
+	else if (cmd.compare(0, 7, "AT+IPR=") == 0)
+	{
+		uint32_t rate = strtoul(cmd.c_str() + 7, NULL, 10);
+		
+		if ((rate < 1200) || (rate > _maxBaudrate))
+		{
+			_errors++;
+			reply(due, "ERROR\r\n");
+			return;
+		}
+		
+		// switch once the "OK" is sent at the current rate
+		_nextBaudrate = rate;
+		reply(due, "OK\r\n");
+	}
+	else if (_fcc && (cmd == "ATS400?"))
+	{
+		snprintf(line, sizeof(line), "%s,%u\r\nOK\r\n", _macroChannelBitmask.c_str(), _macroChannel);
+		reply(due, line);
+	}
+	else if (_fcc && (cmd.compare(0, 7, "ATS400=") == 0) && (cmd.size() > 7 + 24) && (cmd[7 + 24] == ','))
+	{
+		_macroChannelBitmask = cmd.substr(7, 24);
+		_macroChannel = (uint8_t)strtoul(cmd.c_str() + 7 + 25, NULL, 10);
+		reply(due, "OK\r\n");
+	}
+	else if (_fcc && (cmd == "ATS401?"))
+	{
+		snprintf(line, sizeof(line), "%ld\r\nOK\r\n", (long)_downFreqOffset);
+		reply(due, line);
+	}
+	else if (_fcc && (cmd.compare(0, 7, "ATS401=") == 0))
+	{
+		_downFreqOffset = strtol(cmd.c_str() + 7, NULL, 10);
+		reply(due, "OK\r\n");
+	}
+	else if (_fcc && (cmd == "AT$GI?"))
+	{
+		snprintf(line, sizeof(line), "%u,%u\r\nOK\r\n", (_microChannels > 0) ? 1 : 0, _microChannels);
+		reply(due, line);
+	}
+	else if (_fcc && (cmd == "AT$RC"))
+	{
+		_microChannels = SIGFOX_SIM_MICRO_CHANNELS;
+		_channelResets++;
+		reply(due, "OK\r\n");
+	}
+	else if (cmd.compare(0, 6, "AT$CW=") == 0)
+	{
+		reply(due, "OK\r\n");
+	}
+	else if (cmd.compare(0, 6, "AT$SF=") == 0)
+	{
+		std::string data = cmd.substr(6);
+		bool ack = (data.size() >= 2) && (data.compare(data.size() - 2, 2, ",1") == 0);
+
+		if (ack)
+		{
+			data.erase(data.size() - 2);
+		}
+
+		if ((data.size() > 24) || (data.size() % 2) ||
+			(data.find_first_not_of("0123456789ABCDEFabcdef") != std::string::npos))
+		{
+			_errors++;
+			reply(due, "ERROR\r\n");
+			return;
+		}
+
+		_uplinks++;
+		_lastFrame = data;
+
+		// no free micro channel: the module waits for one
+		if (_fcc)
+		{
+			if (_microChannels > 0)
+			{
+				_microChannels--;
+			}
+			else
+			{
+				_channelWaits++;
+				now += _channelWait;
+			}
+		}
+
+		reply(now + _uplinkTime, "OK\r\n");
+
+		if (ack && !_noDownlink)
+		{
+			// downlink: module id followed by the uplink count
+			uint8_t payload[8] = { (uint8_t)(_id >> 24), (uint8_t)(_id >> 16), (uint8_t)(_id >> 8), (uint8_t)_id,
+					(uint8_t)(_uplinks >> 24), (uint8_t)(_uplinks >> 16), (uint8_t)(_uplinks >> 8), (uint8_t)_uplinks };
+
+			if (_downlinkSet)
+			{
+				memcpy(payload, _downlinkPayload, sizeof(payload));
+			}
+
+			snprintf(line, sizeof(line), "RX=%02X %02X %02X %02X %02X %02X %02X %02X\r\n",
+					payload[0], payload[1], payload[2], payload[3],
+					payload[4], payload[5], payload[6], payload[7]);
+			_downlinks++;
+			reply(now + _uplinkTime + _downlinkTime, line);
+		}
+	}
+	else
+	{
+		_errors++;
+		reply(due, "ERROR\r\n");
+	}
+}
+
+
+
+
+/*!
+ * @brief	This function receives bytes written by the driver
+ * @param	const char* data: bytes
+ * @param	size_t length: number of bytes
+ * @param	uint32_t now: current time (ms)
+ * @return	void
+ */
+void SigfoxSimModule::input(const char* data, size_t length, uint32_t now)
+{
+	for (size_t i = 0; i < length; i++)
+	{
+		if (data[i] == '\r')
+		{
+			if (!_stalled)
+			{
+				if (_dropCommands > 0)	_dropCommands--;
+				else					command(_input, now);
+			}
+			_input.clear();
+		}
+		else if (data[i] != '\n')
+		{
+			_input += data[i];
+		}
+	}
+}
+
+
+
+
+/*!
+ * @brief	This function collects the answers which are due
+ * @param	uint32_t now: current time (ms)
+ * @param	char* buffer: destination
+ * @param	size_t size: buffer size
+ * @return	number of bytes copied
+ */
+size_t SigfoxSimModule::output(uint32_t now, char* buffer, size_t size)
+{
+	size_t length = 0;
+
+	while (!_replies.empty() && ((int32_t)(now - _replies.front().due) >= 0))
+	{
+		Reply& front = _replies.front();
+		size_t count = front.text.size();
+
+		if (count > (size - length))
+		{
+			count = size - length;
+		}
+
+		memcpy(buffer + length, front.text.data(), count);
+		length += count;
+		front.text.erase(0, count);
+
+		if (!front.text.empty())
+		{
+			break;
+		}
+		_replies.pop_front();
+	}
+
+	if (_replies.empty() && _nextBaudrate)
+	{
+		_baudrate = _nextBaudrate;
+		_nextBaudrate = 0;
+	}
+
+	return length;
+}
+
+
+
+
+/*!
+ * @brief	This function cuts the module power: pending input and answers 
+ * 			are lost, a stalled module runs again and the UART comes back at
+ * 			the rate saved by AT$WR
+ * @return	void
+ */
+void SigfoxSimModule::powerOff()
+{
+	_input.clear();
+	_replies.clear();
+	_nextBaudrate = 0;
+	_baudrate = _savedBaudrate;
+	_dropCommands = 0;
+	_stalled = false;
+	_powerCycles++;
+}
+
+
+
+
+
+//  SigfoxSimPty  /////////////////////////////////////////////////////////////
+
+
+
+/*!
+ * @brief	class constructor
+ */
+SigfoxSimPty::SigfoxSimPty()
+	: _running(false)
+{
+	_wake[0] = -1;
+	_wake[1] = -1;
+}
+
+
+
+
+/*!
+ * @brief	class destructor. Stops the thread and closes the ptys.
+ */
+SigfoxSimPty::~SigfoxSimPty()
+{
+	stop();
+
+	for (size_t i = 0; i < _ports.size(); i++)
+	{
+		close(_ports[i]->master);
+		close(_ports[i]->slave);
+		delete _ports[i];
+	}
+}
+
+
+
+
+/*!
+ * @brief	This function creates a pty served by a new simulated module.
+ * 			Call it before start().
+ * @param	uint32_t id: module id
+ * @return	module index, or -1 on error
+ */
+int SigfoxSimPty::add(uint32_t id)
+{
+	int master;
+	int slave;
+	char name[64];
+	struct termios tty;
+
+	if (openpty(&master, &slave, name, NULL, NULL) < 0)
+	{
+		return -1;
+	}
+
+	// no line discipline on either side
+	tcgetattr(slave, &tty);
+	cfmakeraw(&tty);
+	tcsetattr(slave, TCSANOW, &tty);
+	fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+
+	Port* port = new Port();
+	port->master = master;
+	port->slave = slave;
+	port->name = name;
+	port->module._id = id;
+	_ports.push_back(port);
+
+	return (int)_ports.size() - 1;
+}
+
+
+
+
+/*!
+ * @brief	This function starts serving the modules
+ * @return	'true' if started
+ */
+bool SigfoxSimPty::start()
+{
+	if (_running || (pipe(_wake) < 0))
+	{
+		return false;
+	}
+
+	_running = true;
+	_thread = std::thread(&SigfoxSimPty::loop, this);
+
+	return true;
+}
+
+
+
+
+/*!
+ * @brief	This function stops serving the modules
+ * @return	void
+ */
+void SigfoxSimPty::stop()
+{
+	if (!_running)
+	{
+		return;
+	}
+
+	_running = false;
+	if (write(_wake[1], "", 1) < 0)
+	{
+		// the thread still ends on its next timeout
+	}
+	_thread.join();
+	close(_wake[0]);
+	close(_wake[1]);
+}
+
+
+
+
+/*!
+ * @brief	This function runs the modules: reads commands from the ptys and
+ * 			writes the answers when they are due
+ * @return	void
+ */
+void SigfoxSimPty::loop()
+{
+	std::vector<struct pollfd> fds(_ports.size() + 1);
+	char buffer[512];
+
+	for (size_t i = 0; i < _ports.size(); i++)
+	{
+		fds[i].fd = _ports[i]->master;
+	}
+	fds[_ports.size()].fd = _wake[0];
+	fds[_ports.size()].events = POLLIN;
+
+	while (_running)
+	{
+		uint32_t now = millis();
+		int timeout = -1;
+
+		for (size_t i = 0; i < _ports.size(); i++)
+		{
+			SigfoxSimModule& module = _ports[i]->module;
+
+			// send what is due
+			size_t length;
+			while ((length = module.output(now, buffer, sizeof(buffer))) > 0)
+			{
+				if (write(_ports[i]->master, buffer, length) < 0)
+				{
+					break;
+				}
+			}
+
+			fds[i].events = POLLIN;
+			if (module.pending())
+			{
+				int32_t wait = (int32_t)(module.nextDue() - now);
+				if (wait < 0)			wait = 0;
+				if ((timeout < 0) || (wait < timeout))	timeout = wait;
+			}
+		}
+
+		if (poll(&fds[0], fds.size(), timeout) <= 0)
+		{
+			continue;
+		}
+
+		now = millis();
+		for (size_t i = 0; i < _ports.size(); i++)
+		{
+			if (fds[i].revents & POLLIN)
+			{
+				ssize_t count = read(fds[i].fd, buffer, sizeof(buffer));
+				if (count > 0)
+				{
+					_ports[i]->module.input(buffer, count, now);
+				}
+			}
+		}
+	}
+}
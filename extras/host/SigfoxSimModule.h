@@ -0,0 +1,158 @@
+/*! 
+ * @file 	SigfoxSimModule.h
+ * @author	Sean van der Walt / Walt Technologies Pty Ltd
+ * @version	0.1
+ * @brief 	Simulated LYNX-Bee module answering the AT commands used by
+ * 			LYNXBeeSigfox, plus a pty host to attach simulated modules to
+ * 			the POSIX transport.
+ *
+ *  Copyright (C) 2017 Walt Technologies Pty Ltd
+ *  https://walt-tech.com.au
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *    
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *   
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *	
+ */
+
+#ifndef SigfoxSimModule_h
+#define SigfoxSimModule_h
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+
+#include <stddef.h>
+#include <inttypes.h>
+#include <atomic>
+#include <deque>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+/******************************************************************************
+ * Definitions & Declarations
+ *****************************************************************************/
+
+//! Free micro channels of an FCC module after "AT$RC"
+#define SIGFOX_SIM_MICRO_CHANNELS	8
+
+
+/******************************************************************************
+ * Class
+ *****************************************************************************/
+
+/*! @class SigfoxSimModule
+ * Module model independent of any transport: bytes written by the driver go
+ * to input() and the answers are collected with output() once they are due.
+ * Time is given by the caller, so it can be real or simulated.
+ */
+class SigfoxSimModule
+{
+	private:
+		struct Reply
+		{
+			uint32_t due;
+			std::string text;
+		};
+
+		std::string _input;
+		std::deque<Reply> _replies;
+		uint32_t _nextBaudrate;			// applied once the "OK" is out
+
+		void reply(uint32_t due, const std::string& text);
+		void command(const std::string& cmd, uint32_t now);
+
+	public:
+		uint32_t _id;					/*!< Module id					*/
+		uint8_t _power;					/*!< TX power (ATS302)			*/
+		uint8_t _keepAlive;				/*!< Keep-alive period (ATS300)	*/
+		uint32_t _frequency;			/*!< Frequency (AT$IF)			*/
+		bool _echo;						/*!< Echo received commands		*/
+		uint32_t _baudrate;				/*!< UART baudrate				*/
+		uint32_t _savedBaudrate;		/*!< Rate saved by AT$WR, used from power on	*/
+		uint32_t _maxBaudrate;			/*!< Highest rate of AT+IPR, '0' if not supported	*/
+		uint32_t _commandTime;			/*!< Answer time (ms)			*/
+		uint32_t _uplinkTime;			/*!< AT$SF time until "OK" (ms)	*/
+		uint32_t _downlinkTime;			/*!< "OK" to "RX=" time (ms)	*/
+		bool _fcc;						/*!< RCZ2/RCZ4 module (ATS400, ATS401, AT$GI, AT$RC)	*/
+		std::string _macroChannelBitmask;	/*!< ATS400 bitmask				*/
+		uint8_t _macroChannel;			/*!< ATS400 default macro channel	*/
+		int32_t _downFreqOffset;		/*!< ATS401 offset				*/
+		uint8_t _microChannels;			/*!< Free micro channels, one taken per uplink	*/
+		uint32_t _channelWait;			/*!< Extra uplink time with no free micro channel (ms)	*/
+		uint32_t _dropCommands;			/*!< Next commands ignored (module out of step)	*/
+		bool _stalled;					/*!< Ignores commands until powered off	*/
+		bool _abortDownlink;			/*!< A command ends a pending receive window	*/
+		uint8_t _downlinkPayload[8];	/*!< Payload of the next downlinks, if _downlinkSet	*/
+		bool _downlinkSet;				/*!< Else module id and uplink count	*/
+		bool _noDownlink;				/*!< No "RX=" after AT$SF=...,1 (no downlink from the network)	*/
+
+		uint32_t _uplinks;				/*!< Frames sent				*/
+		uint32_t _downlinks;			/*!< Downlinks delivered		*/
+		uint32_t _nvmWrites;			/*!< AT$WR commands				*/
+		uint32_t _errors;				/*!< Commands answered "ERROR"	*/
+		uint32_t _channelResets;		/*!< AT$RC commands				*/
+		uint32_t _channelWaits;			/*!< Uplinks delayed for a free micro channel	*/
+		uint32_t _powerCycles;			/*!< powerOff() calls			*/
+		uint32_t _aborted;				/*!< Downlinks lost to _abortDownlink	*/
+		std::string _lastFrame;			/*!< Hex payload of the last uplink	*/
+
+		SigfoxSimModule(uint32_t id = 0x001E4C2B);
+
+		void input(const char* data, size_t length, uint32_t now);
+		void powerOff();
+		size_t output(uint32_t now, char* buffer, size_t size);
+		bool pending() const { return !_replies.empty(); }
+		uint32_t nextDue() const { return _replies.empty() ? 0 : _replies.front().due; }
+};
+
+
+
+/*! @class SigfoxSimPty
+ * Serves simulated modules on ptys from one background thread. The driver
+ * opens name(i) like any serial port.
+ */
+class SigfoxSimPty
+{
+	private:
+		struct Port
+		{
+			int master;
+			int slave;						// kept open so the master never hangs up
+			std::string name;
+			SigfoxSimModule module;
+		};
+
+		std::vector<Port*> _ports;
+		std::thread _thread;
+		std::atomic<bool> _running;
+		int _wake[2];
+
+		void loop();
+
+	public:
+		SigfoxSimPty();
+		~SigfoxSimPty();
+
+		int add(uint32_t id);
+		const char* name(int index) { return _ports[index]->name.c_str(); }
+		SigfoxSimModule& module(int index) { return _ports[index]->module; }
+		size_t size() const { return _ports.size(); }
+
+		bool start();
+		void stop();
+};
+
+
+#endif
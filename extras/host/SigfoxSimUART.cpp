@@ -0,0 +1,138 @@
+/*! 
+ * @file 	SigfoxSimUART.cpp
+ * @author	Sean van der Walt / Walt Technologies Pty Ltd
+ * @version	0.1
+ * @brief 	In-memory transport connecting LYNXBeeSigfox to a SigfoxSimModule
+ * 			for simulations in virtual time.
+ *
+ *  Copyright (C) 2017 Walt Technologies Pty Ltd
+ *  https://walt-tech.com.au
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *    
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *   
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *	
+ */
+
+#include <string.h>
+#include "SigfoxSimUART.h"
+
+
+/*!
+ * @brief	This function returns the number of received bytes ready to be 
+ * 			read, collecting the answers of the module which are due
+ * @param	uint8_t uart: unused
+ * @return	number of bytes
+ */
+int SigfoxSimUART::serialAvailable(uint8_t uart)
+{
+	(void)uart;
+	
+	if ((_rxIndex == _rxLength) && _module)
+	{
+		// wrong baudrate: nothing readable
+		bool match = (_baudrate == _module->_baudrate);
+		
+		_rxIndex = 0;
+		_rxLength = _module->output(millis(), _rx, sizeof(_rx));
+		if (!match)
+		{
+			_rxLength = 0;
+		}
+	}
+	
+	return _rxLength - _rxIndex;
+}
+
+
+
+
+/*!
+ * @brief	This function reads a received byte
+ * @param	uint8_t uart: unused
+ * @return	received byte or -1 if none
+ */
+int SigfoxSimUART::serialRead(uint8_t uart)
+{
+	if (serialAvailable(uart) == 0)
+	{
+		return -1;
+	}
+	return (uint8_t)_rx[_rxIndex++];
+}
+
+
+
+
+/*!
+ * @brief	This function discards the received bytes
+ * @param	uint8_t uart: unused
+ * @return	void
+ */
+void SigfoxSimUART::serialFlush(uint8_t uart)
+{
+	(void)uart;
+	
+	_rxIndex = 0;
+	_rxLength = 0;
+}
+
+
+
+
+/*!
+ * @brief	This function "waits" for data: the virtual clock jumps to the 
+ * 			next answer of the module, or by the timeout
+ * @param	uint8_t uart: unused
+ * @param	uint32_t timeout: time to wait (in ms)
+ * @return	'true' if data is ready
+ */
+bool SigfoxSimUART::serialWait(uint8_t uart, uint32_t timeout)
+{
+	unsigned long now = millis();
+	unsigned long wait = timeout;
+	
+	if (serialAvailable(uart) > 0)
+	{
+		return true;
+	}
+	
+	if (_module && _module->pending())
+	{
+		int32_t due = (int32_t)(_module->nextDue() - (uint32_t)now);
+		if (due < 0)			due = 0;
+		if ((unsigned long)due < wait)	wait = due;
+	}
+	
+	delay(wait);
+	
+	return (serialAvailable(uart) > 0);
+}
+
+
+
+
+/*!
+ * @brief	This function writes a string to the module
+ * @param	const char* str: string to be written
+ * @param	uint8_t uart: unused
+ * @return	void
+ */
+void SigfoxSimUART::printString(const char* str, uint8_t uart)
+{
+	(void)uart;
+	
+	if (_module && (_baudrate == _module->_baudrate))
+	{
+		_module->input(str, strlen(str), millis());
+	}
+}
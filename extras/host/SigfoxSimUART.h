@@ -0,0 +1,88 @@
+/*! 
+ * @file 	SigfoxSimUART.h
+ * @author	Sean van der Walt / Walt Technologies Pty Ltd
+ * @version	0.1
+ * @brief 	In-memory transport connecting LYNXBeeSigfox to a SigfoxSimModule
+ * 			for simulations in virtual time. Build the library with
+ * 			-DSIGFOX_TRANSPORT_HEADER='"extras/host/SigfoxSimUART.h"'
+ *
+ *  Copyright (C) 2017 Walt Technologies Pty Ltd
+ *  https://walt-tech.com.au
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *    
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *   
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *	
+ */
+ 
+#ifndef SigfoxSimUART_h
+#define SigfoxSimUART_h
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+
+#include "SigfoxHostPort.h"
+#include "SigfoxSimModule.h"
+
+
+/******************************************************************************
+ * Class
+ *****************************************************************************/
+
+/*! @class SigfoxSimUART
+ * Provides the WaspUART members used by LYNXBeeSigfox on top of a simulated 
+ * module. Time is millis(), so a simulation sets a virtual clock with 
+ * setVirtualClock(). serialWait() advances that clock to the next answer of
+ * the module, which lets the blocking functions run in virtual time when 
+ * setSleepWhileWaiting(true) is used. Bytes are lost in both directions
+ * while '_baudrate' differs from the module's. closeUART(), called by OFF(),
+ * stands for the socket power being cut.
+ */
+class SigfoxSimUART
+{
+	private:
+		SigfoxSimModule* _module;
+		char _rx[128];
+		uint16_t _rxIndex;
+		uint16_t _rxLength;
+		
+	public:
+		uint8_t _uart;					/*!< Socket number (unused)		*/
+		SigfoxHostUtils Utils;			/*!< Hides the global 'Utils' in the driver: EEPROM of this device	*/
+		uint32_t _baudrate;				/*!< UART baudrate, must match the module's	*/
+		
+		//! class constructor
+		SigfoxSimUART()
+		{
+			_module = NULL;
+			_rxIndex = 0;
+			_rxLength = 0;
+		};
+		
+		void attach(SigfoxSimModule* module) { _module = module; }
+		SigfoxSimModule* module() { return _module; }
+		
+		void beginUART() {}
+		void closeUART() { if (_module) _module->powerOff(); }
+		int serialAvailable(uint8_t uart);
+		int serialRead(uint8_t uart);
+		void serialFlush(uint8_t uart);
+		bool serialWait(uint8_t uart, uint32_t timeout);
+		void printString(const char* str, uint8_t uart);
+};
+
+//! Transport used by LYNXBeeSigfox
+typedef SigfoxSimUART SigfoxTransport;
+
+
+#endif
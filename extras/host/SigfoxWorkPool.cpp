@@ -0,0 +1,157 @@
+/*! 
+ * @file 	SigfoxWorkPool.cpp
+ * @author	Sean van der Walt / Walt Technologies Pty Ltd
+ * @version	0.1
+ * @brief 	Work-stealing thread pool for host side batch jobs
+ *
+ *  Copyright (C) 2017 Walt Technologies Pty Ltd
+ *  https://walt-tech.com.au
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *    
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *   
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *	
+ */
+
+#include <atomic>
+#include <thread>
+#include "SigfoxWorkPool.h"
+
+
+/*!
+ * @brief	class constructor
+ * @param	unsigned threads: number of workers, '0' for one per CPU
+ */
+SigfoxWorkPool::SigfoxWorkPool(unsigned threads)
+	: _steals(0)
+{
+	if (threads == 0)
+	{
+		threads = std::thread::hardware_concurrency();
+	}
+	if (threads == 0)
+	{
+		threads = 1;
+	}
+	
+	for (unsigned i = 0; i < threads; i++)
+	{
+		_queues.push_back(new Queue());
+	}
+}
+
+
+
+
+/*!
+ * @brief	class destructor
+ */
+SigfoxWorkPool::~SigfoxWorkPool()
+{
+	for (size_t i = 0; i < _queues.size(); i++)
+	{
+		delete _queues[i];
+	}
+}
+
+
+
+
+/*!
+ * @brief	This function takes the next task of a worker, stealing one if its
+ * 			own queue is empty
+ * @param	unsigned worker: worker index
+ * @param	size_t& task: task taken
+ * @return	'false' when every queue is empty
+ */
+bool SigfoxWorkPool::take(unsigned worker, size_t& task)
+{
+	{
+		std::lock_guard<std::mutex> guard(_queues[worker]->lock);
+		if (!_queues[worker]->tasks.empty())
+		{
+			task = _queues[worker]->tasks.back();
+			_queues[worker]->tasks.pop_back();
+			return true;
+		}
+	}
+	
+	// steal the oldest task of the other workers, starting with the next one
+	for (size_t i = 1; i < _queues.size(); i++)
+	{
+		Queue* victim = _queues[(worker + i) % _queues.size()];
+		std::lock_guard<std::mutex> guard(victim->lock);
+		
+		if (!victim->tasks.empty())
+		{
+			task = victim->tasks.front();
+			victim->tasks.pop_front();
+			return true;
+		}
+	}
+	
+	return false;
+}
+
+
+
+
+/*!
+ * @brief	This function runs tasks 0 to tasks-1 and returns when all ended.
+ * 			Tasks are not added while running, so a worker finding every 
+ * 			queue empty is done.
+ * @param	size_t tasks: number of tasks
+ * @param	job: called with the task number and the worker index
+ * @return	void
+ */
+void SigfoxWorkPool::run(size_t tasks, const std::function<void(size_t, unsigned)>& job)
+{
+	std::vector<std::thread> workers;
+	std::atomic<size_t> steals(0);
+	size_t count = _queues.size();
+	
+	// contiguous ranges; workers run them from the back
+	for (size_t i = 0; i < count; i++)
+	{
+		size_t first = tasks * i / count;
+		size_t last = tasks * (i + 1) / count;
+		
+		for (size_t task = last; task > first; task--)
+		{
+			_queues[i]->tasks.push_back(task - 1);
+		}
+	}
+	
+	for (unsigned i = 0; i < count; i++)
+	{
+		workers.push_back(std::thread([this, i, count, tasks, &job, &steals]()
+		{
+			size_t task;
+			
+			while (take(i, task))
+			{
+				if ((task < tasks * i / count) || (task >= tasks * (i + 1) / count))
+				{
+					steals++;
+				}
+				job(task, i);
+			}
+		}));
+	}
+	
+	for (size_t i = 0; i < workers.size(); i++)
+	{
+		workers[i].join();
+	}
+	
+	_steals += steals;
+}
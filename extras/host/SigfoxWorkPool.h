@@ -0,0 +1,73 @@
+/*! 
+ * @file 	SigfoxWorkPool.h
+ * @author	Sean van der Walt / Walt Technologies Pty Ltd
+ * @version	0.1
+ * @brief 	Work-stealing thread pool for host side batch jobs
+ *
+ *  Copyright (C) 2017 Walt Technologies Pty Ltd
+ *  https://walt-tech.com.au
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *    
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *   
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *	
+ */
+ 
+#ifndef SigfoxWorkPool_h
+#define SigfoxWorkPool_h
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+
+#include <stddef.h>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+
+/******************************************************************************
+ * Class
+ *****************************************************************************/
+
+/*! @class SigfoxWorkPool
+ * Runs numbered tasks on a set of threads. Each worker starts with its own 
+ * contiguous range of tasks and takes them from the back of its queue; a
+ * worker running out of tasks steals from the front of another queue, so 
+ * uneven tasks still keep every thread busy.
+ */
+class SigfoxWorkPool
+{
+	private:
+		struct Queue
+		{
+			std::mutex lock;
+			std::deque<size_t> tasks;
+		};
+		
+		std::vector<Queue*> _queues;
+		
+		bool take(unsigned worker, size_t& task);
+		
+	public:
+		size_t _steals;					/*!< Tasks run by another worker	*/
+		
+		SigfoxWorkPool(unsigned threads = 0);
+		~SigfoxWorkPool();
+		
+		unsigned threads() const { return _queues.size(); }
+		void run(size_t tasks, const std::function<void(size_t, unsigned)>& job);
+};
+
+
+#endif
@@ -0,0 +1,106 @@
+/*!
+ * @file 	sigfox_burst_sim.cpp
+ * @author	Sean van der Walt / Walt Technologies Pty Ltd
+ * @version	0.1
+ * @brief 	Runs testTransmit() bursts against a simulated module in virtual
+ * 			time and checks that each slot holds its test frame only
+ *
+ * 	g++ -O2 -std=c++11 -I../.. -DSIGFOX_TRANSPORT_HEADER='"extras/host/SigfoxSimUART.h"'
+ * 		sigfox_burst_sim.cpp SigfoxSimUART.cpp SigfoxSimModule.cpp SigfoxHostPort.cpp
+ * 		../../LYNXBeeSigfox.cpp -lutil
+ * 	./a.out [frames] [period s] [uplink ms]
+ *
+ *  Copyright (C) 2017 Walt Technologies Pty Ltd
+ *  https://walt-tech.com.au
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../../LYNXBeeSigfox.h"
+
+#if !SIGFOX_FEATURE_RF_TEST
+#error "testTransmit() needs SIGFOX_FEATURE_RF_TEST"
+#endif
+
+
+//! run one burst and print its report, '0' if the slots held extra uplinks
+static int burst(const char* name, LYNXBeeSigfox& driver, uint16_t frames, uint16_t period, int channel)
+{
+	SigfoxSimModule* module = driver.module();
+	uint32_t uplinks = module->_uplinks;
+	uint8_t answer = driver.testTransmit(frames, period, channel);
+	SigfoxBurstReport& report = driver._burst;
+	uint32_t extra = module->_uplinks - uplinks - ((channel == -1) ? report.sent : 0);
+
+	printf("%-24s answer %u, %3u sent, %3u failed, %3u late, frame %5lu/%5lu/%5lu ms, %7.1f frames/h, %lu extra uplinks\n",
+			name, answer, report.sent, report.failed, report.late,
+			(unsigned long)report.minTime,
+			(unsigned long)(report.sent ? report.totalTime / report.sent : 0),
+			(unsigned long)report.maxTime,
+			report.elapsed ? report.sent * 3600000.0 / report.elapsed : 0.0,
+			(unsigned long)extra);
+
+	return extra == 0;
+}
+
+
+int main(int argc, char** argv)
+{
+	uint16_t frames = (argc > 1) ? atoi(argv[1]) : 10;
+	uint16_t period = (argc > 2) ? atoi(argv[2]) : 10;
+	uint32_t uplinkTime = (argc > 3) ? atoi(argv[3]) : 6000;
+	unsigned long clock = 0;
+	SigfoxSimModule module;
+	LYNXBeeSigfox driver;
+	uint8_t alarm[2] = { 0xA1, 0x01 };
+	int ok = 1;
+
+	setVirtualClock(&clock);
+
+	module._echo = false;
+	module._uplinkTime = uplinkTime;
+	driver.setSleepWhileWaiting(true);
+	driver.attach(&module);
+
+	if (driver.ON(SOCKET0) != SIGFOX_ANSWER_OK)
+	{
+		printf("module not answering\n");
+		return 1;
+	}
+
+	printf("%u frames every %u s, uplink %lu ms\n", frames, period, (unsigned long)uplinkTime);
+
+	ok &= burst("uplinks", driver, frames, period, -1);
+	ok &= burst("uplinks, half period", driver, frames, (period > 1) ? period / 2 : 1, -1);
+
+	// work which send() would do before each uplink must stay out of the slots
+	driver.queueUrgent(alarm, sizeof(alarm));
+#if SIGFOX_FEATURE_TELEMETRY
+	driver.enableTelemetry(1, false);
+#endif
+	driver.enablePowerControl(0, 14, -120);
+	ok &= burst("uplinks, urgent queued", driver, frames, period, -1);
+	printf("%-24s urgent frame still queued: %s\n", "", driver.urgentPending() ? "yes" : "no");
+
+	ok &= burst("continuous wave, ch 0", driver, frames, period, 0);
+
+	setVirtualClock(NULL);
+
+	printf("%s\n", ok ? "slots hold test frames only" : "extra uplinks in the slots");
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,159 @@
+/*! 
+ * @file 	sigfox_coroutine_demo.cpp
+ * @author	Sean van der Walt / Walt Technologies Pty Ltd
+ * @version	0.1
+ * @brief 	Coroutine API driving simulated modules on ptys from one thread.
+ * 			Task frames come from a SigfoxFramePool and heap allocations are
+ * 			counted while the tasks run.
+ * 
+ * 	g++ -O2 -std=c++20 -I../.. -DSIGFOX_TRANSPORT_HEADER='"extras/host/SigfoxPosixUART.h"'
+ * 		-DSIGFOX_BOOT_TIME=100 sigfox_coroutine_demo.cpp SigfoxCoroutine.cpp 
+ * 		SigfoxSimModule.cpp SigfoxPosixUART.cpp SigfoxHostPort.cpp 
+ * 		../../LYNXBeeSigfox.cpp -lutil -pthread
+ * 	./a.out [modules] [frames] [uplink ms]
+ *
+ *  Copyright (C) 2017 Walt Technologies Pty Ltd
+ *  https://walt-tech.com.au
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *    
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *   
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *	
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <memory>
+#include <new>
+#include "SigfoxCoroutine.h"
+#include "SigfoxSimModule.h"
+
+// heap allocations of this thread
+static thread_local size_t allocations = 0;
+
+void* operator new(size_t size)
+{
+	allocations++;
+	void* pointer = malloc(size);
+	if (!pointer)
+	{
+		throw std::bad_alloc();
+	}
+	return pointer;
+}
+
+void operator delete(void* pointer) noexcept
+{
+	free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept
+{
+	free(pointer);
+}
+
+
+// send one frame, asking for a downlink every fourth frame
+SigfoxTask report(SigfoxCoModule& module, uint8_t counter)
+{
+	uint8_t frame[4] = { (uint8_t)(module._driver._id & 0xFF), counter, 0xAB, 0xCD };
+	
+	if ((counter % 4) != 3)
+	{
+		co_return co_await module.send(frame, sizeof(frame));
+	}
+	
+	uint8_t answer = co_await module.sendACK(frame, sizeof(frame));
+	
+	// the simulator answers with the module id
+	uint32_t id = ((uint32_t)module._driver._downlink[0] << 24) | ((uint32_t)module._driver._downlink[1] << 16) |
+					((uint32_t)module._driver._downlink[2] << 8) | module._driver._downlink[3];
+	
+	if ((answer == SIGFOX_ANSWER_OK) && (id != module._driver._id))
+	{
+		answer = SIGFOX_ANSWER_ERROR;
+	}
+	co_return answer;
+}
+
+
+SigfoxTask conversation(SigfoxCoModule& module, int frames)
+{
+	uint8_t answer;
+	
+	if ((answer = co_await module.ON()) != SIGFOX_ANSWER_OK)			co_return answer;
+	if ((answer = co_await module.getID()) != SIGFOX_ANSWER_OK)			co_return answer;
+	if ((answer = co_await module.setPower(14)) != SIGFOX_ANSWER_OK)	co_return answer;
+	
+	for (int n = 0; n < frames; n++)
+	{
+		if ((answer = co_await report(module, n)) != SIGFOX_ANSWER_OK)	co_return answer;
+	}
+	
+	co_return SIGFOX_ANSWER_OK;
+}
+
+
+int main(int argc, char** argv)
+{
+	int modules = (argc > 1) ? atoi(argv[1]) : 64;
+	int frames = (argc > 2) ? atoi(argv[2]) : 8;
+	uint32_t uplinkTime = (argc > 3) ? atoi(argv[3]) : 100;
+	
+	SigfoxSimPty sim;
+	SigfoxLoop loop;
+	SigfoxFramePool pool(512, 2 * modules);
+	std::vector< std::unique_ptr<SigfoxCoModule> > ports;
+	std::vector<SigfoxTask> tasks(modules);
+	
+	for (int i = 0; i < modules; i++)
+	{
+		sim.add(0x001E0000 + i);
+		sim.module(i)._uplinkTime = uplinkTime;
+		sim.module(i)._downlinkTime = uplinkTime;
+	}
+	sim.start();
+	
+	for (int i = 0; i < modules; i++)
+	{
+		ports.emplace_back(new SigfoxCoModule(loop, sim.name(i)));
+	}
+	pool.install();
+	
+	unsigned long start = millis();
+	size_t before = allocations;
+	
+	for (int i = 0; i < modules; i++)
+	{
+		tasks[i] = conversation(*ports[i], frames);
+	}
+	loop.run();
+	
+	size_t heap = allocations - before;
+	unsigned long elapsed = millis() - start;
+	int failed = 0;
+	
+	for (int i = 0; i < modules; i++)
+	{
+		if (!tasks[i].done() || (tasks[i].answer() != SIGFOX_ANSWER_OK))
+		{
+			failed++;
+		}
+	}
+	
+	printf("%d modules, %d frames each: %lu ms, %d failed\n", modules, frames, elapsed, failed);
+	printf("frame pool: %zu blocks peak, %zu heap fallbacks, %zu heap allocations while running\n",
+			pool._peak, pool._fallbacks, heap);
+	
+	return failed ? 1 : 0;
+}
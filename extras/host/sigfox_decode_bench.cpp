@@ -0,0 +1,116 @@
+/*! 
+ * @file 	sigfox_decode_bench.cpp
+ * @author	Sean van der Walt / Walt Technologies Pty Ltd
+ * @version	0.1
+ * @brief 	Throughput benchmark of SigfoxDecoder. Frames are packed with the
+ * 			same functions the firmware uses, decoded in batch and checked.
+ * 
+ * 	g++ -O2 -std=c++11 -pthread sigfox_decode_bench.cpp SigfoxDecoder.cpp
+ * 	./a.out [frames] [threads]
+ *
+ *  Copyright (C) 2017 Walt Technologies Pty Ltd
+ *  https://walt-tech.com.au
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *    
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *   
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *	
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <random>
+#include <thread>
+#include "SigfoxDecoder.h"
+
+// example layout: 12-byte environmental frame
+static const SigfoxFieldLayout layout[] = 
+{
+	{ "temperature",	0,	12,	SIGFOX_FIELD_SIGNED },
+	{ "humidity",		12,	7,	SIGFOX_FIELD_UNSIGNED },
+	{ "pressure",		19,	17,	SIGFOX_FIELD_UNSIGNED },
+	{ "battery",		36,	8,	SIGFOX_FIELD_UNSIGNED },
+	{ "counter",		44,	32,	SIGFOX_FIELD_UNSIGNED },
+	{ "status",			76,	4,	SIGFOX_FIELD_UNSIGNED },
+	{ "offset",			80,	16,	SIGFOX_FIELD_SIGNED },
+};
+
+#define FIELDS	(sizeof(layout) / sizeof(layout[0]))
+
+
+int main(int argc, char** argv)
+{
+	size_t frames = (argc > 1) ? strtoul(argv[1], NULL, 10) : 4000000;
+	unsigned maxThreads = (argc > 2) ? strtoul(argv[2], NULL, 10) : std::thread::hardware_concurrency();
+	std::vector<std::string> payloads(frames);
+	std::vector< std::vector<int32_t> > expected(FIELDS, std::vector<int32_t>(frames));
+	std::mt19937 random(1);
+	char hex[2*SIGFOX_MAX_PAYLOAD + 1];
+	
+	// pack frames as the firmware does
+	for (size_t i = 0; i < frames; i++)
+	{
+		uint8_t frame[SIGFOX_MAX_PAYLOAD];
+		memset(frame, 0x00, sizeof(frame));
+		
+		for (size_t f = 0; f < FIELDS; f++)
+		{
+			uint32_t value = random();
+			if (layout[f].bits < 32)
+			{
+				value &= (1UL << layout[f].bits) - 1;
+				if ((layout[f].type == SIGFOX_FIELD_SIGNED) && (value >> (layout[f].bits - 1)))
+				{
+					value |= 0xFFFFFFFFUL << layout[f].bits;
+				}
+			}
+			expected[f][i] = (int32_t)value;
+			sigfoxPackField(frame, &layout[f], (int32_t)value);
+		}
+		
+		for (size_t b = 0; b < SIGFOX_MAX_PAYLOAD; b++)
+		{
+			snprintf(&hex[2*b], 3, (i & 1) ? "%02x" : "%02X", frame[b]);
+		}
+		payloads[i] = hex;
+	}
+	
+	SigfoxDecoder decoder(layout, FIELDS);
+	
+	// 1, 2, 4.. threads up to the maximum
+	for (unsigned threads = 1; ; threads *= 2)
+	{
+		SigfoxColumns columns;
+		
+		if (threads > maxThreads) threads = maxThreads;
+		
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		size_t decoded = decoder.decode(payloads, columns, threads);
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		
+		// check
+		size_t errors = 0;
+		for (size_t f = 0; f < FIELDS; f++)
+		{
+			if (columns.fields[f] != expected[f]) errors++;
+		}
+		
+		printf("threads: %2u  frames: %zu  decoded: %zu  errors: %zu  %.1f Mframes/s\n",
+			threads, frames, decoded, errors, decoded / elapsed.count() / 1e6);
+		
+		if (threads >= maxThreads) break;
+	}
+	
+	return 0;
+}
@@ -0,0 +1,118 @@
+/*! 
+ * @file 	sigfox_fleet_sim.cpp
+ * @author	Sean van der Walt / Walt Technologies Pty Ltd
+ * @version	0.1
+ * @brief 	Evaluates a periodic sampling policy on a simulated fleet
+ * 
+ * 	g++ -O2 -std=c++11 -I../.. -DSIGFOX_TRANSPORT_HEADER='"extras/host/SigfoxSimUART.h"'
+ * 		sigfox_fleet_sim.cpp SigfoxFleetSim.cpp SigfoxWorkPool.cpp SigfoxSimUART.cpp
+ * 		SigfoxSimModule.cpp SigfoxHostPort.cpp ../../LYNXBeeSigfox.cpp -lutil -pthread
+ * 	./a.out [devices] [days] [sample minutes] [uplink every] [acks per day] [quota guard] [threads]
+ *
+ *  Copyright (C) 2017 Walt Technologies Pty Ltd
+ *  https://walt-tech.com.au
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *    
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *   
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *	
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include "SigfoxFleetSim.h"
+
+
+/*! @class PeriodicPolicy
+ * Samples every 'period', sends one sample out of 'every', asks for a 
+ * downlink with the first 'acks' uplinks of the day. With the guard on, 
+ * samples are dropped once the daily quota is used.
+ */
+class PeriodicPolicy : public SigfoxFleetPolicy
+{
+	public:
+		uint32_t _period;
+		uint32_t _every;
+		uint16_t _acks;
+		bool _guard;
+		uint16_t _quota;
+		
+		uint32_t period(uint32_t device, uint32_t sample)
+		{
+			(void)device;
+			(void)sample;
+			return _period;
+		}
+		
+		uint8_t action(uint32_t device, uint32_t sample, const SigfoxFleetUsage& today, uint32_t random)
+		{
+			(void)device;
+			(void)random;
+			
+			if ((sample % _every) != 0)
+			{
+				return SIGFOX_FLEET_SKIP;
+			}
+			if (_guard && (today.uplinks >= _quota))
+			{
+				return SIGFOX_FLEET_SKIP;
+			}
+			if (today.downlinks < _acks)
+			{
+				return SIGFOX_FLEET_UPLINK_ACK;
+			}
+			return SIGFOX_FLEET_UPLINK;
+		}
+};
+
+
+int main(int argc, char** argv)
+{
+	SigfoxFleetConfig config;
+	PeriodicPolicy policy;
+	SigfoxFleetStats stats;
+	
+	config.devices = (argc > 1) ? atoi(argv[1]) : 10000;
+	config.days = (argc > 2) ? atoi(argv[2]) : 365;
+	policy._period = ((argc > 3) ? atoi(argv[3]) : 10) * 60000;
+	policy._every = (argc > 4) ? atoi(argv[4]) : 1;
+	policy._acks = (argc > 5) ? atoi(argv[5]) : 1;
+	policy._guard = (argc > 6) ? (atoi(argv[6]) != 0) : false;
+	policy._quota = config.uplinkQuota;
+	config.threads = (argc > 7) ? atoi(argv[7]) : 0;
+	
+	SigfoxFleetSim sim(config, policy);
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	
+	sim.run(stats);
+	
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	double deviceYears = config.devices * (config.days / 365.0);
+	
+	printf("fleet:      %u devices, %u days, %.1f s (%.0f device-years/s, %zu shards stolen)\n",
+			config.devices, config.days, seconds, deviceYears / seconds, sim._steals);
+	printf("samples:    %llu, skipped %llu, failed %llu\n",
+			(unsigned long long)stats.samples, (unsigned long long)stats.skipped, (unsigned long long)stats.failed);
+	printf("messages:   %llu uplinks, %llu downlinks\n",
+			(unsigned long long)stats.uplinks, (unsigned long long)stats.downlinks);
+	printf("quota:      %llu of %llu device-days over %u uplinks (%llu extra uplinks), %llu over %u downlinks\n",
+			(unsigned long long)stats.uplinkViolations, (unsigned long long)stats.deviceDays, config.uplinkQuota,
+			(unsigned long long)stats.overQuota, (unsigned long long)stats.downlinkViolations, config.downlinkQuota);
+	printf("energy:     %.1f mWh per device-year (%.0f mAh at %.1f V)\n",
+			stats.energy / deviceYears, stats.energy / deviceYears / config.voltage, config.voltage);
+	printf("latency:    p50 %llu ms, p90 %llu ms, p99 %llu ms, max %llu ms\n",
+			(unsigned long long)stats.percentile(50), (unsigned long long)stats.percentile(90),
+			(unsigned long long)stats.percentile(99), (unsigned long long)stats.latencyMax);
+	
+	return 0;
+}
@@ -0,0 +1,112 @@
+/*! 
+ * @file 	sigfox_gateway_demo.cpp
+ * @author	Sean van der Walt / Walt Technologies Pty Ltd
+ * @version	0.1
+ * @brief 	SigfoxGateway driving simulated modules on ptys. Every module 
+ * 			sends frames, one in four with a downlink request, and the 
+ * 			throughput is printed for each module count.
+ * 
+ * 	g++ -O2 -std=c++11 -I../.. -DSIGFOX_TRANSPORT_HEADER='"extras/host/SigfoxPosixUART.h"'
+ * 		-DSIGFOX_BOOT_TIME=100 sigfox_gateway_demo.cpp SigfoxGateway.cpp 
+ * 		SigfoxSimModule.cpp SigfoxPosixUART.cpp SigfoxHostPort.cpp 
+ * 		../../LYNXBeeSigfox.cpp -lutil -pthread
+ * 	./a.out [max modules] [frames] [uplink ms]
+ *
+ *  Copyright (C) 2017 Walt Technologies Pty Ltd
+ *  https://walt-tech.com.au
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *    
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *   
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *	
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "SigfoxGateway.h"
+#include "SigfoxSimModule.h"
+
+
+int main(int argc, char** argv)
+{
+	int maxModules = (argc > 1) ? atoi(argv[1]) : 64;
+	int frames = (argc > 2) ? atoi(argv[2]) : 8;
+	uint32_t uplinkTime = (argc > 3) ? atoi(argv[3]) : 100;
+	
+	for (int modules = 1; modules <= maxModules; modules *= 4)
+	{
+		SigfoxSimPty sim;
+		SigfoxGateway gateway;
+		int wrongDownlinks = 0;
+		
+		for (int i = 0; i < modules; i++)
+		{
+			sim.add(0x001E0000 + i);
+			sim.module(i)._uplinkTime = uplinkTime;
+			sim.module(i)._downlinkTime = uplinkTime;
+		}
+		sim.start();
+		
+		// power on and read the ids
+		for (int i = 0; i < modules; i++)
+		{
+			gateway.addModule(sim.name(i));
+			gateway.getID(i);
+		}
+		gateway.runUntilIdle();
+		
+		unsigned long start = millis();
+		
+		for (int i = 0; i < modules; i++)
+		{
+			for (int n = 0; n < frames; n++)
+			{
+				uint8_t frame[4] = { (uint8_t)i, (uint8_t)n, 0xAB, 0xCD };
+				
+				if ((n % 4) == 3)
+				{
+					gateway.sendACK(i, frame, sizeof(frame), [&](int index, uint8_t answer)
+					{
+						LYNXBeeSigfox& module = gateway.module(index);
+						uint32_t id = ((uint32_t)module._downlink[0] << 24) | ((uint32_t)module._downlink[1] << 16) |
+										((uint32_t)module._downlink[2] << 8) | module._downlink[3];
+						
+						if ((answer != SIGFOX_ANSWER_OK) || (id != module._id))
+						{
+							wrongDownlinks++;
+						}
+					});
+				}
+				else
+				{
+					gateway.send(i, frame, sizeof(frame));
+				}
+			}
+		}
+		gateway.runUntilIdle();
+		
+		unsigned long elapsed = millis() - start;
+		uint32_t uplinks = 0;
+		
+		for (int i = 0; i < modules; i++)
+		{
+			uplinks += sim.module(i)._uplinks;
+		}
+		
+		printf("%4d modules: %6lu uplinks in %6lu ms, %8.1f uplinks/s, %u failed, %d wrong downlinks\n",
+				modules, (unsigned long)uplinks, elapsed, 
+				(elapsed > 0) ? (1000.0 * uplinks / elapsed) : 0.0, 
+				(unsigned)gateway._failed, wrongDownlinks);
+	}
+	
+	return 0;
+}
@@ -0,0 +1,137 @@
+/*! 
+ * @file 	sigfox_seq_bench.cpp
+ * @author	Sean van der Walt / Walt Technologies Pty Ltd
+ * @version	0.1
+ * @brief 	Ingest benchmark of SigfoxSeqTracker. Frames of many devices are 
+ * 			lost, repeated and reordered at known rates, then tracked; the 
+ * 			measured delivery is checked against the frames really lost.
+ * 
+ * 	g++ -O2 -std=c++11 sigfox_seq_bench.cpp SigfoxSeqTracker.cpp
+ * 	./a.out [devices] [frames per device] [loss %] [duplicate %] [reorder %] [bits]
+ *
+ *  Copyright (C) 2017 Walt Technologies Pty Ltd
+ *  https://walt-tech.com.au
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *    
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *   
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *	
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <random>
+#include <vector>
+#include "SigfoxSeqTracker.h"
+
+struct Received
+{
+	uint32_t device;
+	uint8_t frame[SIGFOX_MAX_PAYLOAD];
+};
+
+
+int main(int argc, char** argv)
+{
+	uint32_t devices = (argc > 1) ? strtoul(argv[1], NULL, 10) : 100000;
+	uint32_t frames = (argc > 2) ? strtoul(argv[2], NULL, 10) : 100;
+	double loss = ((argc > 3) ? atof(argv[3]) : 5) / 100;
+	double duplicate = ((argc > 4) ? atof(argv[4]) : 2) / 100;
+	double reorder = ((argc > 5) ? atof(argv[5]) : 1) / 100;
+	uint8_t bits = (argc > 6) ? atoi(argv[6]) : 12;
+	std::vector<Received> stream;
+	std::vector<uint32_t> tail(devices, 0);
+	std::vector<bool> seen(devices, false);
+	std::mt19937 random(1);
+	std::uniform_real_distribution<double> chance(0.0, 1.0);
+	uint64_t lost = 0;
+	uint64_t unseen = 0;
+	uint64_t repeated = 0;
+	
+	stream.reserve((size_t)devices * frames * (1 + duplicate) + devices);
+	
+	// frames leave the devices round robin, as they would in time
+	for (uint32_t n = 0; n < frames; n++)
+	{
+		for (uint32_t d = 0; d < devices; d++)
+		{
+			Received received;
+			
+			received.device = 0x00100000 + d;
+			memset(received.frame, 0x00, sizeof(received.frame));
+			sigfoxPutSeq(received.frame, SIGFOX_MAX_PAYLOAD, n, bits);
+			
+			if (chance(random) < loss)
+			{
+				// frames lost before the first or after the last received 
+				// one cannot be seen
+				if (seen[d])	tail[d]++;
+				else			unseen++;
+				continue;
+			}
+			lost += tail[d];
+			tail[d] = 0;
+			seen[d] = true;
+			
+			stream.push_back(received);
+			if (chance(random) < duplicate)
+			{
+				stream.push_back(received);
+				repeated++;
+			}
+		}
+	}
+	
+	for (uint32_t d = 0; d < devices; d++)
+	{
+		unseen += tail[d];
+	}
+	
+	// late frames: swap with a frame a few positions later
+	for (size_t i = 0; i + 1 < stream.size(); i++)
+	{
+		if (chance(random) < reorder)
+		{
+			size_t j = i + 1 + random() % (3 * devices);
+			if (j < stream.size())
+			{
+				std::swap(stream[i], stream[j]);
+			}
+		}
+	}
+	
+	SigfoxSeqTracker tracker(bits, devices);
+	
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < stream.size(); i++)
+	{
+		tracker.push(stream[i].device, stream[i].frame, SIGFOX_MAX_PAYLOAD);
+	}
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	
+	SigfoxSeqStats total = tracker.total();
+	uint64_t sent = (uint64_t)devices * frames;
+	
+	printf("devices: %u  frames: %zu  %.1f Mframes/s\n", devices, stream.size(), stream.size() / elapsed.count() / 1e6);
+	printf("sent:    %llu, lost %llu (+%llu first or last), repeated %llu\n", (unsigned long long)sent,
+			(unsigned long long)lost, (unsigned long long)unseen, (unsigned long long)repeated);
+	printf("tracked: received %llu, missing %llu, duplicates %llu, gaps %llu, late %llu, resets %llu\n",
+			(unsigned long long)total.received, (unsigned long long)total.missing, (unsigned long long)total.duplicates,
+			(unsigned long long)total.gaps, (unsigned long long)total.late, (unsigned long long)total.resets);
+	printf("delivery: %.3f %% measured, %.3f %% real\n", 100.0 * total.delivery(),
+			100.0 * (sent - lost - unseen) / (sent - unseen));
+	
+	return 0;
+}
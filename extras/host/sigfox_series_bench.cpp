@@ -0,0 +1,256 @@
+/*! 
+ * @file 	sigfox_series_bench.cpp
+ * @author	Sean van der Walt / Walt Technologies Pty Ltd
+ * @version	0.1
+ * @brief 	Compression benchmark of SigfoxSeries. Each dataset is compressed
+ * 			into frames the way the firmware does it, decoded again with 
+ * 			sigfoxDecodeSeries() and checked. Prints samples per frame, the 
+ * 			ratio against 8 raw bytes per sample and against fixed width 
+ * 			packing (16-bit time + 16-bit value, 3 samples per frame), and 
+ * 			the encoder time per sample on this machine.
+ * 
+ * 	g++ -O2 -std=c++11 sigfox_series_bench.cpp SigfoxSeriesDecoder.cpp
+ * 	./a.out [file.csv ...]
+ * 
+ * 	A dataset file holds one "time,value" sample per line; values with a 
+ * 	decimal point make a float series. Without files, generated series are
+ * 	used (temperature, pressure, pulse counter).
+ *
+ *  Copyright (C) 2017 Walt Technologies Pty Ltd
+ *  https://walt-tech.com.au
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *    
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *   
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *	
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CYCLES()	__rdtsc()
+#endif
+#include "SigfoxSeriesDecoder.h"
+
+struct Dataset
+{
+	std::string name;
+	uint8_t type;
+	std::vector<uint32_t> time;
+	std::vector<int32_t> integer;
+	std::vector<float> real;
+};
+
+#define FIXED_SAMPLES_PER_FRAME	3
+
+
+/*!
+ * @brief	This function loads a "time,value" file
+ */
+static bool load(const char* path, Dataset& set)
+{
+	FILE* file = fopen(path, "r");
+	char line[128];
+
+	if (!file)
+	{
+		return false;
+	}
+
+	set.name = path;
+	set.type = SIGFOX_SERIES_INTEGER;
+
+	while (fgets(line, sizeof(line), file))
+	{
+		char* comma = strchr(line, ',');
+		if (!comma)
+		{
+			continue;
+		}
+		if (strchr(comma, '.'))
+		{
+			set.type = SIGFOX_SERIES_FLOAT;
+		}
+		set.time.push_back(strtoul(line, NULL, 10));
+		set.integer.push_back(strtol(comma + 1, NULL, 10));
+		set.real.push_back(strtof(comma + 1, NULL));
+	}
+
+	fclose(file);
+
+	return !set.time.empty();
+}
+
+
+
+
+/*!
+ * @brief	This function generates a week of samples every 10 minutes with
+ * 			some jitter: temperature in 0.01 C, pressure in hPa (float) and
+ * 			a pulse counter
+ */
+static void generate(std::vector<Dataset>& sets)
+{
+	std::mt19937 random(1);
+	std::normal_distribution<double> noise(0.0, 1.0);
+	std::uniform_int_distribution<int> jitter(-2, 2);
+	Dataset temperature, pressure, counter;
+	double hpa = 1013.2;
+	int32_t pulses = 0;
+
+	temperature.name = "temperature (int, 0.01 C)";
+	temperature.type = SIGFOX_SERIES_INTEGER;
+	pressure.name = "pressure (float, 0.1 hPa)";
+	pressure.type = SIGFOX_SERIES_FLOAT;
+	counter.name = "pulse counter (int)";
+	counter.type = SIGFOX_SERIES_INTEGER;
+
+	for (uint32_t i = 0; i < 7 * 144; i++)
+	{
+		uint32_t t = 1500000000UL + i * 600 + jitter(random);
+		double day = (i % 144) / 144.0;
+
+		temperature.time.push_back(t);
+		temperature.integer.push_back((int32_t)(1800 + 600 * sin(2 * M_PI * day) + 5 * noise(random)));
+
+		hpa += 0.05 * noise(random);
+		pressure.time.push_back(t);
+		pressure.real.push_back(roundf((float)hpa * 10) / 10);
+
+		pulses += (i % 144 < 48) ? 0 : (int32_t)(3 + noise(random));
+		counter.time.push_back(t);
+		counter.integer.push_back(pulses);
+	}
+
+	sets.push_back(temperature);
+	sets.push_back(pressure);
+	sets.push_back(counter);
+}
+
+
+
+
+/*!
+ * @brief	This function compresses, decodes and checks a dataset
+ */
+static void run(const Dataset& set)
+{
+	SigfoxSeries series(set.type);
+	std::vector< std::vector<uint8_t> > frames;
+	std::vector<SigfoxSample> decoded;
+	size_t count = set.time.size();
+	size_t bytes = 0;
+	size_t errors = 0;
+	uint64_t cycles = 0;
+
+	// compress
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+#ifdef CYCLES
+	uint64_t first = CYCLES();
+#endif
+	for (size_t i = 0; i < count; i++)
+	{
+		bool added = (set.type == SIGFOX_SERIES_FLOAT) ? series.add(set.time[i], set.real[i]) : series.add(set.time[i], set.integer[i]);
+
+		if (!added)
+		{
+			// frame full: send it and start the next one with this sample
+			frames.push_back(std::vector<uint8_t>(series._frame, series._frame + series.length()));
+			series.reset();
+			i--;
+		}
+	}
+	if (series._count > 0)
+	{
+		frames.push_back(std::vector<uint8_t>(series._frame, series._frame + series.length()));
+	}
+#ifdef CYCLES
+	cycles = CYCLES() - first;
+#endif
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	// decode and check
+	size_t index = 0;
+	for (size_t f = 0; f < frames.size(); f++)
+	{
+		decoded.clear();
+		bytes += frames[f].size();
+		if (!sigfoxDecodeSeries(frames[f].data(), frames[f].size(), decoded))
+		{
+			errors++;
+			continue;
+		}
+
+		uint32_t base = set.time[index] & ~0xFFFFUL;
+		for (size_t s = 0; s < decoded.size(); s++, index++)
+		{
+			bool same = (decoded[s].time + base == set.time[index]);
+			if (set.type == SIGFOX_SERIES_FLOAT)	same = same && (memcmp(&decoded[s].real, &set.real[index], sizeof(float)) == 0);
+			else									same = same && (decoded[s].integer == set.integer[index]);
+			if (!same)
+			{
+				errors++;
+			}
+		}
+	}
+	if (index != count)
+	{
+		errors++;
+	}
+
+	double perFrame = (double)count / frames.size();
+	printf("%s\n", set.name.c_str());
+	printf("  %zu samples, %zu frames, %.1f samples/frame, %.2f bytes/sample\n", 
+			count, frames.size(), perFrame, (double)bytes / count);
+	printf("  ratio %.1fx vs raw (8 bytes/sample), %.1fx frames vs fixed width\n", 
+			8.0 * count / bytes, perFrame / FIXED_SAMPLES_PER_FRAME);
+	printf("  encoder %.0f ns/sample", 1e9 * seconds / count);
+	if (cycles)
+	{
+		printf(", %.0f cycles/sample", (double)cycles / count);
+	}
+	printf(" (host), %s\n", errors ? "DECODE ERRORS" : "decoded OK");
+}
+
+
+
+
+int main(int argc, char** argv)
+{
+	std::vector<Dataset> sets;
+
+	for (int i = 1; i < argc; i++)
+	{
+		Dataset set;
+		if (load(argv[i], set))		sets.push_back(set);
+		else						fprintf(stderr, "cannot read %s\n", argv[i]);
+	}
+
+	if (sets.empty())
+	{
+		generate(sets);
+	}
+
+	for (size_t i = 0; i < sets.size(); i++)
+	{
+		run(sets[i]);
+	}
+
+	return 0;
+}
@@ -0,0 +1,57 @@
+#!/bin/sh
+#
+# sigfox_size.sh - flash used by each optional feature of LYNXBeeSigfox
+#
+# Builds LYNXBeeSigfox.cpp with no optional feature, then with each one on 
+# its own, and prints the code + constant data of every build and the cost
+# of each feature. Run it from the library folder. Defaults to a host build
+# (SigfoxPosixUART); for the real numbers use the Waspmote toolchain, i.e.
+#
+#   CXX=avr-g++ SIZE=avr-size \
+#   CXXFLAGS="-mmcu=atmega1281 -Os -DF_CPU=14745600L -I<waspmote-api>" \
+#   extras/host/sigfox_size.sh
+#
+#  Copyright (C) 2017 Walt Technologies Pty Ltd
+#  https://walt-tech.com.au
+#
+#  This program is free software: you can redistribute it and/or modify
+#  it under the terms of the GNU Lesser General Public License as published by
+#  the Free Software Foundation, either version 2.1 of the License, or
+#  (at your option) any later version.
+#
+
+CXX=${CXX:-g++}
+SIZE=${SIZE:-size}
+CXXFLAGS=${CXXFLAGS:-"-Os -Wall -DSIGFOX_TRANSPORT_HEADER='\"extras/host/SigfoxPosixUART.h\"'"}
+FEATURES="RF_TEST LAN DIAG DOWNLINK FCC TELEMETRY"
+OBJ=${TMPDIR:-/tmp}/sigfox_size.$$.o
+
+# text (code and constants) of a build with the given features on
+build()
+{
+	flags=""
+	for feature in $FEATURES; do
+		value=0
+		for on in "$@"; do
+			[ "$on" = "$feature" ] && value=1
+		done
+		flags="$flags -DSIGFOX_FEATURE_$feature=$value"
+	done
+
+	eval "$CXX $CXXFLAGS $flags -c LYNXBeeSigfox.cpp -o $OBJ" || exit 1
+	$SIZE $OBJ | awk 'NR == 2 { print $1 }'
+}
+
+base=$(build)
+printf "%-12s %8s %8s\n" "feature" "bytes" "total"
+printf "%-12s %8s %8d\n" "(core)" "-" "$base"
+
+for feature in $FEATURES; do
+	size=$(build $feature)
+	printf "%-12s %8d %8d\n" "$feature" $((size - base)) "$size"
+done
+
+size=$(build $FEATURES)
+printf "%-12s %8s %8d\n" "(all)" "-" "$size"
+
+rm -f $OBJ
@@ -0,0 +1,215 @@
+/*!
+ * @file 	sigfox_slot_sim.cpp
+ * @author	Sean van der Walt / Walt Technologies Pty Ltd
+ * @version	0.1
+ * @brief 	Measures the delivery rate of co-located devices waking up on the
+ * 			same schedule, with and without the transmit slot scheduler
+ * 			(setSlots(), nextSlot())
+ *
+ * 	g++ -O2 -std=c++11 -I../.. -DSIGFOX_TRANSPORT_HEADER='"extras/host/SigfoxSimUART.h"'
+ * 		sigfox_slot_sim.cpp SigfoxSimUART.cpp SigfoxSimModule.cpp SigfoxHostPort.cpp
+ * 		../../LYNXBeeSigfox.cpp -lutil
+ * 	./a.out [devices] [periods] [period minutes] [slots] [channels] [wake spread ms]
+ *
+ *  Copyright (C) 2017 Walt Technologies Pty Ltd
+ *  https://walt-tech.com.au
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+#include "../../LYNXBeeSigfox.h"
+
+/*
+ * Radio model: an uplink is sent 3 times back to back, each repetition on a
+ * random channel. A repetition is lost when another one overlaps it in time
+ * on the same channel (no capture effect), and a frame is delivered when
+ * at least one of its repetitions is received.
+ */
+#define REPETITIONS		3
+#define REPETITION_TIME	(SIGFOX_UPLINK_TIME / REPETITIONS)
+
+enum Modes
+{
+	MODE_SYNCHRONIZED,			// transmit on wake up
+	MODE_RANDOM,				// random delay in the period
+	MODE_SLOTS,					// nextSlot()
+	MODES
+};
+
+static const char* MODE_NAMES[MODES] = { "synchronized", "random delay", "slot scheduler" };
+
+struct Repetition
+{
+	uint64_t start;
+	uint32_t frame;
+	uint16_t channel;
+	bool lost;
+
+	bool operator<(const Repetition& other) const { return start < other.start; }
+};
+
+
+//! xorshift64 for the simulation itself
+static uint32_t nextRandom(uint64_t& state)
+{
+	state ^= state << 13;
+	state ^= state >> 7;
+	state ^= state << 17;
+	return (uint32_t)(state >> 32);
+}
+
+
+//! run the current command of a driver on the virtual clock
+static uint8_t runCommand(LYNXBeeSigfox& driver, unsigned long& clock)
+{
+	SigfoxSimModule* module = driver.module();
+	uint8_t answer;
+
+	while ((answer = driver.pollAT()) == SIGFOX_ANSWER_PENDING)
+	{
+		unsigned long wait = driver.timeLeftAT();
+
+		if (module->pending())
+		{
+			int32_t due = (int32_t)(module->nextDue() - (uint32_t)clock);
+			if (due < 0)						due = 0;
+			if ((unsigned long)due < wait)		wait = due;
+		}
+
+		clock += wait;
+	}
+
+	return answer;
+}
+
+
+//! mark the repetitions which overlap another one on the same channel
+static void collide(std::vector<Repetition>& air)
+{
+	std::sort(air.begin(), air.end());
+
+	for (size_t i = 0; i < air.size(); i++)
+	{
+		for (size_t j = i + 1; (j < air.size()) && (air[j].start < air[i].start + REPETITION_TIME); j++)
+		{
+			if (air[j].channel == air[i].channel)
+			{
+				air[i].lost = true;
+				air[j].lost = true;
+			}
+		}
+	}
+}
+
+
+int main(int argc, char** argv)
+{
+	uint32_t devices = (argc > 1) ? atoi(argv[1]) : 200;
+	uint32_t periods = (argc > 2) ? atoi(argv[2]) : 1000;
+	uint32_t period = ((argc > 3) ? atoi(argv[3]) : 10) * 60000;
+	uint16_t slots = (argc > 4) ? atoi(argv[4]) : 50;
+	uint16_t channels = (argc > 5) ? atoi(argv[5]) : 16;
+	uint32_t spread = (argc > 6) ? atoi(argv[6]) : 500;
+	std::vector<LYNXBeeSigfox> drivers(devices);
+	std::vector<SigfoxSimModule> modules;
+	unsigned long clock = 0;
+	uint64_t random = 0x9E3779B97F4A7C15ULL;
+
+	setVirtualClock(&clock);
+
+	// consecutive ids, as in a batch of modules
+	for (uint32_t i = 0; i < devices; i++)
+	{
+		modules.push_back(SigfoxSimModule(0x00100000 + i));
+		modules.back()._echo = false;
+	}
+
+	for (uint32_t i = 0; i < devices; i++)
+	{
+		drivers[i].attach(&modules[i]);
+
+		drivers[i].beginON(SOCKET0);
+		if (runCommand(drivers[i], clock) == SIGFOX_ANSWER_OK)
+		{
+			drivers[i].beginGetID();
+			runCommand(drivers[i], clock);
+		}
+		if (drivers[i]._id == 0)
+		{
+			printf("device %u: no id\n", i);
+			return 1;
+		}
+
+		// seeded from '_id'
+		drivers[i].setSlots(period, slots);
+	}
+
+	printf("%u devices, %u periods of %u min, %u slots, %u channels, wake spread %u ms\n",
+			devices, periods, period / 60000, slots, channels, spread);
+
+	for (uint8_t mode = 0; mode < MODES; mode++)
+	{
+		std::vector<Repetition> air;
+		std::vector<bool> delivered;
+		uint64_t count = 0;
+
+		air.reserve((size_t)devices * periods * REPETITIONS);
+
+		for (uint32_t p = 0; p < periods; p++)
+		{
+			for (uint32_t i = 0; i < devices; i++)
+			{
+				// the RTCs of the devices wake them up at about the same time
+				uint64_t start = (uint64_t)p * period + nextRandom(random) % spread;
+
+				if (mode == MODE_RANDOM)		start += nextRandom(random) % (period - SIGFOX_UPLINK_TIME);
+				else if (mode == MODE_SLOTS)	start += drivers[i].nextSlot();
+
+				for (uint8_t r = 0; r < REPETITIONS; r++)
+				{
+					Repetition repetition;
+					repetition.start = start + r * REPETITION_TIME;
+					repetition.frame = p * devices + i;
+					repetition.channel = nextRandom(random) % channels;
+					repetition.lost = false;
+					air.push_back(repetition);
+				}
+			}
+		}
+
+		collide(air);
+
+		delivered.assign((size_t)devices * periods, false);
+		for (size_t i = 0; i < air.size(); i++)
+		{
+			if (!air[i].lost)
+			{
+				delivered[air[i].frame] = true;
+			}
+		}
+		count = std::count(delivered.begin(), delivered.end(), true);
+
+		printf("%-16s delivered %6.2f %% (%llu of %llu frames)\n", MODE_NAMES[mode],
+				100.0 * count / delivered.size(), (unsigned long long)count, (unsigned long long)delivered.size());
+	}
+
+	setVirtualClock(NULL);
+
+	return 0;
+}